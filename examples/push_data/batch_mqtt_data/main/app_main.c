@@ -25,7 +25,6 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
-#include "cJSON.h"
 #include "bytebeam_sdk.h"
 
 // this macro is used to specify the delay for 200 ms
@@ -35,6 +34,8 @@ static int config_delay_period = APP_DELAY_TWO_HUNDRED_MS;
 
 static bytebeam_client_t bytebeam_client;
 
+static bytebeam_batch_handle_t acc_gyro_batch;
+
 static const char *TAG = "BYTEBEAM_BATCH_MQTT_DATA_EXAMPLE";
 
 float accel_x = -1.1;
@@ -44,149 +45,20 @@ float gyro_x  = 1.1;
 float gyro_y  = 0.33;
 float gyro_z  = 0.78;
 
+// schema of the acc_gyro stream, the record values are pushed in this order
+static const bytebeam_field_t acc_gyro_fields[] = {
+    { "accel_x", BYTEBEAM_FIELD_TYPE_FLOAT },
+    { "accel_y", BYTEBEAM_FIELD_TYPE_FLOAT },
+    { "accel_z", BYTEBEAM_FIELD_TYPE_FLOAT },
+    { "gyro_x",  BYTEBEAM_FIELD_TYPE_FLOAT },
+    { "gyro_y",  BYTEBEAM_FIELD_TYPE_FLOAT },
+    { "gyro_z",  BYTEBEAM_FIELD_TYPE_FLOAT },
+};
+
 static int publish_acc_gyro_values()
 {
-    struct timeval te;
-    long long milliseconds = 0;
-    static uint64_t sequence = 0;
-
-    cJSON *acc_gyro_json = NULL;
-    cJSON *sequence_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *accel_x_json = NULL;
-    cJSON *accel_y_json = NULL;
-    cJSON *accel_z_json = NULL;
-    cJSON *gyro_x_json = NULL;
-    cJSON *gyro_y_json = NULL;
-    cJSON *gyro_z_json = NULL;
-
-    char *string_json = NULL;
-
-    acc_gyro_json = cJSON_CreateObject();
-
-    if (acc_gyro_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add failed.");
-        return -1;
-    }
-
-    // get current time
-    gettimeofday(&te, NULL);
-    milliseconds = te.tv_sec * 1000LL + te.tv_usec / 1000;
-
-    // make sure you got the epoch millis
-    if(milliseconds == 0)
-    {
-        ESP_LOGE(TAG, "failed to get epoch millis.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    timestamp_json = cJSON_CreateNumber(milliseconds);
-
-    if (timestamp_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add time stamp failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "timestamp", timestamp_json);
-
-    sequence++;
-    sequence_json = cJSON_CreateNumber(sequence);
-
-    if (sequence_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add sequence id failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "sequence", sequence_json);
-
-    accel_x_json = cJSON_CreateNumber(accel_x);
-
-    if (accel_x_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add accel x value failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "accel_x", accel_x_json);
-
-    accel_y_json = cJSON_CreateNumber(accel_y);
-
-    if (accel_y_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add accel y value failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "accel_y", accel_y_json);
-
-    accel_z_json = cJSON_CreateNumber(accel_z);
-
-    if (accel_z_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add accel z value failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "accel_z", accel_z_json);
-
-    gyro_x_json = cJSON_CreateNumber(gyro_x);
-
-    if (gyro_x_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add gyro x value failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "gyro_x", gyro_x_json);
-
-    gyro_y_json = cJSON_CreateNumber(gyro_y);
-
-    if (gyro_y_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add gyro y value failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "gyro_y", gyro_y_json);
-
-    gyro_z_json = cJSON_CreateNumber(gyro_z);
-
-    if (gyro_z_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json add gyro z value failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    cJSON_AddItemToObject(acc_gyro_json, "gyro_z", gyro_z_json);
-
-    string_json = cJSON_Print(acc_gyro_json);
-
-    if(string_json == NULL)
-    {
-        ESP_LOGE(TAG, "Json string print failed.");
-        cJSON_Delete(acc_gyro_json);
-        return -1;
-    }
-
-    // publish the accel gyro json to acc_gyro stream
-    int ret_val = bytebeam_batch_publish_to_stream(string_json);
-
-    cJSON_Delete(acc_gyro_json);
-    cJSON_free(string_json);
-
-    return ret_val;
+    // the values are queued as is, the sdk adds the timestamp and sequence and encodes the record
+    return bytebeam_stream_record_push(acc_gyro_batch, accel_x, accel_y, accel_z, gyro_x, gyro_y, gyro_z);
 }
 
 static void app_start(bytebeam_client_t *bytebeam_client)
@@ -276,7 +148,10 @@ void app_main(void)
     bytebeam_init(&bytebeam_client);
 
     // initialze the bytebeam batch handle
-    bytebeam_batch_init(&bytebeam_client, "acc_gyro");
+    bytebeam_batch_init(&bytebeam_client, "acc_gyro", NULL, &acc_gyro_batch);
+
+    // register the acc_gyro record fields once
+    bytebeam_batch_register_schema(acc_gyro_batch, acc_gyro_fields, sizeof(acc_gyro_fields) / sizeof(acc_gyro_fields[0]));
 
     // start the bytebeam client
     bytebeam_start(&bytebeam_client);
@@ -9,6 +9,9 @@
 /*This macro is used to specify the maximum length of bytebeam action id string*/
 #define BYTEBEAM_ACTION_ID_STR_LEN 20
 
+/*This macro is used to specify the maximum length of the encoded action status message*/
+#define BYTEBEAM_ACTION_STATUS_STR_LEN 512
+
 /**
  * @brief Adds action handler for handling particular action.
  *
@@ -16,17 +19,32 @@
  *       executing the action handler function. So make sure you are not using it outside the scope of the action
  *       handler function as this may cause memory leaks in your application.
  *
+ * @note The action name is copied, the table grows on demand beyond BYTEBEAM_NUMBER_OF_ACTIONS handlers.
+ *
  * @param[in] bytebeam_client bytebeam client handle
  * @param[in] func_ptr        pointer to action handler function
  * @param[in] func_name       action name 
  * 
  * @return
  *      BB_SUCCESS: Action handler added successfully
- *      BB_FAILURE: Failure in adding the action handler
+ *      BB_FAILURE: If the action already has a handler or the table could not be allocated
  *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, func_ptr, or func_name is NULL
  */
 bytebeam_err_t bytebeam_add_action_handler(bytebeam_client_t *bytebeam_client, int (*func_ptr)(bytebeam_client_t *, char *, char *), char *func_name);
 
+/**
+ * @brief Size the action table for a number of handlers up front, so adding them does not grow it.
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ * @param[in] count           number of action handlers
+ * 
+ * @return
+ *      BB_SUCCESS: Table sized successfully
+ *      BB_FAILURE: If the table could not be allocated
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_reserve_action_handlers(bytebeam_client_t *bytebeam_client, uint32_t count);
+
 /**
  * @brief Remove action handler from the array
  *
@@ -74,12 +92,35 @@ bytebeam_err_t bytebeam_is_action_handler_there(bytebeam_client_t *bytebeam_clie
  * 
  * @return
  *      BB_SUCCESS: Successfully printed the action handler array
+ *      BB_FAILURE: If the copy of the action names could not be allocated
  *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
  */
 bytebeam_err_t bytebeam_print_action_handler_array(bytebeam_client_t *bytebeam_client);
 
 /**
- * @brief reset action handler array.
+ * @brief Build the client level action topics, called once by bytebeam_init
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ *
+ * @return
+ *      BB_SUCCESS: Topics built successfully
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ *      BB_FAILURE: If the topics allocation failed
+ */
+bytebeam_err_t bytebeam_action_topics_init(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Free the client level action topics
+ *
+ * @param[in] bytebeam_client bytebeam client handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_action_topics_deinit(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief reset action handler array, the handlers are removed and the table is freed.
  *
  * @param[in] bytebeam_client bytebeam client handle
  * 
@@ -139,9 +180,13 @@ bytebeam_err_t bytebeam_publish_action_progress(bytebeam_client_t *bytebeam_clie
  * @param[in] status              action state of the execution
  * @param[in] error_message       error message if action failed
  *
+ * @note  The status is encoded on the stack, it fails if it does not fit in BYTEBEAM_ACTION_STATUS_STR_LEN bytes
+ * @note  The status is published in the control lane, bulk stream publishes yield to it
+ *
  * @return
  *      BB_SUCCESS : Message publish successful
  *      BB_FAILURE : Message publish failed
+ *      BB_WOULD_BLOCK : The outbox is full up to the reserved control capacity
  */
 bytebeam_err_t bytebeam_publish_action_status(bytebeam_client_t* client, char *action_id, int percentage, char *status, char *error_message);
 
@@ -0,0 +1,88 @@
+#ifndef BYTEBEAM_AGGREGATE_H
+#define BYTEBEAM_AGGREGATE_H
+
+#include "bytebeam_client.h"
+#include "bytebeam_batch.h"
+
+/*This macro is used to specify the maximum number of panes a sliding window is split in*/
+#define BYTEBEAM_AGGREGATE_MAX_PANES 16
+
+/*This macro is used to specify the maximum number of aggregated fields, each one takes 4 schema fields plus the count*/
+#define BYTEBEAM_AGGREGATE_MAX_FIELDS ((BYTEBEAM_BATCH_MAX_FIELDS - 1) / 4)
+
+/* Handle of an aggregation stage returned by bytebeam_aggregate_init */
+typedef struct bytebeam_aggregate *bytebeam_aggregate_handle_t;
+
+/**
+ * @struct bytebeam_aggregate_config_t
+ * This struct contains the window of an aggregation stage
+ * @var bytebeam_aggregate_config_t::window_ms
+ * Length of the window
+ * @var bytebeam_aggregate_config_t::slide_ms
+ * Time between two emitted windows, 0 or window_ms for tumbling windows. A sliding window must be a whole
+ * multiple of it, with at most BYTEBEAM_AGGREGATE_MAX_PANES panes
+ */
+typedef struct bytebeam_aggregate_config {
+    uint32_t window_ms;
+    uint32_t slide_ms;
+} bytebeam_aggregate_config_t;
+
+/**
+ * @brief Attach an aggregation stage to a batch stream, the stage registers the schema of the stream
+ *
+ * @note  Every emitted record holds count followed by <field>_min, <field>_max, <field>_mean and <field>_var, the
+ *        population variance, for each field. The memory used is fixed at init, the running statistics are kept
+ *        per pane and merged when a window is emitted
+ *
+ * @param[in]  batch           batch stream handle, it must not have a schema yet
+ * @param[in]  field_names     names of the aggregated fields, copied into the schema
+ * @param[in]  num_fields      number of aggregated fields, at most BYTEBEAM_AGGREGATE_MAX_FIELDS
+ * @param[in]  config          aggregation window
+ * @param[out] handle          aggregation stage handle
+ *
+ * @return
+ *      BB_SUCCESS: Aggregation stage attached
+ *      BB_NULL_CHECK_FAILURE: If the batch, field_names, config or handle is NULL
+ *      BB_FAILURE: If the window is invalid, the schema can not be registered or the allocation failed
+ */
+bytebeam_err_t bytebeam_aggregate_init(bytebeam_batch_handle_t batch, const char *const *field_names, int num_fields,
+                                       const bytebeam_aggregate_config_t *config, bytebeam_aggregate_handle_t *handle);
+
+/**
+ * @brief Detach an aggregation stage, the samples not emitted yet are lost
+ *
+ * @param[in] handle           aggregation stage handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_aggregate_deinit(bytebeam_aggregate_handle_t handle);
+
+/**
+ * @brief Add a sample to the aggregation, the windows that closed before it are emitted first. Must be called from
+ *        a single task
+ *
+ * @param[in] handle           aggregation stage handle
+ * @param[in] values           one value per aggregated field, in init order
+ *
+ * @return
+ *      BB_SUCCESS: Sample added
+ *      BB_NULL_CHECK_FAILURE: If the handle or values is NULL
+ *      BB_FAILURE: If an emitted record could not be pushed, the sample is still added
+ */
+bytebeam_err_t bytebeam_aggregate_push(bytebeam_aggregate_handle_t handle, const double *values);
+
+/**
+ * @brief Emit the windows that closed by now, for a signal that stopped being sampled. Must be called from the
+ *        task that pushes the samples
+ *
+ * @param[in] handle           aggregation stage handle
+ *
+ * @return
+ *      BB_SUCCESS: Closed windows emitted
+ *      BB_NULL_CHECK_FAILURE: If the handle is NULL
+ *      BB_FAILURE: If an emitted record could not be pushed
+ */
+bytebeam_err_t bytebeam_aggregate_poll(bytebeam_aggregate_handle_t handle);
+
+#endif /* BYTEBEAM_AGGREGATE_H */
@@ -0,0 +1,410 @@
+#ifndef BYTEBEAM_BATCH_H
+#define BYTEBEAM_BATCH_H
+
+#include "bytebeam_client.h"
+#include "bytebeam_filter.h"
+
+/*This macro is used to specify the maximum length of bytebeam batch stream name string*/
+#define BYTEBEAM_BATCH_STREAM_STR_LEN 100
+
+/*This macro is used to specify the maximum number of fields in a batch stream schema*/
+#define BYTEBEAM_BATCH_MAX_FIELDS 32
+
+/* Default batch flush policy, built from the Kconfig batch settings */
+#define BYTEBEAM_BATCH_DEFAULT_POLICY() {                                               \
+    .max_records = CONFIG_NUM_MESSAGES_IN_MQTT_BATCH,                                   \
+    .max_bytes = CONFIG_NUM_MESSAGES_IN_MQTT_BATCH * CONFIG_MQTT_BATCH_ELEMENT_SIZE,    \
+    .max_linger_ms = CONFIG_MQTT_BATCH_MAX_LINGER,                                      \
+    .encoding = BYTEBEAM_ENCODING_JSON,                                                 \
+    .retry_base_ms = CONFIG_MQTT_BATCH_RETRY_BASE,                                      \
+    .retry_max_ms = CONFIG_MQTT_BATCH_RETRY_MAX,                                        \
+    .retry_max_attempts = CONFIG_MQTT_BATCH_RETRY_MAX_ATTEMPTS,                         \
+    .retry_max_age_ms = CONFIG_MQTT_BATCH_RETRY_MAX_AGE,                                \
+}
+
+/**
+ * @struct bytebeam_batch_policy_t
+ * This struct decides how a batch is encoded and when it is flushed, whichever limit is reached first wins
+ * @var bytebeam_batch_policy_t::max_records
+ * Maximum number of records in a batch
+ * @var bytebeam_batch_policy_t::max_bytes
+ * Maximum size of a batch in bytes
+ * @var bytebeam_batch_policy_t::max_linger_ms
+ * Maximum time the first record of a batch waits before the batch is flushed, 0 waits until the batch is full
+ * @var bytebeam_batch_policy_t::encoding
+ * Encoding of the records, a CBOR record must be a single complete CBOR item
+ * @var bytebeam_batch_policy_t::retry_base_ms
+ * Backoff cap of the first retry of a failed publish, doubled with every attempt, 0 to use the config menu value
+ * @var bytebeam_batch_policy_t::retry_max_ms
+ * Largest backoff cap, 0 to use the config menu value
+ * @var bytebeam_batch_policy_t::retry_max_attempts
+ * Failed publishes after which the batch is handed to the spill handler, 0 for no limit
+ * @var bytebeam_batch_policy_t::retry_max_age_ms
+ * Time from sealing after which an unpublished batch is handed to the spill handler, 0 for no limit
+ */
+typedef struct bytebeam_batch_policy {
+    int max_records;
+    size_t max_bytes;
+    uint32_t max_linger_ms;
+    bytebeam_encoding_t encoding;
+    uint32_t retry_base_ms;
+    uint32_t retry_max_ms;
+    uint32_t retry_max_attempts;
+    uint32_t retry_max_age_ms;
+} bytebeam_batch_policy_t;
+
+/* Handle of a batch stream returned by bytebeam_batch_init */
+typedef struct bytebeam_batch *bytebeam_batch_handle_t;
+
+/* This enum represents the batch stream events reported to the application */
+typedef enum bytebeam_batch_event {
+    BYTEBEAM_BATCH_EVENT_BUFFERS_FULL,         //!< Every batch buffer is in flight, new records wait in the queue
+    BYTEBEAM_BATCH_EVENT_BUFFERS_AVAILABLE,    //!< A batch buffer was released once its publish completed
+    BYTEBEAM_BATCH_EVENT_BATCH_DROPPED         //!< A batch ran out of retries and the spill handler did not take it
+} bytebeam_batch_event_t;
+
+/* Batch stream event handler, called from the MQTT Data Publish Thread so it must not block */
+typedef void (*bytebeam_batch_event_handler_t)(bytebeam_batch_handle_t handle, bytebeam_batch_event_t event);
+
+/* Batch spill handler, called from the MQTT Data Publish Thread with a batch that ran out of retries. It returns
+ * true if it kept the batch, e.g. in flash, the batch memory is reused as soon as it returns */
+typedef bool (*bytebeam_batch_spill_handler_t)(bytebeam_batch_handle_t handle, const void *batch, size_t batch_len, bytebeam_encoding_t encoding);
+
+/**
+ * @struct bytebeam_batch_stats_t
+ * This struct contains the counters of a batch stream
+ * @var bytebeam_batch_stats_t::retries
+ * Publishes made again after a failure or a missing acknowledgement
+ * @var bytebeam_batch_stats_t::backoff_ms
+ * Total time spent waiting in backoff
+ * @var bytebeam_batch_stats_t::spilled
+ * Batches that ran out of retries and were kept by the spill handler
+ * @var bytebeam_batch_stats_t::dropped
+ * Batches that ran out of retries and were dropped
+ * @var bytebeam_batch_stats_t::filtered
+ * Records dropped by the field filters before they were queued
+ */
+typedef struct bytebeam_batch_stats {
+    uint32_t retries;
+    uint32_t backoff_ms;
+    uint32_t spilled;
+    uint32_t dropped;
+    uint32_t filtered;
+} bytebeam_batch_stats_t;
+
+/* This enum represents the type of a schema field, it decides how the value is passed and encoded */
+typedef enum bytebeam_field_type {
+    BYTEBEAM_FIELD_TYPE_INT,       //!< int argument, int_value in bytebeam_field_value_t
+    BYTEBEAM_FIELD_TYPE_INT64,     //!< int64_t argument, int_value in bytebeam_field_value_t
+    BYTEBEAM_FIELD_TYPE_FLOAT,     //!< float argument (promoted to double), float_value in bytebeam_field_value_t
+    BYTEBEAM_FIELD_TYPE_DOUBLE,    //!< double argument, double_value in bytebeam_field_value_t
+    BYTEBEAM_FIELD_TYPE_BOOL       //!< int or bool argument, bool_value in bytebeam_field_value_t
+} bytebeam_field_type_t;
+
+/**
+ * @struct bytebeam_field_t
+ * This struct describes a single field of a batch stream schema
+ * @var bytebeam_field_t::name
+ * Column name of the field, it must not need escaping in JSON
+ * @var bytebeam_field_t::type
+ * Type of the field
+ */
+typedef struct bytebeam_field {
+    const char *name;
+    bytebeam_field_type_t type;
+} bytebeam_field_t;
+
+/* Value of a schema field, the member in use is given by the field type */
+typedef union bytebeam_field_value {
+    int64_t int_value;
+    float float_value;
+    double double_value;
+    bool bool_value;
+} bytebeam_field_value_t;
+
+/**
+ * @struct bytebeam_batch_writer_t
+ * This struct tracks a json or cbor array batch being built in a caller provided buffer
+ * @var bytebeam_batch_writer_t::encoding
+ * Encoding of the batch, decides the array framing
+ * @var bytebeam_batch_writer_t::buf
+ * Buffer holding the batch
+ * @var bytebeam_batch_writer_t::capacity
+ * Size of the buffer in bytes
+ * @var bytebeam_batch_writer_t::len
+ * Number of bytes written to the buffer so far
+ * @var bytebeam_batch_writer_t::count
+ * Number of elements appended to the batch so far
+ */
+typedef struct bytebeam_batch_writer {
+    bytebeam_encoding_t encoding;
+    char *buf;
+    size_t capacity;
+    size_t len;
+    int count;
+} bytebeam_batch_writer_t;
+
+/**
+ * @brief Initialize the batch writer and start an empty batch
+ *
+ * @param[in] writer      batch writer handle
+ * @param[in] encoding    encoding of the batch
+ * @param[in] buf         buffer to build the batch in
+ * @param[in] capacity    size of the buffer in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Batch writer initialized successfully
+ *      BB_FAILURE: If the buffer is too small to hold an empty batch
+ *      BB_NULL_CHECK_FAILURE: If the writer or buf is NULL
+ */
+bytebeam_err_t bytebeam_batch_writer_init(bytebeam_batch_writer_t *writer, bytebeam_encoding_t encoding, char *buf, size_t capacity);
+
+/**
+ * @brief Discard the batch contents and start an empty batch
+ *
+ * @param[in] writer      batch writer handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_batch_writer_reset(bytebeam_batch_writer_t *writer);
+
+/**
+ * @brief Append an element to the batch
+ *
+ * @note  Room for the closing bracket is always kept, so a successful append never leaves the batch unfinishable
+ *
+ * @param[in] writer      batch writer handle
+ * @param[in] element     json element or cbor item to append
+ * @param[in] len         length of the element in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Element appended
+ *      BB_FAILURE: Element does not fit in the remaining space, the batch is left untouched
+ *      BB_NULL_CHECK_FAILURE: If the writer or element is NULL
+ */
+bytebeam_err_t bytebeam_batch_writer_append(bytebeam_batch_writer_t *writer, const char *element, size_t len);
+
+/**
+ * @brief Get the number of bytes the next appended element can use
+ *
+ * @param[in] writer      batch writer handle
+ *
+ * @return
+ *      number of bytes available for the next element
+ */
+size_t bytebeam_batch_writer_available(bytebeam_batch_writer_t *writer);
+
+/**
+ * @brief Close the batch so it can be published
+ *
+ * @param[in]  writer     batch writer handle
+ * @param[out] len        length of the batch in bytes, excluding the NULL character
+ *
+ * @return
+ *      NULL terminated batch, a cbor batch may also contain NULL characters so always use len
+ */
+const char* bytebeam_batch_writer_finish(bytebeam_batch_writer_t *writer, size_t *len);
+
+/**
+ * @brief Initialize a batch stream, every batch stream has its own queue, buffers, policy and sequence counter
+ *
+ * @note  All the batch streams are serviced by the MQTT Data Publish Thread. Each batch stream allocates
+ *        CONFIG_MQTT_BATCH_BUFFER_COUNT buffers of policy max_bytes, a full buffer is handed to the transport
+ *        while the next one fills
+ *
+ * @param[in]  bytebeam_client    bytebeam client handle
+ * @param[in]  stream_name        stream name
+ * @param[in]  policy             batch flush policy, NULL to use BYTEBEAM_BATCH_DEFAULT_POLICY
+ * @param[out] handle             batch stream handle
+ * 
+ * @return
+ *      BB_SUCCESS: MQTT Batch Initialized Successfully
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name or handle is NULL
+ *      BB_FAILURE: On failure
+ */
+bytebeam_err_t bytebeam_batch_init(bytebeam_client_t *bytebeam_client, char *stream_name, const bytebeam_batch_policy_t *policy, bytebeam_batch_handle_t *handle);
+
+/**
+ * @brief MQTT Batch Publish, safe to call from multiple tasks at once
+ *
+ * @param[in] handle         batch stream handle
+ * @param[in] payload        payload to batch publish
+ * 
+ * @return
+ *      BB_SUCCESS: MQTT Batch Added Successfully
+ *      BB_FAILURE: On failure
+ *      BB_NULL_CHECK_FAILURE: If the handle or payload is NULL
+ */
+bytebeam_err_t bytebeam_batch_publish_to_stream(bytebeam_batch_handle_t handle, char *payload);
+
+/**
+ * @brief MQTT Batch Publish of a record that is not NULL terminated, e.g. a cbor item, safe to call from multiple
+ *        tasks at once
+ *
+ * @param[in] handle         batch stream handle
+ * @param[in] payload        record to batch publish, encoded as the batch stream policy says
+ * @param[in] payload_len    length of the record in bytes
+ *
+ * @return
+ *      BB_SUCCESS: MQTT Batch Added Successfully
+ *      BB_FAILURE: On failure
+ *      BB_NULL_CHECK_FAILURE: If the handle or payload is NULL
+ */
+bytebeam_err_t bytebeam_batch_publish_buffer_to_stream(bytebeam_batch_handle_t handle, const void *payload, size_t payload_len);
+
+/**
+ * @brief Request the pending MQTT Batch to be published now, regardless of the flush policy
+ *
+ * @note  The batch is published asynchronously by the MQTT Data Publish Thread
+ *
+ * @param[in] handle         batch stream handle, NULL to flush every batch stream
+ *
+ * @return
+ *      BB_SUCCESS: Flush requested
+ */
+bytebeam_err_t bytebeam_batch_flush(bytebeam_batch_handle_t handle);
+
+/**
+ * @brief Register the batch stream event handler
+ *
+ * @param[in] handle         batch stream handle
+ * @param[in] event_handler  batch stream event handler
+ *
+ * @return
+ *      BB_SUCCESS: Handler registered successfully
+ *      BB_NULL_CHECK_FAILURE: If the handle or event_handler is NULL
+ */
+bytebeam_err_t bytebeam_batch_register_event_handler(bytebeam_batch_handle_t handle, bytebeam_batch_event_handler_t event_handler);
+
+/**
+ * @brief Register the handler that gets the batches that ran out of retries
+ *
+ * @note  Without a handler the batches are written to the store and forward partition if it is enabled, otherwise
+ *        they are dropped
+ *
+ * @param[in] handle         batch stream handle
+ * @param[in] spill_handler  batch spill handler
+ *
+ * @return
+ *      BB_SUCCESS: Handler registered successfully
+ *      BB_NULL_CHECK_FAILURE: If the handle or spill_handler is NULL
+ */
+bytebeam_err_t bytebeam_batch_register_spill_handler(bytebeam_batch_handle_t handle, bytebeam_batch_spill_handler_t spill_handler);
+
+/**
+ * @brief Get the counters of a batch stream, safe to call from any task
+ *
+ * @param[in]  handle        batch stream handle
+ * @param[out] stats         batch stream counters
+ *
+ * @return
+ *      BB_SUCCESS: Counters read
+ *      BB_NULL_CHECK_FAILURE: If the handle or stats is NULL
+ */
+bytebeam_err_t bytebeam_batch_get_stats(bytebeam_batch_handle_t handle, bytebeam_batch_stats_t *stats);
+
+/**
+ * @brief Get the next record sequence number of the batch stream, safe to call from multiple tasks at once
+ *
+ * @param[in] handle         batch stream handle
+ *
+ * @return
+ *      sequence number starting from 1, 0 if the handle is NULL
+ */
+uint64_t bytebeam_batch_next_sequence(bytebeam_batch_handle_t handle);
+
+/**
+ * @brief Register the schema of a batch stream, its records are then pushed as raw values and encoded by the MQTT
+ *        Data Publish Thread straight into the batch buffer
+ *
+ * @note  Must be called once, before the first record is pushed. Every record gets the timestamp and sequence
+ *        fields ahead of the schema fields, a batch stream with a schema only takes bytebeam_stream_record_push.
+ *        The record is stamped with the uptime when pushed and the timestamp is worked out when it is encoded, so
+ *        the records pushed before the wall clock is set stay queued until it is and still get their real time
+ *
+ * @param[in] handle         batch stream handle
+ * @param[in] fields         schema fields, the array and the names are copied
+ * @param[in] num_fields     number of schema fields
+ *
+ * @return
+ *      BB_SUCCESS: Schema registered
+ *      BB_NULL_CHECK_FAILURE: If the handle or fields is NULL
+ *      BB_FAILURE: If a schema is already registered, a field is invalid or a record does not fit the queue element
+ *                  size or the batch policy
+ */
+bytebeam_err_t bytebeam_batch_register_schema(bytebeam_batch_handle_t handle, const bytebeam_field_t *fields, int num_fields);
+
+/**
+ * @brief Push a record to a batch stream with a schema, safe to call from multiple tasks at once
+ *
+ * @note  The values follow in schema order with the argument types given by bytebeam_field_type_t
+ *
+ * @param[in] handle         batch stream handle
+ *
+ * @return
+ *      BB_SUCCESS: Record queued, or dropped by the field filters
+ *      BB_FAILURE: If the batch stream has no schema or the queue is full
+ *      BB_NULL_CHECK_FAILURE: If the handle is NULL
+ */
+bytebeam_err_t bytebeam_stream_record_push(bytebeam_batch_handle_t handle, ...);
+
+/**
+ * @brief Push a record given as an array of values to a batch stream with a schema, safe to call from multiple
+ *        tasks at once
+ *
+ * @param[in] handle         batch stream handle
+ * @param[in] values         one value per schema field, in schema order
+ *
+ * @return
+ *      BB_SUCCESS: Record queued, or dropped by the field filters
+ *      BB_FAILURE: If the batch stream has no schema or the queue is full
+ *      BB_NULL_CHECK_FAILURE: If the handle or values is NULL
+ */
+bytebeam_err_t bytebeam_stream_record_push_values(bytebeam_batch_handle_t handle, const bytebeam_field_value_t *values);
+
+/**
+ * @brief Set the reporting filter of a schema field, safe to call while records are pushed
+ *
+ * @note  Once a field has a filter, a record is only queued if one of the filtered fields wants it reported, the
+ *        other fields are carried along. Dropped records take no sequence number
+ *
+ * @param[in] handle         batch stream handle
+ * @param[in] field_name     name of the schema field
+ * @param[in] filter         field filter, NULL to remove the filter of the field
+ *
+ * @return
+ *      BB_SUCCESS: Filter set
+ *      BB_NULL_CHECK_FAILURE: If the handle or field_name is NULL
+ *      BB_FAILURE: If the batch stream has no schema, the field is not in it or the filter is invalid
+ */
+bytebeam_err_t bytebeam_batch_set_field_filter(bytebeam_batch_handle_t handle, const char *field_name, const bytebeam_field_filter_t *filter);
+
+/**
+ * @brief MQTT Data Publish Thread
+ *
+ * @param[in] pv        task argument
+ * 
+ * @return
+ *
+ */
+void bytebeam_mqtt_thread_entry(void *pv);
+
+/**
+ * @brief Wake up the MQTT Data Publish Thread so it services the batch streams and the store right away
+ *
+ * @return
+ *      void
+ */
+void bytebeam_mqtt_thread_wake(void);
+
+/**
+ * @brief Check if the caller is the MQTT Data Publish Thread, which owns the buffers only it may use
+ *
+ * @return
+ *      true  : The caller is the MQTT Data Publish Thread
+ *      false : The caller is another task or the thread is not running
+ */
+bool bytebeam_mqtt_thread_is_current(void);
+
+#endif /* BYTEBEAM_BATCH_H */
@@ -0,0 +1,166 @@
+#ifndef BYTEBEAM_CBOR_H
+#define BYTEBEAM_CBOR_H
+
+#include "bytebeam_client.h"
+
+/*This macro is used to specify an array or map of unknown length, it must be closed with bytebeam_cbor_end*/
+#define BYTEBEAM_CBOR_INDEFINITE SIZE_MAX
+
+/**
+ * @struct bytebeam_cbor_writer_t
+ * This struct tracks a CBOR (RFC 8949) message being encoded in a caller provided buffer
+ *
+ * @note  Running out of space is sticky, the put functions turn into no-ops and the error is reported once by
+ *        bytebeam_cbor_writer_finish, so a message can be encoded without checking every call
+ *
+ * @var bytebeam_cbor_writer_t::buf
+ * Buffer holding the message
+ * @var bytebeam_cbor_writer_t::capacity
+ * Size of the buffer in bytes
+ * @var bytebeam_cbor_writer_t::len
+ * Number of bytes written to the buffer so far
+ * @var bytebeam_cbor_writer_t::overflow
+ * Set once an item did not fit in the buffer
+ */
+typedef struct bytebeam_cbor_writer {
+    uint8_t *buf;
+    size_t capacity;
+    size_t len;
+    bool overflow;
+} bytebeam_cbor_writer_t;
+
+/**
+ * @brief Initialize the CBOR writer
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] buf         buffer to encode the message in
+ * @param[in] capacity    size of the buffer in bytes
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_writer_init(bytebeam_cbor_writer_t *writer, void *buf, size_t capacity);
+
+/**
+ * @brief Start an array, followed by count items
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] count       number of items, BYTEBEAM_CBOR_INDEFINITE if not known upfront
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_begin_array(bytebeam_cbor_writer_t *writer, size_t count);
+
+/**
+ * @brief Start a map, followed by count key value pairs
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] count       number of pairs, BYTEBEAM_CBOR_INDEFINITE if not known upfront
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_begin_map(bytebeam_cbor_writer_t *writer, size_t count);
+
+/**
+ * @brief Close an array or map started with BYTEBEAM_CBOR_INDEFINITE
+ *
+ * @param[in] writer      CBOR writer handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_end(bytebeam_cbor_writer_t *writer);
+
+/**
+ * @brief Encode an unsigned integer
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_put_uint(bytebeam_cbor_writer_t *writer, uint64_t value);
+
+/**
+ * @brief Encode a signed integer
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_put_int(bytebeam_cbor_writer_t *writer, int64_t value);
+
+/**
+ * @brief Encode a floating point number, as single precision whenever that is lossless
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_put_double(bytebeam_cbor_writer_t *writer, double value);
+
+/**
+ * @brief Encode a boolean
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_put_bool(bytebeam_cbor_writer_t *writer, bool value);
+
+/**
+ * @brief Encode a null
+ *
+ * @param[in] writer      CBOR writer handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_put_null(bytebeam_cbor_writer_t *writer);
+
+/**
+ * @brief Encode a text string, also used for the map keys
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] str         NULL terminated string, NULL is encoded as null
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_put_string(bytebeam_cbor_writer_t *writer, const char *str);
+
+/**
+ * @brief Encode a text string that is not NULL terminated
+ *
+ * @param[in] writer      CBOR writer handle
+ * @param[in] str         string
+ * @param[in] len         length of the string in bytes
+ *
+ * @return
+ *      void
+ */
+void bytebeam_cbor_put_string_len(bytebeam_cbor_writer_t *writer, const char *str, size_t len);
+
+/**
+ * @brief Get the encoded message
+ *
+ * @param[in]  writer     CBOR writer handle
+ * @param[out] len        length of the message in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Message encoded
+ *      BB_FAILURE: The message did not fit in the buffer
+ *      BB_NULL_CHECK_FAILURE: If the writer or len is NULL
+ */
+bytebeam_err_t bytebeam_cbor_writer_finish(bytebeam_cbor_writer_t *writer, size_t *len);
+
+#endif /* BYTEBEAM_CBOR_H */
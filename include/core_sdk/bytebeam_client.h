@@ -12,10 +12,10 @@
 /*This macro is used to specify the maximum length of bytebeam project id string*/
 #define BYTEBEAM_PROJECT_ID_STR_LEN 100
 
-/*This macro is used to specify the maximum number of actions that need to be handled for particular device*/
+/*This macro is used to specify the number of actions the action table is sized for at first, it grows beyond on demand*/
 #define BYTEBEAM_NUMBER_OF_ACTIONS 10
 
-struct bytebeam_client_t;
+struct bytebeam_client;
 typedef esp_mqtt_client_handle_t bytebeam_client_handle_t;
 typedef esp_mqtt_client_config_t bytebeam_client_config_t;
 
@@ -48,15 +48,34 @@ typedef struct bytebeam_device_config {
  * @struct bytebeam_action_functions_map_t
  * This sturct contains name and function pointer for particular action 
  * @var bytebeam_action_functions_map_t::name
- * Name of particular action 
+ * Name of particular action, copied when the handler is added. NULL for an empty slot
+ * @var bytebeam_action_functions_map_t::hash
+ * Hash of the name, picks the slot of the action in the table
  * @var bytebeam_action_functions_map_t::func
  * Pointer to action handler function for particular action
  */
 typedef struct bytebeam_action_functions_map {
-    const char *name;
-    int (*func)(struct bytebeam_client_t *bytebeam_client, char *args, char *action_id);
+    char *name;
+    uint32_t hash;
+    int (*func)(struct bytebeam_client *bytebeam_client, char *args, char *action_id);
 } bytebeam_action_functions_map_t;
 
+/**
+ * @struct bytebeam_action_table_t
+ * This struct contains the action handlers hashed by their name, an action is looked up in constant time
+ * @var bytebeam_action_table_t::slots
+ * Open addressed slots, NULL until the first handler is added
+ * @var bytebeam_action_table_t::capacity
+ * Number of slots, a power of two
+ * @var bytebeam_action_table_t::count
+ * Number of handlers in the table
+ */
+typedef struct bytebeam_action_table {
+    bytebeam_action_functions_map_t *slots;
+    uint32_t capacity;
+    uint32_t count;
+} bytebeam_action_table_t;
+
 typedef struct bytebeam_device_shadow_stream {
     uint64_t sequence;
     unsigned long long milliseconds;
@@ -71,10 +90,23 @@ typedef struct bytebeam_device_shadow_stream {
 
 typedef struct bytebeam_device_shadow {
     char custom_json_str[CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN]; 
-    int (*updater)(struct bytebeam_client_t *bytebeam_client);
+    int (*updater)(struct bytebeam_client *bytebeam_client);
     bytebeam_device_shadow_stream_t stream;
 } bytebeam_device_shadow_t;
 
+/**
+ * @struct bytebeam_client_topics_t
+ * This struct contains the client level topics, they are built once by bytebeam_init and share one allocation
+ * @var bytebeam_client_topics_t::actions
+ * Topic the actions are received on
+ * @var bytebeam_client_topics_t::action_status
+ * Topic the action status is published on, the variant follows the sdk message encoding
+ */
+typedef struct bytebeam_client_topics {
+    char *actions;
+    char *action_status;
+} bytebeam_client_topics_t;
+
 /**
  * @struct bytebeam_client_t
  * This struct contains all the configuration for instance of MQTT client
@@ -85,18 +117,21 @@ typedef struct bytebeam_device_shadow {
  * @var bytebeam_client_t::mqtt_cfg
  * ESP MQTT client configuration structure
  * @var bytebeam_client_t::action_funcs
- * Array containing action handler structure for all the configured actions on Bytebeam platform
+ * Table containing action handler structure for all the configured actions on Bytebeam platform
  * @var bytebeam_client_t::connection_status
  * Connection status of MQTT client instance.
+ * @var bytebeam_client_t::topics
+ * Client level topics
  */
 typedef struct bytebeam_client {
     bytebeam_device_config_t device_cfg;
     bytebeam_client_handle_t client;
     bytebeam_client_config_t mqtt_cfg;
-    bytebeam_action_functions_map_t action_funcs[BYTEBEAM_NUMBER_OF_ACTIONS];
+    bytebeam_action_table_t action_funcs;
     bytebeam_device_shadow_t device_shadow;
     int connection_status;
     bool use_device_config_data;
+    bytebeam_client_topics_t topics;
 } bytebeam_client_t;
 
 /*Status codes propogated via functions*/
@@ -104,9 +139,17 @@ typedef enum bytebeam_err {
     BB_SUCCESS = 0,
     BB_FAILURE = -1,
     BB_NULL_CHECK_FAILURE = -2,
-    BB_PROGRESS_OUT_OF_RANGE = -3
+    BB_PROGRESS_OUT_OF_RANGE = -3,
+    BB_WOULD_BLOCK = -4,
+    BB_RATE_LIMITED = -5
 } bytebeam_err_t;
 
+/*Payload encodings, every encoding is published on its own topic variant*/
+typedef enum bytebeam_encoding {
+    BYTEBEAM_ENCODING_JSON,     //!< JSON array, published on the jsonarray topic
+    BYTEBEAM_ENCODING_CBOR      //!< CBOR array, published on the cborarray topic
+} bytebeam_encoding_t;
+
 /**
  * @brief Initializes bytebeam MQTT client.
  *
@@ -159,4 +202,17 @@ bytebeam_err_t bytebeam_stop(bytebeam_client_t *bytebeam_client);
  */
 bytebeam_err_t bytebeam_destroy(bytebeam_client_t *bytebeam_client);
 
+/**
+ * @brief Get the number of bytes held in the MQTT outbox, i.e. the messages waiting to be sent or acknowledged
+ *
+ * @param[in]  bytebeam_client    bytebeam client handle
+ * @param[out] outbox_size        outbox occupancy in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Outbox occupancy read successfully
+ *      BB_FAILURE: If the client is not initialized or the MQTT client can not report it
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or outbox_size is NULL
+ */
+bytebeam_err_t bytebeam_get_outbox_size(bytebeam_client_t *bytebeam_client, int *outbox_size);
+
 #endif /* BYTEBEAM_CLIENT_H */
\ No newline at end of file
@@ -0,0 +1,95 @@
+#ifndef BYTEBEAM_COMPRESS_H
+#define BYTEBEAM_COMPRESS_H
+
+#include "bytebeam_client.h"
+
+/*
+ *  Compressed payload format (LZSS)
+ *
+ *  bytes 0-3 : uncompressed length, little endian
+ *  then groups of one flag byte followed by up to 8 items, flag bit n (LSB first) describes item n
+ *      bit set   : literal, 1 byte copied as is
+ *      bit clear : match, 2 bytes b0 b1, copy (((b1 >> 4) << 8) | b0) + 1 bytes back, (b1 & 0x0F) + 3 bytes long
+ */
+
+/*This macro is used to specify the topic suffix of the compressed publishes*/
+#define BYTEBEAM_COMPRESS_TOPIC_SUFFIX "/lz"
+
+/*This macro is used to specify the size of the compressed payload header*/
+#define BYTEBEAM_COMPRESS_HEADER_LEN 4
+
+/**
+ * @struct bytebeam_compress_stats_t
+ * This struct contains the compression statistics since boot
+ * @var bytebeam_compress_stats_t::publishes
+ * Number of publishes sent compressed
+ * @var bytebeam_compress_stats_t::skipped
+ * Number of publishes above the threshold sent uncompressed because compression did not pay off
+ * @var bytebeam_compress_stats_t::bytes_in
+ * Uncompressed bytes of the compressed publishes
+ * @var bytebeam_compress_stats_t::bytes_out
+ * Compressed bytes of the compressed publishes
+ * @var bytebeam_compress_stats_t::cpu_time_us
+ * Time spent compressing, including the attempts that did not pay off
+ */
+typedef struct bytebeam_compress_stats {
+    uint32_t publishes;
+    uint32_t skipped;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t cpu_time_us;
+} bytebeam_compress_stats_t;
+
+/**
+ * @brief Get the worst case size of the compressed payload
+ *
+ * @param[in] len        length of the payload in bytes
+ *
+ * @return
+ *      size of the buffer that can hold any compressed payload of len bytes
+ */
+size_t bytebeam_compress_bound(size_t len);
+
+/**
+ * @brief Compress a payload
+ *
+ * @note  The call uses a static work area of about 12 KB, so it must only be made from one task. The SDK compresses
+ *        from the MQTT task
+ *
+ * @param[in]  in              payload to compress
+ * @param[in]  in_len          length of the payload in bytes
+ * @param[out] out             buffer for the compressed payload
+ * @param[in]  out_capacity    size of the buffer, the compression gives up once it is exceeded
+ * @param[out] out_len         length of the compressed payload in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Payload compressed
+ *      BB_NULL_CHECK_FAILURE: If the in, out or out_len is NULL
+ *      BB_FAILURE: If the compressed payload does not fit in the buffer
+ */
+bytebeam_err_t bytebeam_compress(const char *in, size_t in_len, char *out, size_t out_capacity, size_t *out_len);
+
+/**
+ * @brief Account a publish in the compression statistics
+ *
+ * @param[in] in_len           uncompressed length in bytes
+ * @param[in] out_len          compressed length in bytes, 0 if the publish was sent uncompressed
+ * @param[in] cpu_time_us      time spent compressing
+ *
+ * @return
+ *      void
+ */
+void bytebeam_compress_account(size_t in_len, size_t out_len, uint32_t cpu_time_us);
+
+/**
+ * @brief Get the compression statistics
+ *
+ * @param[out] stats           compression statistics
+ *
+ * @return
+ *      BB_SUCCESS: Statistics copied
+ *      BB_NULL_CHECK_FAILURE: If the stats is NULL
+ */
+bytebeam_err_t bytebeam_compress_get_stats(bytebeam_compress_stats_t *stats);
+
+#endif /* BYTEBEAM_COMPRESS_H */
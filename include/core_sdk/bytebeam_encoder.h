@@ -0,0 +1,182 @@
+#ifndef BYTEBEAM_ENCODER_H
+#define BYTEBEAM_ENCODER_H
+
+#include "bytebeam_client.h"
+#include "bytebeam_json.h"
+#include "bytebeam_cbor.h"
+
+/*This macro is used to specify the encoding of the messages built by the sdk itself, as selected in the config menu*/
+#if CONFIG_BYTEBEAM_MESSAGE_ENCODING_IS_CBOR
+#define BYTEBEAM_MESSAGE_ENCODING BYTEBEAM_ENCODING_CBOR
+#else
+#define BYTEBEAM_MESSAGE_ENCODING BYTEBEAM_ENCODING_JSON
+#endif
+
+/**
+ * @struct bytebeam_encoder_t
+ * This struct writes a message with either the JSON or the CBOR writer through one set of calls
+ *
+ * @note  The arrays and maps are given their item count upfront for CBOR and closed with bytebeam_encoder_end for
+ *        JSON, so both calls are always made
+ *
+ * @var bytebeam_encoder_t::encoding
+ * Encoding of the message
+ * @var bytebeam_encoder_t::json
+ * JSON writer, used if the encoding is BYTEBEAM_ENCODING_JSON
+ * @var bytebeam_encoder_t::cbor
+ * CBOR writer, used if the encoding is BYTEBEAM_ENCODING_CBOR
+ */
+typedef struct bytebeam_encoder {
+    bytebeam_encoding_t encoding;
+    union {
+        bytebeam_json_writer_t json;
+        bytebeam_cbor_writer_t cbor;
+    };
+} bytebeam_encoder_t;
+
+/**
+ * @brief Initialize the encoder
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] encoding    encoding of the message
+ * @param[in] buf         buffer to encode the message in
+ * @param[in] capacity    size of the buffer in bytes
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_init(bytebeam_encoder_t *encoder, bytebeam_encoding_t encoding, void *buf, size_t capacity);
+
+/**
+ * @brief Start an array
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] count       exact number of items that follow
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_begin_array(bytebeam_encoder_t *encoder, size_t count);
+
+/**
+ * @brief Start a map
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] count       exact number of key value pairs that follow
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_begin_map(bytebeam_encoder_t *encoder, size_t count);
+
+/**
+ * @brief Close the innermost array or map
+ *
+ * @param[in] encoder     encoder handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_end(bytebeam_encoder_t *encoder);
+
+/**
+ * @brief Encode a map key
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] key         NULL terminated key
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_key(bytebeam_encoder_t *encoder, const char *key);
+
+/**
+ * @brief Encode an unsigned integer
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_uint(bytebeam_encoder_t *encoder, uint64_t value);
+
+/**
+ * @brief Encode a signed integer
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_int(bytebeam_encoder_t *encoder, int64_t value);
+
+/**
+ * @brief Encode a floating point number
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_double(bytebeam_encoder_t *encoder, double value);
+
+/**
+ * @brief Encode a single precision number
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_float(bytebeam_encoder_t *encoder, float value);
+
+/**
+ * @brief Encode a boolean
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] value       value to encode
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_bool(bytebeam_encoder_t *encoder, bool value);
+
+/**
+ * @brief Encode a null
+ *
+ * @param[in] encoder     encoder handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_null(bytebeam_encoder_t *encoder);
+
+/**
+ * @brief Encode a string
+ *
+ * @param[in] encoder     encoder handle
+ * @param[in] str         NULL terminated string, NULL is encoded as null
+ *
+ * @return
+ *      void
+ */
+void bytebeam_encoder_put_string(bytebeam_encoder_t *encoder, const char *str);
+
+/**
+ * @brief Get the encoded message
+ *
+ * @param[in]  encoder    encoder handle
+ * @param[out] len        length of the message in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Message encoded
+ *      BB_FAILURE: The message did not fit in the buffer
+ *      BB_NULL_CHECK_FAILURE: If the encoder or len is NULL
+ */
+bytebeam_err_t bytebeam_encoder_finish(bytebeam_encoder_t *encoder, size_t *len);
+
+#endif /* BYTEBEAM_ENCODER_H */
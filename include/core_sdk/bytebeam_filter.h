@@ -0,0 +1,102 @@
+#ifndef BYTEBEAM_FILTER_H
+#define BYTEBEAM_FILTER_H
+
+#include "bytebeam_client.h"
+
+/* This enum represents the change a field value must make before it is reported again */
+typedef enum bytebeam_filter_mode {
+    BYTEBEAM_FILTER_MODE_NONE,              //!< Every sample counts as a change, only the intervals and decimation apply
+    BYTEBEAM_FILTER_MODE_DEADBAND_ABS,      //!< Change of more than threshold from the last reported value
+    BYTEBEAM_FILTER_MODE_DEADBAND_PCT       //!< Change of more than threshold percent of the last reported value
+} bytebeam_filter_mode_t;
+
+/**
+ * @struct bytebeam_field_filter_t
+ * This struct contains the reporting filter of a single field, a sample is reported if it changed enough and the
+ * minimum interval passed since the last report, or if the maximum interval passed whatever its value
+ * @var bytebeam_field_filter_t::mode
+ * Change the value must make to be reported
+ * @var bytebeam_field_filter_t::threshold
+ * Deadband of the mode, in the field unit or in percent
+ * @var bytebeam_field_filter_t::min_interval_ms
+ * Shortest time between two reports, 0 for no limit
+ * @var bytebeam_field_filter_t::max_interval_ms
+ * Longest time between two reports, 0 to only report changes
+ * @var bytebeam_field_filter_t::decimation
+ * Only every decimation-th sample is considered, 0 or 1 to consider every sample
+ */
+typedef struct bytebeam_field_filter {
+    bytebeam_filter_mode_t mode;
+    double threshold;
+    uint32_t min_interval_ms;
+    uint32_t max_interval_ms;
+    uint32_t decimation;
+} bytebeam_field_filter_t;
+
+/**
+ * @struct bytebeam_filter_state_t
+ * This struct contains the running state of a field filter
+ * @var bytebeam_filter_state_t::reported
+ * Set once a sample was reported, the first sample always is
+ * @var bytebeam_filter_state_t::last_value
+ * Last reported value
+ * @var bytebeam_filter_state_t::last_report_ms
+ * Uptime of the last report
+ * @var bytebeam_filter_state_t::samples
+ * Samples seen since the last considered one, for the decimation
+ */
+typedef struct bytebeam_filter_state {
+    bool reported;
+    double last_value;
+    long long last_report_ms;
+    uint32_t samples;
+} bytebeam_filter_state_t;
+
+/**
+ * @brief Check a field filter
+ *
+ * @param[in] filter       field filter
+ *
+ * @return
+ *      BB_SUCCESS: Filter is valid
+ *      BB_FAILURE: If the mode is unknown, the threshold is negative or the minimum interval exceeds the maximum one
+ *      BB_NULL_CHECK_FAILURE: If the filter is NULL
+ */
+bytebeam_err_t bytebeam_filter_validate(const bytebeam_field_filter_t *filter);
+
+/**
+ * @brief Reset the running state of a field filter, the next sample is reported
+ *
+ * @param[in] state        filter state
+ *
+ * @return
+ *      void
+ */
+void bytebeam_filter_reset(bytebeam_filter_state_t *state);
+
+/**
+ * @brief Check if a sample should be reported, a sample skipped by the decimation is counted
+ *
+ * @param[in] filter       field filter
+ * @param[in] state        filter state
+ * @param[in] value        sample value
+ * @param[in] now_ms       uptime of the sample
+ *
+ * @return
+ *      true if the sample should be reported
+ */
+bool bytebeam_filter_wants(const bytebeam_field_filter_t *filter, bytebeam_filter_state_t *state, double value, long long now_ms);
+
+/**
+ * @brief Record a reported sample, it becomes the reference of the deadband and the intervals
+ *
+ * @param[in] state        filter state
+ * @param[in] value        reported value
+ * @param[in] now_ms       uptime of the report
+ *
+ * @return
+ *      void
+ */
+void bytebeam_filter_reported(bytebeam_filter_state_t *state, double value, long long now_ms);
+
+#endif /* BYTEBEAM_FILTER_H */
@@ -0,0 +1,114 @@
+#ifndef BYTEBEAM_FLOW_H
+#define BYTEBEAM_FLOW_H
+
+#include "bytebeam_client.h"
+#include "bytebeam_inflight.h"
+
+/*This macro is used to specify how often the flow state is checked again while the producers are paused*/
+#define BYTEBEAM_FLOW_RECHECK_MS 100
+
+/*This macro is used to specify how often a bulk publish yielding to the control lane is tried again*/
+#define BYTEBEAM_FLOW_YIELD_MS 10
+
+/**
+ * @struct bytebeam_flow_config_t
+ * This struct contains the watermarks of the stream publish flow control, the producers are paused once any high
+ * watermark is reached and resumed once every value is back at or below its low watermark. The watermarks hold back
+ * the bulk lane only, the control lane keeps publishing into the reserved outbox capacity above the high watermark
+ * @var bytebeam_flow_config_t::outbox_high_bytes
+ * Outbox occupancy that pauses the producers
+ * @var bytebeam_flow_config_t::outbox_low_bytes
+ * Outbox occupancy that resumes the producers
+ * @var bytebeam_flow_config_t::inflight_high
+ * Number of unacknowledged QoS 1 publishes that pauses the producers
+ * @var bytebeam_flow_config_t::inflight_low
+ * Number of unacknowledged QoS 1 publishes that resumes the producers
+ * @var bytebeam_flow_config_t::control_reserved_bytes
+ * Outbox capacity above outbox_high_bytes kept for the control lane
+ * @var bytebeam_flow_config_t::control_yield_ms
+ * Longest time the retried bulk publishes yield after a control publish that is not acknowledged yet, 0 to never
+ * yield
+ */
+typedef struct bytebeam_flow_config {
+    int outbox_high_bytes;
+    int outbox_low_bytes;
+    int inflight_high;
+    int inflight_low;
+    int control_reserved_bytes;
+    uint32_t control_yield_ms;
+} bytebeam_flow_config_t;
+
+/**
+ * @brief Flow control callback, called from the task that saw the state change so it must not block
+ *
+ * @param[in] paused       true if the producers should pause, false once they can resume
+ * @param[in] user_data    user data given with the callback
+ */
+typedef void (*bytebeam_flow_cb_t)(bool paused, void *user_data);
+
+/**
+ * @brief Set the flow control watermarks, they default to the config menu values
+ *
+ * @param[in] config       flow control watermarks
+ *
+ * @return
+ *      BB_SUCCESS: Watermarks set
+ *      BB_FAILURE: If a low watermark is not below its high watermark or the reserved capacity is negative
+ *      BB_NULL_CHECK_FAILURE: If the config is NULL
+ */
+bytebeam_err_t bytebeam_flow_set_config(const bytebeam_flow_config_t *config);
+
+/**
+ * @brief Register the callback that pauses and resumes the producers
+ *
+ * @param[in] callback     flow control callback, NULL to remove it
+ * @param[in] user_data    user data passed to the callback
+ *
+ * @return
+ *      BB_SUCCESS: Callback registered
+ */
+bytebeam_err_t bytebeam_flow_register_callback(bytebeam_flow_cb_t callback, void *user_data);
+
+/**
+ * @brief Check if a publish can be made, a bulk check also updates the flow state from the outbox occupancy and
+ *        the in flight publishes
+ *
+ * @param[in] bytebeam_client    bytebeam client handle
+ * @param[in] priority           priority lane of the publish
+ *
+ * @return
+ *      BB_SUCCESS: A publish can be made
+ *      BB_WOULD_BLOCK: The lane is held back, the publish should be made again later
+ */
+bytebeam_err_t bytebeam_flow_check(bytebeam_client_t *bytebeam_client, bytebeam_publish_priority_t priority);
+
+/**
+ * @brief Check if the bulk lane should yield to the control lane, true while a control publish made within the last
+ *        control_yield_ms waits for its acknowledgement
+ *
+ * @note  Only the senders the SDK retries by itself yield, the batch transmit, the store drain and the coalesced
+ *        publishes. An application publish is not refused for it, the reserved outbox capacity keeps the control
+ *        lane going meanwhile
+ *
+ * @return
+ *      true if a retried bulk publish should be made again later
+ */
+bool bytebeam_flow_is_yielding(void);
+
+/**
+ * @brief Check the flow state again if the producers are paused, called every BYTEBEAM_FLOW_RECHECK_MS meanwhile
+ *
+ * @return
+ *      void
+ */
+void bytebeam_flow_poll(void);
+
+/**
+ * @brief Check if the producers are paused, without updating the flow state
+ *
+ * @return
+ *      true if the producers are paused
+ */
+bool bytebeam_flow_is_paused(void);
+
+#endif /* BYTEBEAM_FLOW_H */
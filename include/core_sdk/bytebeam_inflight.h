@@ -0,0 +1,135 @@
+#ifndef BYTEBEAM_INFLIGHT_H
+#define BYTEBEAM_INFLIGHT_H
+
+#include "bytebeam_client.h"
+
+/* This enum represents how a publish completed */
+typedef enum bytebeam_publish_status {
+    BYTEBEAM_PUBLISH_ACKED,         //!< Acknowledged by the broker
+    BYTEBEAM_PUBLISH_SENT,          //!< Handed to the MQTT client without an acknowledgement to wait for
+    BYTEBEAM_PUBLISH_STORED,        //!< Kept in the store and forward partition while offline
+    BYTEBEAM_PUBLISH_TIMED_OUT      //!< Not acknowledged within the timeout or dropped from the outbox
+} bytebeam_publish_status_t;
+
+/* This enum represents the priority lane of a publish */
+typedef enum bytebeam_publish_priority {
+    BYTEBEAM_PRIORITY_CONTROL,      //!< Action status, OTA progress and device shadow, bulk publishes yield to it
+    BYTEBEAM_PRIORITY_BULK          //!< Telemetry, held back while control publishes are in flight
+} bytebeam_publish_priority_t;
+
+/**
+ * @brief Publish completion callback, it may be called from the MQTT task so it must not block
+ *
+ * @param[in] msg_id       message id of the publish, 0 if it has none
+ * @param[in] status       how the publish completed
+ * @param[in] latency_ms   time from the publish call to its completion
+ * @param[in] user_data    user data given with the publish
+ */
+typedef void (*bytebeam_publish_cb_t)(int msg_id, bytebeam_publish_status_t status, uint32_t latency_ms, void *user_data);
+
+/**
+ * @struct bytebeam_publish_stats_t
+ * This struct contains the acknowledgement statistics of the QoS 1 publishes
+ * @var bytebeam_publish_stats_t::in_flight
+ * Publishes waiting for their acknowledgement
+ * @var bytebeam_publish_stats_t::control_in_flight
+ * Control lane publishes waiting for their acknowledgement, included in in_flight
+ * @var bytebeam_publish_stats_t::acked
+ * Publishes acknowledged
+ * @var bytebeam_publish_stats_t::timed_out
+ * Publishes that timed out
+ * @var bytebeam_publish_stats_t::untracked
+ * Publishes sent without tracking because the in flight table was full
+ * @var bytebeam_publish_stats_t::latency_last_ms
+ * Latency of the last acknowledged publish
+ * @var bytebeam_publish_stats_t::latency_min_ms
+ * Lowest latency seen
+ * @var bytebeam_publish_stats_t::latency_max_ms
+ * Highest latency seen
+ * @var bytebeam_publish_stats_t::latency_avg_ms
+ * Mean latency of the acknowledged publishes
+ */
+typedef struct bytebeam_publish_stats {
+    uint32_t in_flight;
+    uint32_t control_in_flight;
+    uint32_t acked;
+    uint32_t timed_out;
+    uint32_t untracked;
+    uint32_t latency_last_ms;
+    uint32_t latency_min_ms;
+    uint32_t latency_max_ms;
+    uint32_t latency_avg_ms;
+} bytebeam_publish_stats_t;
+
+/**
+ * @brief Track a QoS 1 publish until its acknowledgement, an acknowledgement that arrived before the call is matched
+ *
+ * @param[in] msg_id       message id returned by the MQTT client
+ * @param[in] priority     priority lane of the publish
+ * @param[in] start_us     uptime in microseconds taken just before the publish call
+ * @param[in] callback     completion callback, may be NULL to only account the latency
+ * @param[in] user_data    user data passed to the callback
+ *
+ * @return
+ *      BB_SUCCESS: Publish tracked or completed
+ *      BB_FAILURE: If the in flight table is full, the callback is not called
+ */
+bytebeam_err_t bytebeam_inflight_add(int msg_id, bytebeam_publish_priority_t priority, long long start_us, bytebeam_publish_cb_t callback, void *user_data);
+
+/**
+ * @brief Complete a tracked publish, called from the MQTT event handler
+ *
+ * @param[in] msg_id       message id of the publish
+ * @param[in] status       BYTEBEAM_PUBLISH_ACKED or BYTEBEAM_PUBLISH_TIMED_OUT
+ *
+ * @return
+ *      void
+ */
+void bytebeam_inflight_complete(int msg_id, bytebeam_publish_status_t status);
+
+/**
+ * @brief Time out the publishes waiting longer than CONFIG_BYTEBEAM_PUBLISH_ACK_TIMEOUT_MS
+ *
+ * @param[out] next_expiry_ms    time until the next publish times out, UINT32_MAX if nothing is in flight
+ *
+ * @return
+ *      void
+ */
+void bytebeam_inflight_expire(uint32_t *next_expiry_ms);
+
+/**
+ * @brief Time out every tracked publish, called when the client is destroyed
+ *
+ * @return
+ *      void
+ */
+void bytebeam_inflight_reset(void);
+
+/**
+ * @brief Get the number of publishes waiting for their acknowledgement
+ *
+ * @return
+ *      number of tracked publishes in flight
+ */
+uint32_t bytebeam_inflight_count(void);
+
+/**
+ * @brief Get the number of control lane publishes waiting for their acknowledgement
+ *
+ * @return
+ *      number of tracked control publishes in flight
+ */
+uint32_t bytebeam_inflight_control_count(void);
+
+/**
+ * @brief Get the acknowledgement statistics
+ *
+ * @param[out] stats       acknowledgement statistics
+ *
+ * @return
+ *      BB_SUCCESS: Statistics read
+ *      BB_NULL_CHECK_FAILURE: If the stats is NULL
+ */
+bytebeam_err_t bytebeam_inflight_get_stats(bytebeam_publish_stats_t *stats);
+
+#endif /* BYTEBEAM_INFLIGHT_H */
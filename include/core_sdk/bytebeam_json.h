@@ -0,0 +1,210 @@
+#ifndef BYTEBEAM_JSON_H
+#define BYTEBEAM_JSON_H
+
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the maximum nesting of arrays and maps in a JSON message*/
+#define BYTEBEAM_JSON_MAX_DEPTH 32
+
+/**
+ * @struct bytebeam_json_writer_t
+ * This struct tracks a compact JSON message being written in a caller provided buffer, nothing is allocated
+ *
+ * @note  Running out of space is sticky, the put functions turn into no-ops and the error is reported once by
+ *        bytebeam_json_writer_finish, so a message can be written without checking every call
+ *
+ * @var bytebeam_json_writer_t::buf
+ * Buffer holding the message
+ * @var bytebeam_json_writer_t::capacity
+ * Size of the buffer in bytes
+ * @var bytebeam_json_writer_t::len
+ * Number of bytes written to the buffer so far
+ * @var bytebeam_json_writer_t::overflow
+ * Set once an item did not fit in the buffer or the nesting went deeper than BYTEBEAM_JSON_MAX_DEPTH
+ * @var bytebeam_json_writer_t::depth
+ * Number of arrays and maps currently open
+ * @var bytebeam_json_writer_t::is_map
+ * Bit n is set if the container at depth n is a map
+ * @var bytebeam_json_writer_t::has_items
+ * Bit n is set once the container at depth n holds an item, the next one is preceded by a comma
+ * @var bytebeam_json_writer_t::after_key
+ * Set between a map key and its value
+ */
+typedef struct bytebeam_json_writer {
+    char *buf;
+    size_t capacity;
+    size_t len;
+    bool overflow;
+    uint8_t depth;
+    uint32_t is_map;
+    uint32_t has_items;
+    bool after_key;
+} bytebeam_json_writer_t;
+
+/**
+ * @brief Initialize the JSON writer
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] buf         buffer to write the message in
+ * @param[in] capacity    size of the buffer in bytes, including the NULL terminator
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_writer_init(bytebeam_json_writer_t *writer, void *buf, size_t capacity);
+
+/**
+ * @brief Start an array
+ *
+ * @param[in] writer      JSON writer handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_begin_array(bytebeam_json_writer_t *writer);
+
+/**
+ * @brief Start a map, each value must be preceded by bytebeam_json_put_key
+ *
+ * @param[in] writer      JSON writer handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_begin_map(bytebeam_json_writer_t *writer);
+
+/**
+ * @brief Close the innermost array or map
+ *
+ * @param[in] writer      JSON writer handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_end(bytebeam_json_writer_t *writer);
+
+/**
+ * @brief Write a map key
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] key         NULL terminated key
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_key(bytebeam_json_writer_t *writer, const char *key);
+
+/**
+ * @brief Write an unsigned integer
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] value       value to write
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_uint(bytebeam_json_writer_t *writer, uint64_t value);
+
+/**
+ * @brief Write a signed integer
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] value       value to write
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_int(bytebeam_json_writer_t *writer, int64_t value);
+
+/**
+ * @brief Write a floating point number with the fewest digits that read back the same, NaN and infinity as null
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] value       value to write
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_double(bytebeam_json_writer_t *writer, double value);
+
+/**
+ * @brief Write a single precision number with the fewest digits that read back the same, NaN and infinity as null
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] value       value to write
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_float(bytebeam_json_writer_t *writer, float value);
+
+/**
+ * @brief Write a boolean
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] value       value to write
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_bool(bytebeam_json_writer_t *writer, bool value);
+
+/**
+ * @brief Write a null
+ *
+ * @param[in] writer      JSON writer handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_null(bytebeam_json_writer_t *writer);
+
+/**
+ * @brief Write a string, escaping it as needed
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] str         NULL terminated string, NULL is written as null
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_string(bytebeam_json_writer_t *writer, const char *str);
+
+/**
+ * @brief Write a string that is not NULL terminated, escaping it as needed
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] str         string
+ * @param[in] len         length of the string in bytes
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_string_len(bytebeam_json_writer_t *writer, const char *str, size_t len);
+
+/**
+ * @brief Write a value that is already serialized, it is copied as is
+ *
+ * @param[in] writer      JSON writer handle
+ * @param[in] json        serialized JSON value
+ * @param[in] len         length of the value in bytes
+ *
+ * @return
+ *      void
+ */
+void bytebeam_json_put_raw(bytebeam_json_writer_t *writer, const char *json, size_t len);
+
+/**
+ * @brief Get the written message, it is NULL terminated
+ *
+ * @param[in]  writer     JSON writer handle
+ * @param[out] len        length of the message in bytes, without the NULL terminator
+ *
+ * @return
+ *      BB_SUCCESS: Message written
+ *      BB_FAILURE: The message did not fit in the buffer or an array or map is still open
+ *      BB_NULL_CHECK_FAILURE: If the writer or len is NULL
+ */
+bytebeam_err_t bytebeam_json_writer_finish(bytebeam_json_writer_t *writer, size_t *len);
+
+#endif /* BYTEBEAM_JSON_H */
@@ -0,0 +1,149 @@
+#ifndef BYTEBEAM_QUEUE_H
+#define BYTEBEAM_QUEUE_H
+
+#include <stdatomic.h>
+#include "bytebeam_client.h"
+
+/*This macro is used to specify how many times an overwriting producer yields while the slot it needs is still held*/
+#define BYTEBEAM_QUEUE_OVERWRITE_YIELDS 16
+
+/*This macro is used to specify how many ticks an overwriting producer then waits before the record is dropped*/
+#define BYTEBEAM_QUEUE_OVERWRITE_DELAYS 2
+
+/* This enum represents what a producer does when the queue is full */
+typedef enum bytebeam_queue_policy {
+    BYTEBEAM_QUEUE_POLICY_DROP,         //!< Reject the new record
+    BYTEBEAM_QUEUE_POLICY_OVERWRITE,    //!< Evict the oldest record to make room for the new one
+    BYTEBEAM_QUEUE_POLICY_BLOCK         //!< Wait for the consumer to make room, up to the block timeout
+} bytebeam_queue_policy_t;
+
+/**
+ * @struct bytebeam_queue_t
+ * Bounded lock-free multi producer single consumer ring of fixed size records
+ * @var bytebeam_queue_t::enqueue_pos
+ * Position of the next slot to be claimed by a producer
+ * @var bytebeam_queue_t::dequeue_pos
+ * Position of the next slot to be claimed by the consumer
+ * @var bytebeam_queue_t::mask
+ * Queue depth minus one, depth is always a power of two
+ * @var bytebeam_queue_t::record_size
+ * Maximum size of a single record in bytes
+ * @var bytebeam_queue_t::slot_size
+ * Size of a single slot (header + record) in bytes
+ * @var bytebeam_queue_t::policy
+ * What a producer does when the queue is full
+ * @var bytebeam_queue_t::block_timeout_ms
+ * Maximum time a producer waits for room with the block policy
+ * @var bytebeam_queue_t::dropped
+ * Number of records rejected because the queue was full
+ * @var bytebeam_queue_t::overwritten
+ * Number of records evicted by the overwrite policy
+ * @var bytebeam_queue_t::slots
+ * Slot storage
+ */
+typedef struct bytebeam_queue {
+    atomic_size_t enqueue_pos;
+    atomic_size_t dequeue_pos;
+    size_t mask;
+    size_t record_size;
+    size_t slot_size;
+    bytebeam_queue_policy_t policy;
+    uint32_t block_timeout_ms;
+    atomic_uint dropped;
+    atomic_uint overwritten;
+    uint8_t *slots;
+} bytebeam_queue_t;
+
+/**
+ * @struct bytebeam_queue_item_t
+ * This struct refers to a record claimed by the consumer, the record stays valid until it is released
+ * @var bytebeam_queue_item_t::data
+ * Record data
+ * @var bytebeam_queue_item_t::len
+ * Record length in bytes
+ * @var bytebeam_queue_item_t::pos
+ * Queue position of the record
+ */
+typedef struct bytebeam_queue_item {
+    const char *data;
+    size_t len;
+    size_t pos;
+} bytebeam_queue_item_t;
+
+/**
+ * @brief Initialize the queue
+ *
+ * @param[in] queue               queue handle
+ * @param[in] depth               number of records, rounded up to the next power of two
+ * @param[in] record_size         maximum size of a single record in bytes
+ * @param[in] policy              what a producer does when the queue is full
+ * @param[in] block_timeout_ms    maximum time a producer waits for room with the block policy
+ *
+ * @return
+ *      BB_SUCCESS: Queue initialized successfully
+ *      BB_FAILURE: Failed to allocate the queue storage
+ *      BB_NULL_CHECK_FAILURE: If the queue is NULL
+ */
+bytebeam_err_t bytebeam_queue_init(bytebeam_queue_t *queue, size_t depth, size_t record_size, bytebeam_queue_policy_t policy, uint32_t block_timeout_ms);
+
+/**
+ * @brief Release the queue storage
+ *
+ * @note  Must not be called while producers or the consumer are still using the queue
+ *
+ * @param[in] queue               queue handle
+ *
+ * @return
+ *      void
+ */
+void bytebeam_queue_deinit(bytebeam_queue_t *queue);
+
+/**
+ * @brief Copy a record into the queue, safe to call from multiple tasks at once
+ *
+ * @param[in] queue               queue handle
+ * @param[in] data                record data
+ * @param[in] len                 record length in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Record queued
+ *      BB_FAILURE: Record is larger than the record size, the queue is full with the drop policy, the block timeout
+ *                  passed with the block policy or the consumer held the slot for too long with the overwrite policy
+ *      BB_NULL_CHECK_FAILURE: If the queue or data is NULL
+ */
+bytebeam_err_t bytebeam_queue_push(bytebeam_queue_t *queue, const char *data, size_t len);
+
+/**
+ * @brief Claim the oldest record in the queue, must be called from a single consumer task
+ *
+ * @param[in]  queue              queue handle
+ * @param[out] item               claimed record
+ *
+ * @return
+ *      true  : A record was claimed, it must be released with bytebeam_queue_pop_end
+ *      false : The queue is empty
+ */
+bool bytebeam_queue_pop_begin(bytebeam_queue_t *queue, bytebeam_queue_item_t *item);
+
+/**
+ * @brief Release a record claimed with bytebeam_queue_pop_begin so the slot can be reused
+ *
+ * @param[in] queue               queue handle
+ * @param[in] item                claimed record
+ *
+ * @return
+ *      void
+ */
+void bytebeam_queue_pop_end(bytebeam_queue_t *queue, bytebeam_queue_item_t *item);
+
+/**
+ * @brief Get the number of records currently in the queue
+ *
+ * @param[in] queue               queue handle
+ *
+ * @return
+ *      number of records in the queue
+ */
+size_t bytebeam_queue_count(bytebeam_queue_t *queue);
+
+#endif /* BYTEBEAM_QUEUE_H */
@@ -0,0 +1,135 @@
+#ifndef BYTEBEAM_RATE_H
+#define BYTEBEAM_RATE_H
+
+#include "bytebeam_client.h"
+#include "bytebeam_inflight.h"
+
+/* This enum represents what happens to a stream publish over its rate limit */
+typedef enum bytebeam_rate_policy {
+    BYTEBEAM_RATE_POLICY_DROP,          //!< Drop the publish, BB_RATE_LIMITED is returned
+    BYTEBEAM_RATE_POLICY_COALESCE,      //!< Keep the latest publish of the stream and send it once the limit allows
+    BYTEBEAM_RATE_POLICY_SPILL          //!< Write the publish to the store and forward partition, drop it if disabled
+} bytebeam_rate_policy_t;
+
+/**
+ * @struct bytebeam_rate_limit_t
+ * This struct contains a token bucket rate limit, the bucket holds burst_bytes and refills at bytes_per_sec. A
+ * publish larger than the bucket goes once the bucket is full and leaves it in debt
+ * @var bytebeam_rate_limit_t::bytes_per_sec
+ * Sustained rate, 0 for no limit
+ * @var bytebeam_rate_limit_t::burst_bytes
+ * Bucket size, 0 for one second worth of the rate
+ * @var bytebeam_rate_limit_t::policy
+ * What happens to a publish over the limit
+ */
+typedef struct bytebeam_rate_limit {
+    uint32_t bytes_per_sec;
+    uint32_t burst_bytes;
+    bytebeam_rate_policy_t policy;
+} bytebeam_rate_limit_t;
+
+/**
+ * @struct bytebeam_token_bucket_t
+ * This struct contains the state of a token bucket, in millionths of a byte so the refill needs no division
+ * @var bytebeam_token_bucket_t::rate
+ * Refill rate in bytes per second, 0 if the bucket does not limit
+ * @var bytebeam_token_bucket_t::capacity
+ * Bucket size in millionths of a byte
+ * @var bytebeam_token_bucket_t::level
+ * Tokens in the bucket in millionths of a byte, negative while in debt
+ * @var bytebeam_token_bucket_t::last_us
+ * Uptime of the last refill
+ */
+typedef struct bytebeam_token_bucket {
+    uint32_t rate;
+    int64_t capacity;
+    int64_t level;
+    long long last_us;
+} bytebeam_token_bucket_t;
+
+/**
+ * @struct bytebeam_rate_stats_t
+ * This struct contains the rate limiter counters of every stream, reported in the device shadow
+ * @var bytebeam_rate_stats_t::dropped
+ * Publishes dropped, including the coalesced ones replaced by a newer publish
+ * @var bytebeam_rate_stats_t::coalesced
+ * Publishes kept to be sent once the limit allows
+ * @var bytebeam_rate_stats_t::spilled
+ * Publishes written to the store and forward partition
+ */
+typedef struct bytebeam_rate_stats {
+    uint32_t dropped;
+    uint32_t coalesced;
+    uint32_t spilled;
+} bytebeam_rate_stats_t;
+
+/**
+ * @brief Set up a token bucket, it starts full
+ *
+ * @param[in] bucket          token bucket
+ * @param[in] limit           rate limit, a rate of 0 makes a bucket that never limits
+ *
+ * @return
+ *      void
+ */
+void bytebeam_token_bucket_init(bytebeam_token_bucket_t *bucket, const bytebeam_rate_limit_t *limit);
+
+/**
+ * @brief Set the global rate limit of the bulk lane, it defaults to the config menu values
+ *
+ * @note  Control lane publishes are never held back by the global limit, only by a limit of their own stream
+ *
+ * @param[in] limit           rate limit, a rate of 0 removes it
+ *
+ * @return
+ *      BB_SUCCESS: Limit set
+ *      BB_FAILURE: If the policy is unknown
+ *      BB_NULL_CHECK_FAILURE: If the limit is NULL
+ */
+bytebeam_err_t bytebeam_rate_set_global_limit(const bytebeam_rate_limit_t *limit);
+
+/**
+ * @brief Get the policy of the global rate limit
+ *
+ * @return
+ *      policy applied to the publishes of the streams without a limit of their own
+ */
+bytebeam_rate_policy_t bytebeam_rate_global_policy(void);
+
+/**
+ * @brief Take the tokens of a publish from its stream bucket and, for the bulk lane, the global bucket
+ *
+ * @param[in]  bucket          bucket of the stream, NULL if it has none
+ * @param[in]  priority        priority lane of the publish
+ * @param[in]  len             length of the publish in bytes
+ * @param[out] wait_ms         time until the publish would be admitted if it is not, may be NULL
+ *
+ * @return
+ *      BB_SUCCESS: Publish admitted, the tokens are taken from every bucket
+ *      BB_RATE_LIMITED: A bucket does not have the tokens, nothing is taken
+ */
+bytebeam_err_t bytebeam_rate_admit(bytebeam_token_bucket_t *bucket, bytebeam_publish_priority_t priority, size_t len, uint32_t *wait_ms);
+
+/**
+ * @brief Count a publish over its rate limit
+ *
+ * @param[in] policy          what happened to the publish
+ * @param[in] replaced        set if a coalesced publish was replaced, it counts as dropped
+ *
+ * @return
+ *      void
+ */
+void bytebeam_rate_account(bytebeam_rate_policy_t policy, bool replaced);
+
+/**
+ * @brief Get the rate limiter counters
+ *
+ * @param[out] stats          rate limiter counters
+ *
+ * @return
+ *      BB_SUCCESS: Counters read
+ *      BB_NULL_CHECK_FAILURE: If the stats is NULL
+ */
+bytebeam_err_t bytebeam_rate_get_stats(bytebeam_rate_stats_t *stats);
+
+#endif /* BYTEBEAM_RATE_H */
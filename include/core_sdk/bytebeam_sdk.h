@@ -9,6 +9,18 @@
 #include "bytebeam_client.h"
 #include "bytebeam_action.h"
 #include "bytebeam_stream.h"
+#include "bytebeam_batch.h"
+#include "bytebeam_compress.h"
+#include "bytebeam_cbor.h"
+#include "bytebeam_json.h"
+#include "bytebeam_encoder.h"
+#include "bytebeam_inflight.h"
+#include "bytebeam_flow.h"
+#include "bytebeam_filter.h"
+#include "bytebeam_aggregate.h"
+#include "bytebeam_rate.h"
+#include "bytebeam_time.h"
+#include "bytebeam_shadow.h"
 #include "bytebeam_ota.h"
 #include "bytebeam_log.h"
 
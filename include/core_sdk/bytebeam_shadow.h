@@ -0,0 +1,221 @@
+#ifndef BYTEBEAM_SHADOW_H
+#define BYTEBEAM_SHADOW_H
+
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the stream the device shadow is published to*/
+#define BYTEBEAM_SHADOW_STREAM "device_shadow"
+
+/* This enum represents the types of the registered device shadow fields */
+typedef enum {
+    BYTEBEAM_SHADOW_TYPE_INT,           //!< integer, written as a json number
+    BYTEBEAM_SHADOW_TYPE_FLOAT,         //!< floating point, written as a json number
+    BYTEBEAM_SHADOW_TYPE_STRING         //!< nul terminated string, written as a json string
+} bytebeam_shadow_type_t;
+
+/**
+ * @struct bytebeam_shadow_value_t
+ * This struct contains the value of a registered device shadow field
+ * @var bytebeam_shadow_value_t::type
+ * Type of the value, selects the member in use
+ * @var bytebeam_shadow_value_t::int_value
+ * Value of an integer field
+ * @var bytebeam_shadow_value_t::float_value
+ * Value of a floating point field
+ * @var bytebeam_shadow_value_t::string_value
+ * Value of a string field
+ */
+typedef struct {
+    bytebeam_shadow_type_t type;
+    union {
+        int64_t int_value;
+        double float_value;
+        const char *string_value;
+    };
+} bytebeam_shadow_value_t;
+
+/**
+ * @brief Callback giving the value of a registered field every time the device shadow is written
+ *
+ * @note  The callback runs in the task publishing the shadow with the registry locked, it must not set shadow fields.
+ *        A string value has to stay valid until the shadow is written, a static or field owned buffer does
+ *
+ * @param[in]  key          key of the field
+ * @param[out] value        value of the field
+ * @param[in]  user_data    user data given at registration
+ *
+ * @return
+ *      BB_SUCCESS: Value given
+ *      BB_FAILURE: No value, the field is left out of this publish
+ */
+typedef bytebeam_err_t (*bytebeam_shadow_getter_t)(const char *key, bytebeam_shadow_value_t *value, void *user_data);
+
+/**
+ * @brief Serialize the device shadow fields that do not change after boot, the reset reason and the status,
+ *        software and hardware details from the config menu. Called by bytebeam_init, every push then copies them
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ *
+ * @return
+ *      BB_SUCCESS: Static fields serialized
+ *      BB_FAILURE: If the config strings do not fit the static fields buffer
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_shadow_init(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Publish device shadow message, only the fields changed since their last acknowledged value are sent
+ *        along with the timestamp and sequence, unless a full snapshot is due
+ *
+ * @note  A full snapshot is sent every CONFIG_DEVICE_SHADOW_SNAPSHOT_INTERVAL seconds and on the first publish after a
+ *        reconnect, a field that is not acknowledged goes out again with the next publish. The message is built and
+ *        queued by the MQTT task, this call only requests it like bytebeam_shadow_request_publish
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * 
+ * @return
+ *      BB_SUCCESS: Publish requested
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ */
+bytebeam_err_t bytebeam_publish_device_shadow(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Set an integer field of the device shadow, a field is registered on its first set and published in the
+ *        same record as the built in fields. Setting the value it already has costs nothing
+ *
+ * @param[in] key       key of the field, copied
+ * @param[in] value     value of the field
+ *
+ * @return
+ *      BB_SUCCESS: Field set
+ *      BB_FAILURE: If the key is empty or reserved, or all CONFIG_DEVICE_SHADOW_MAX_FIELDS fields are in use
+ *      BB_NULL_CHECK_FAILURE: If the key is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_int(const char *key, int64_t value);
+
+/**
+ * @brief Set a floating point field of the device shadow, see bytebeam_shadow_set_int
+ *
+ * @param[in] key       key of the field, copied
+ * @param[in] value     value of the field
+ *
+ * @return
+ *      BB_SUCCESS: Field set
+ *      BB_FAILURE: If the key is empty or reserved, or all CONFIG_DEVICE_SHADOW_MAX_FIELDS fields are in use
+ *      BB_NULL_CHECK_FAILURE: If the key is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_float(const char *key, double value);
+
+/**
+ * @brief Set a string field of the device shadow, see bytebeam_shadow_set_int
+ *
+ * @param[in] key       key of the field, copied
+ * @param[in] value     value of the field, copied
+ *
+ * @return
+ *      BB_SUCCESS: Field set
+ *      BB_FAILURE: If the key is empty or reserved, all CONFIG_DEVICE_SHADOW_MAX_FIELDS fields are in use, or the
+ *                  copy could not be allocated
+ *      BB_NULL_CHECK_FAILURE: If the key or value is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_string(const char *key, const char *value);
+
+/**
+ * @brief Register a getter for a field of the device shadow, the getter is called every time the shadow is written
+ *        and the field is only published when its value changed. Replaces a value set for the same key
+ *
+ * @param[in] key           key of the field, copied
+ * @param[in] getter        callback giving the value
+ * @param[in] user_data     user data passed to the getter
+ *
+ * @return
+ *      BB_SUCCESS: Getter registered
+ *      BB_FAILURE: If the key is empty or reserved, or all CONFIG_DEVICE_SHADOW_MAX_FIELDS fields are in use
+ *      BB_NULL_CHECK_FAILURE: If the key or getter is NULL
+ */
+bytebeam_err_t bytebeam_shadow_set_getter(const char *key, bytebeam_shadow_getter_t getter, void *user_data);
+
+/**
+ * @brief Add custom device shadow message
+ *
+ * @note  The custom json is tracked as a whole, any change sends all of it again. The bytebeam_shadow_set_* fields
+ *        are tracked one by one
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] custom_json_str     custom device shaodw message
+ * 
+ * @return
+ *      BB_SUCCESS: Message added successful
+ *      BB_FAILURE: If Message size exceeded configured buffer size
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or custom_json_str is NULL
+ */
+bytebeam_err_t bytebeam_add_custom_device_shadow(bytebeam_client_t *bytebeam_client, char *custom_json_str);
+
+/**
+ * @brief Register device shadow update handler
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] func_ptr            device shadow update handler
+ * 
+ * @return
+ *      BB_SUCCESS: Handler registered successful
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or func_ptr is NULL
+ */
+bytebeam_err_t bytebeam_register_device_shadow_updater(bytebeam_client_t *bytebeam_client, int (*func_ptr)(bytebeam_client_t *));
+
+/**
+ * @brief Send a full snapshot with the next device shadow publish, called once the client is connected again
+ *
+ * @return
+ *      void
+ */
+void bytebeam_shadow_request_snapshot(void);
+
+/**
+ * @brief Publish the device shadow as soon as possible instead of waiting for the push interval, for a state change the
+ *        platform should see right away. Requests made while disconnected are served once the client is connected
+ *
+ * @return
+ *      void
+ */
+void bytebeam_shadow_request_publish(void);
+
+/**
+ * @brief Change the device shadow push interval, CONFIG_DEVICE_SHADOW_PUSH_INTERVAL until called
+ *
+ * @param[in] interval_sec      seconds between two pushes, 0 to only push on connect and on request
+ *
+ * @return
+ *      BB_SUCCESS: Interval changed, the next push is due an interval after the last one
+ *      BB_FAILURE: If the interval does not fit in milliseconds
+ */
+bytebeam_err_t bytebeam_shadow_set_interval(uint32_t interval_sec);
+
+/**
+ * @brief Publish the device shadow if a push is due, run by the MQTT task in place of a dedicated shadow task
+ *
+ * @note  The device shadow updater is called from here, on the MQTT task. The message is queued to the outbox
+ *        without waiting on the network. Nothing is published while disconnected and a failed publish is retried
+ *        after 1 second, doubled with every failure up to the push interval
+ *
+ * @param[out] next_ms      time until the next call is due, UINT32_MAX if nothing is due until a request
+ *
+ * @return
+ *      BB_SUCCESS: Nothing was due or the device shadow was published
+ *      BB_NULL_CHECK_FAILURE: If the next_ms is NULL
+ *      BB_FAILURE: If the device shadow is not initialized
+ *      BB_WOULD_BLOCK: The outbox is full or the shadow is over its rate limit, the publish is retried
+ *      Other: The error of the failed publish
+ */
+bytebeam_err_t bytebeam_shadow_poll(uint32_t *next_ms);
+
+/**
+ * @brief Stop publishing the device shadow for the client given to bytebeam_shadow_init, called by bytebeam_destroy
+ *        and when bytebeam_init fails
+ *
+ * @return
+ *      void
+ */
+void bytebeam_shadow_deinit(void);
+
+#endif /* BYTEBEAM_SHADOW_H */
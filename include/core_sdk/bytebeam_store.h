@@ -0,0 +1,64 @@
+#ifndef BYTEBEAM_STORE_H
+#define BYTEBEAM_STORE_H
+
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the mount point of the store and forward partition*/
+#define BYTEBEAM_STORE_BASE_PATH "/bb_store"
+
+/*This macro is used to specify the maximum length of a stored stream name*/
+#define BYTEBEAM_STORE_STREAM_STR_LEN 255
+
+/**
+ * @brief Mount the store and forward partition and recover the segments left by the previous boot
+ *
+ * @note  Stored publishes are delivered at least once, a publish may be sent again if the device resets
+ *        before the segment holding it is fully drained
+ *
+ * @param[in] bytebeam_client    bytebeam client handle
+ *
+ * @return
+ *      BB_SUCCESS: Store initialized successfully
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client is NULL
+ *      BB_FAILURE: On failure
+ */
+bytebeam_err_t bytebeam_store_init(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Close the open segments and unmount the store and forward partition, stored publishes are kept
+ *
+ * @return
+ *      void
+ */
+void bytebeam_store_deinit(void);
+
+/**
+ * @brief Append a publish to the store, safe to call from multiple tasks at once
+ *
+ * @param[in] stream_name    stream name
+ * @param[in] encoding       encoding of the payload
+ * @param[in] payload        payload to store
+ * @param[in] payload_len    length of the payload in bytes
+ *
+ * @return
+ *      BB_SUCCESS: Publish stored and synced to flash
+ *      BB_NULL_CHECK_FAILURE: If the stream_name or payload is NULL
+ *      BB_FAILURE: If the store is not initialized, the publish is larger than a segment or the write failed
+ */
+bytebeam_err_t bytebeam_store_write(const char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len);
+
+/**
+ * @brief Publish the next stored record if the drain rate allows it, must be called from a single task
+ *
+ * @note  Nothing is drained while the client is disconnected
+ *
+ * @param[out] next_drain_ms    time until the next call is due, UINT32_MAX if there is nothing to drain
+ *
+ * @return
+ *      BB_SUCCESS: Nothing was due or a stored record was published
+ *      BB_NULL_CHECK_FAILURE: If the next_drain_ms is NULL
+ *      BB_FAILURE: If the store is not initialized or the publish failed
+ */
+bytebeam_err_t bytebeam_store_drain(uint32_t *next_drain_ms);
+
+#endif /* BYTEBEAM_STORE_H */
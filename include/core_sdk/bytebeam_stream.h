@@ -2,100 +2,270 @@
 #define BYTEBEAM_STREAM_H
 
 #include "bytebeam_client.h"
+#include "bytebeam_batch.h"
+#include "bytebeam_inflight.h"
+#include "bytebeam_rate.h"
+#include "bytebeam_shadow.h"
+
+/* Handle of an open stream returned by bytebeam_stream_open */
+typedef struct bytebeam_stream *bytebeam_stream_handle_t;
 
 /**
- * @brief Publish message to particualar stream
+ * @struct bytebeam_stream_attr_t
+ * This struct contains the delivery attributes of an open stream, a stream opens with QoS 1 and blocking publishes
+ * in the bulk lane, except the device shadow stream which opens with non blocking publishes in the control lane
+ * @var bytebeam_stream_attr_t::qos
+ * MQTT QoS of the publishes, 0 or 1
+ * @var bytebeam_stream_attr_t::blocking
+ * If set the publish is written to the connection by the calling task, otherwise it is copied to the outbox and
+ * sent by the MQTT task so the call does not wait on the network
+ * @var bytebeam_stream_attr_t::priority
+ * Priority lane of the publishes
+ */
+typedef struct bytebeam_stream_attr {
+    int qos;
+    bool blocking;
+    bytebeam_publish_priority_t priority;
+} bytebeam_stream_attr_t;
+
+/**
+ * @brief Open a stream, its topics are built once and kept in the open streams table. Opening a stream that is
+ *        already open returns the same handle, safe to call from multiple tasks at once
+ *
+ * @note  The publish by name functions open the stream on first use, so a handle only saves the name lookup
+ *
+ * @param[in]  bytebeam_client     bytebeam client handle
+ * @param[in]  stream_name         name of the stream, it is copied
+ * @param[out] handle              stream handle, valid until the client is destroyed
+ *
+ * @return
+ *      BB_SUCCESS: Stream opened
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name or handle is NULL
+ *      BB_FAILURE: If the open streams table is full or the allocation failed
+ */
+bytebeam_err_t bytebeam_stream_open(bytebeam_client_t *bytebeam_client, const char *stream_name, bytebeam_stream_handle_t *handle);
+
+/**
+ * @brief Close every stream opened for the client, called when the client is destroyed
  *
  * @param[in] bytebeam_client     bytebeam client handle
- * @param[in] stream_name         name of the target stream
+ *
+ * @return
+ *      void
+ */
+void bytebeam_stream_close_all(bytebeam_client_t *bytebeam_client);
+
+/**
+ * @brief Set the delivery attributes of an open stream, they apply to the publishes made after the call
+ *
+ * @note  QoS 0 without blocking is the cheapest path for high rate telemetry that can tolerate loss, the device
+ *        shadow stream keeps QoS 1 unless changed and the action status is always published with QoS 1
+ *
+ * @param[in] handle              stream handle
+ * @param[in] attr                delivery attributes
+ *
+ * @return
+ *      BB_SUCCESS: Attributes set
+ *      BB_FAILURE: If the QoS is not 0 or 1 or the priority is unknown
+ *      BB_NULL_CHECK_FAILURE: If the handle or attr is NULL
+ */
+bytebeam_err_t bytebeam_stream_set_attr(bytebeam_stream_handle_t handle, const bytebeam_stream_attr_t *attr);
+
+/**
+ * @brief Get the delivery attributes of an open stream
+ *
+ * @param[in]  handle             stream handle
+ * @param[out] attr               delivery attributes
+ *
+ * @return
+ *      BB_SUCCESS: Attributes read
+ *      BB_NULL_CHECK_FAILURE: If the handle or attr is NULL
+ */
+bytebeam_err_t bytebeam_stream_get_attr(bytebeam_stream_handle_t handle, bytebeam_stream_attr_t *attr);
+
+/**
+ * @brief Get the name of an open stream
+ *
+ * @param[in] handle              stream handle
+ *
+ * @return
+ *      NULL terminated stream name
+ */
+const char* bytebeam_stream_name(bytebeam_stream_handle_t handle);
+
+/**
+ * @brief Set the rate limit of an open stream, its publishes are held to it on top of the global limit
+ *
+ * @note  The limit counts the payload bytes before compression. Over the limit the publish is dropped, coalesced
+ *        with the next ones so only the latest is sent once the limit allows, or spilled to the store and forward
+ *        partition, following the policy. A publish with a completion callback is refused with BB_WOULD_BLOCK instead
+ *
+ * @param[in] handle              stream handle
+ * @param[in] limit               rate limit, NULL to remove it
+ *
+ * @return
+ *      BB_SUCCESS: Limit set
+ *      BB_FAILURE: If the policy is unknown
+ *      BB_NULL_CHECK_FAILURE: If the handle is NULL
+ */
+bytebeam_err_t bytebeam_stream_set_rate_limit(bytebeam_stream_handle_t handle, const bytebeam_rate_limit_t *limit);
+
+/**
+ * @brief Publish an encoded buffer to an open stream, the topic variant follows the encoding
+ *
+ * @param[in] handle              stream handle
+ * @param[in] encoding            encoding of the message, the message must be an array of records
  * @param[in] payload             message to publish
- * 
+ * @param[in] payload_len         length of the message in bytes
+ *
  * @return
  *      BB_SUCCESS: Message publish successful
  *      BB_FAILURE: Message publish failed
- *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name, or payload is NULL
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks, the message was not published
+ *      BB_RATE_LIMITED: The message is over its rate limit and was dropped
+ *      BB_NULL_CHECK_FAILURE: If the handle or payload is NULL
  */
-bytebeam_err_t bytebeam_publish_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload);
+bytebeam_err_t bytebeam_stream_publish(bytebeam_stream_handle_t handle, bytebeam_encoding_t encoding, const void *payload, size_t payload_len);
 
 /**
- * @brief Publish device shadow message
+ * @brief Publish an encoded buffer to an open stream and get called back once the publish completes
+ *
+ * @note  A QoS 1 publish completes when the broker acknowledges it or after CONFIG_BYTEBEAM_PUBLISH_ACK_TIMEOUT_MS,
+ *        a QoS 0 publish once it is handed to the MQTT client and a publish made while offline once it is stored.
+ *        The callback is not called if the publish fails.
+ *
+ * @param[in] handle              stream handle
+ * @param[in] encoding            encoding of the message, the message must be an array of records
+ * @param[in] payload             message to publish
+ * @param[in] payload_len         length of the message in bytes
+ * @param[in] callback            completion callback, may be NULL
+ * @param[in] user_data           user data passed to the callback
+ *
+ * @return
+ *      BB_SUCCESS: Message publish successful
+ *      BB_FAILURE: Message publish failed
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks or the message is over its rate limit, the message was not
+ *                      published and no rate limit policy applies to it
+ *      BB_NULL_CHECK_FAILURE: If the handle or payload is NULL
+ */
+bytebeam_err_t bytebeam_stream_publish_with_callback(bytebeam_stream_handle_t handle, bytebeam_encoding_t encoding, const void *payload, size_t payload_len,
+                                                     bytebeam_publish_cb_t callback, void *user_data);
+
+/**
+ * @brief Publish message to particualar stream
  *
  * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] stream_name         name of the target stream
+ * @param[in] payload             message to publish
  * 
  * @return
  *      BB_SUCCESS: Message publish successful
  *      BB_FAILURE: Message publish failed
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks, the message was not published
+ *      BB_RATE_LIMITED: The message is over its rate limit and was dropped
  *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name, or payload is NULL
  */
-bytebeam_err_t bytebeam_publish_device_shadow(bytebeam_client_t *bytebeam_client);
+bytebeam_err_t bytebeam_publish_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload);
 
 /**
- * @brief Add custom device shadow message
+ * @brief Publish a buffer that is not NULL terminated to particualar stream
  *
  * @param[in] bytebeam_client     bytebeam client handle
- * @param[in] custom_json_str     custom device shaodw message
+ * @param[in] stream_name         name of the target stream
+ * @param[in] payload             message to publish
+ * @param[in] payload_len         length of the message in bytes
  * 
  * @return
- *      BB_SUCCESS: Message added successful
- *      BB_FAILURE: If Message size exceeded configured buffer size
- *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or custom_json_str is NULL
+ *      BB_SUCCESS: Message publish successful
+ *      BB_FAILURE: Message publish failed
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks, the message was not published
+ *      BB_RATE_LIMITED: The message is over its rate limit and was dropped
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name, or payload is NULL
  */
-bytebeam_err_t bytebeam_add_custom_device_shadow(bytebeam_client_t *bytebeam_client, char *custom_json_str);
+bytebeam_err_t bytebeam_publish_buffer_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, const char *payload, size_t payload_len);
 
 /**
- * @brief Register device shadow update handler
+ * @brief Publish an encoded buffer to particualar stream, the topic variant follows the encoding
  *
  * @param[in] bytebeam_client     bytebeam client handle
- * @param[in] func_ptr            device shadow update handler
+ * @param[in] stream_name         name of the target stream
+ * @param[in] encoding            encoding of the message, the message must be an array of records
+ * @param[in] payload             message to publish
+ * @param[in] payload_len         length of the message in bytes
  * 
  * @return
- *      BB_SUCCESS: Handler registered successful
- *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or func_ptr is NULL
+ *      BB_SUCCESS: Message publish successful
+ *      BB_FAILURE: Message publish failed
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks, the message was not published
+ *      BB_RATE_LIMITED: The message is over its rate limit and was dropped
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name, or payload is NULL
  */
-bytebeam_err_t bytebeam_register_device_shadow_updater(bytebeam_client_t *bytebeam_client, int (*func_ptr)(bytebeam_client_t *));
+bytebeam_err_t bytebeam_publish_encoded_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len);
 
 /**
- * @brief Initialize batch mqtt client
+ * @brief Publish a buffer drained from the store and forward partition, a rate limit or a recent control publish
+ *        refuses it with BB_WOULD_BLOCK so it stays stored instead of being dropped or spilled again
  *
  * @param[in] bytebeam_client     bytebeam client handle
- * @param[in] stream_name         stream name
- * 
+ * @param[in] stream_name         name of the target stream
+ * @param[in] encoding            encoding of the message
+ * @param[in] payload             message to publish
+ * @param[in] payload_len         length of the message in bytes
+ *
  * @return
- *      BB_SUCCESS: MQTT Batch Initialized Successfully
- *      BB_NULL_CHECK_FAILURE: If the bytebeam_client or stream_name is NULL
- *      BB_FAILURE: On failure
+ *      BB_SUCCESS: Message publish successful
+ *      BB_FAILURE: Message publish failed
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks or the message is over its rate limit
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name, or payload is NULL
  */
-bytebeam_err_t bytebeam_batch_init(bytebeam_client_t *bytebeam_client, char* stream_name);
+bytebeam_err_t bytebeam_publish_stored_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len);
 
 /**
- * @brief MQTT Batch Publish
+ * @brief Publish a sealed batch to an open stream, called from the MQTT task. A rate limit or a recent control
+ *        publish refuses it with BB_WOULD_BLOCK so the batch is retried instead of being dropped
+ *
+ * @param[in] handle              stream handle
+ * @param[in] encoding            encoding of the batch
+ * @param[in] payload             batch to publish
+ * @param[in] payload_len         length of the batch in bytes
+ * @param[in] callback            completion callback, may be NULL
+ * @param[in] user_data           user data passed to the callback
  *
- * @param[in] payload        payload to batch publish
- * 
  * @return
- *      BB_SUCCESS: MQTT Batch Added Successfully
- *      BB_FAILURE: On failure
+ *      BB_SUCCESS: Batch publish successful
+ *      BB_FAILURE: Batch publish failed
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks, the bulk lane yields or the batch is over its rate limit
+ *      BB_NULL_CHECK_FAILURE: If the handle or payload is NULL
  */
-bytebeam_err_t bytebeam_batch_publish_to_stream(char* payload);
+bytebeam_err_t bytebeam_stream_publish_batch(bytebeam_stream_handle_t handle, bytebeam_encoding_t encoding, const void *payload, size_t payload_len,
+                                             bytebeam_publish_cb_t callback, void *user_data);
 
 /**
- * @brief User Data Thread Entry
+ * @brief Publish a sealed batch to particualar stream that is not in the open streams table, refused like
+ *        bytebeam_stream_publish_batch
+ *
+ * @param[in] bytebeam_client     bytebeam client handle
+ * @param[in] stream_name         name of the target stream
+ * @param[in] encoding            encoding of the batch
+ * @param[in] payload             batch to publish
+ * @param[in] payload_len         length of the batch in bytes
  *
- * @param[in] pv        task argument
- * 
  * @return
- *      
+ *      BB_SUCCESS: Batch publish successful
+ *      BB_FAILURE: Batch publish failed
+ *      BB_WOULD_BLOCK: The outbox is above its watermarks, the bulk lane yields or the batch is over its rate limit
+ *      BB_NULL_CHECK_FAILURE: If the bytebeam_client, stream_name, or payload is NULL
  */
-void bytebeam_user_thread_entry(void *pv);
+bytebeam_err_t bytebeam_publish_batch_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len);
 
 /**
- * @brief MQTT Data Publish Thread
+ * @brief Send the coalesced publishes whose rate limit allows it, called from the MQTT task
  *
- * @param[in] pv        task argument
- * 
- * @return
+ * @param[in,out] next_ms         lowered to the time until a held publish is due, left as is if none is held
  *
+ * @return
+ *      void
  */
-void bytebeam_mqtt_thread_entry(void *pv);
+void bytebeam_stream_rate_poll(uint32_t *next_ms);
 
 #endif /* BYTEBEAM_STREAM_H */
\ No newline at end of file
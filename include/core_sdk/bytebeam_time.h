@@ -0,0 +1,42 @@
+#ifndef BYTEBEAM_TIME_H
+#define BYTEBEAM_TIME_H
+
+#include "bytebeam_client.h"
+
+/*This macro is used to specify the epoch milliseconds below which the wall clock is treated as not set (2020-01-01)*/
+#define BYTEBEAM_TIME_VALID_EPOCH_MS 1577836800000LL
+
+/*This macro is used to specify how often the wall clock is checked again while it is not set*/
+#define BYTEBEAM_TIME_RECHECK_MS 1000
+
+/**
+ * @brief Take the offset between the uptime and the wall clock, the records are stamped with the uptime and
+ *        turned into epoch milliseconds with this offset once they are encoded
+ *
+ * @note  The SDK checks the wall clock by itself before encoding, calling this from the SNTP sync notification only
+ *        gets the records held back for the first sync sent without waiting for the next check
+ *
+ * @return
+ *      true if the wall clock is set, false otherwise
+ */
+bool bytebeam_time_sync(void);
+
+/**
+ * @brief Check whether the wall clock was set at the last sync
+ *
+ * @return
+ *      true if the offset is known, false otherwise
+ */
+bool bytebeam_time_is_synced(void);
+
+/**
+ * @brief Turn an uptime into epoch milliseconds with the offset of the last sync
+ *
+ * @param[in] uptime_us        uptime in microseconds, as read by bytebeam_hal_get_uptime_us
+ *
+ * @return
+ *      epoch milliseconds, 0 if the wall clock was never set
+ */
+unsigned long long bytebeam_time_to_epoch_millis(long long uptime_us);
+
+#endif /* BYTEBEAM_TIME_H */
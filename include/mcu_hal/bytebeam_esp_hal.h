@@ -27,6 +27,8 @@ typedef enum bytebeam_reset_reason {
 int bytebeam_hal_mqtt_subscribe(bytebeam_client_handle_t client, char *topic, int qos);
 int bytebeam_hal_mqtt_unsubscribe(bytebeam_client_handle_t client, char *topic);
 int bytebeam_hal_mqtt_publish(bytebeam_client_handle_t client, char *topic, char *message, int length, int qos);
+int bytebeam_hal_mqtt_enqueue(bytebeam_client_handle_t client, char *topic, char *message, int length, int qos);
+int bytebeam_hal_mqtt_get_outbox_size(bytebeam_client_handle_t client);
 int bytebeam_hal_restart(void);
 int bytebeam_hal_ota(bytebeam_client_t *bytebeam_client, char *ota_url);
 int bytebeam_hal_init(bytebeam_client_t *bytebeam_client);
@@ -36,14 +38,21 @@ int bytebeam_hal_stop_mqtt(bytebeam_client_t *bytebeam_client);
 
 int bytebeam_hal_spiffs_mount();
 int bytebeam_hal_spiffs_unmount();
+int bytebeam_hal_spiffs_mount_partition(const char *base_path, const char *partition_label, int max_files);
+int bytebeam_hal_spiffs_unmount_partition(const char *partition_label);
 int bytebeam_hal_fatfs_mount();
 int bytebeam_hal_fatfs_unmount();
+int bytebeam_hal_fatfs_mount_partition(const char *base_path, const char *partition_label, bool read_only);
+int bytebeam_hal_fatfs_unmount_partition(const char *base_path, const char *partition_label, bool read_only);
+uint32_t bytebeam_hal_crc32(uint32_t crc, const void *buf, size_t len);
+uint32_t bytebeam_hal_random(void);
 unsigned long long bytebeam_hal_get_epoch_millis();
 bytebeam_reset_reason_t bytebeam_hal_get_reset_reason();
 long long bytebeam_hal_get_uptime_ms();
+long long bytebeam_hal_get_uptime_us();
 
-int bytebeam_subscribe_to_actions(bytebeam_device_config_t device_cfg, bytebeam_client_handle_t client);
-int bytebeam_unsubscribe_to_actions(bytebeam_device_config_t device_cfg, bytebeam_client_handle_t client);
+int bytebeam_subscribe_to_actions(bytebeam_client_t *bytebeam_client);
+int bytebeam_unsubscribe_to_actions(bytebeam_client_t *bytebeam_client);
 int bytebeam_handle_actions(char *action_received, bytebeam_client_handle_t client, bytebeam_client_t *bytebeam_client);
 
 extern char *ota_action_id;
@@ -1,49 +1,216 @@
 #include "cJSON.h"
 #include "sys/time.h"
+#include "freertos/FreeRTOS.h"
 #include "bytebeam_hal.h"
 #include "bytebeam_action.h"
+#include "bytebeam_encoder.h"
+#include "bytebeam_inflight.h"
+#include "bytebeam_flow.h"
 
-static int function_handler_index = 0;
 static char bytebeam_last_known_action_id[BYTEBEAM_ACTION_ID_STR_LEN] = { 0 };
 
+// guards the action tables, the handlers are looked up from the MQTT event task while the application changes them
+static portMUX_TYPE action_lock = portMUX_INITIALIZER_UNLOCKED;
+
 static const char *TAG = "BYTEBEAM_ACTION";
 
-int bytebeam_subscribe_to_actions(bytebeam_device_config_t device_cfg, bytebeam_client_handle_t client)
+static uint32_t action_hash(const char *name)
 {
-    int msg_id;
-    int qos = 1;
-    char topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = { 0 };
+    // FNV-1a, cheap and spreads the short action names well
+    uint32_t hash = 2166136261u;
 
-    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
-    int temp_var = snprintf(topic, max_len, "/tenants/%s/devices/%s/actions", device_cfg.project_id, device_cfg.device_id);
+    while (*name) {
+        hash = (hash ^ (uint8_t)*name++) * 16777619u;
+    }
 
-    if(temp_var >= max_len)
-    {
-        BB_LOGE(TAG, "subscribe topic size exceeded buffer size");
+    return hash;
+}
+
+static uint32_t action_table_capacity(uint32_t count)
+{
+    // the table is kept at most three quarters full so the probes stay short
+    uint32_t capacity = 8;
+
+    while (capacity - capacity / 4 < count) {
+        capacity *= 2;
+    }
+
+    return capacity;
+}
+
+static int action_table_find(bytebeam_action_table_t *table, const char *name, uint32_t hash)
+{
+    // called with the lock held, the slot of the action or -1
+    if (table->capacity == 0) {
         return -1;
     }
 
-    msg_id = bytebeam_hal_mqtt_subscribe(client, topic, qos);
+    uint32_t mask = table->capacity - 1;
 
-    return msg_id;
+    for (uint32_t slot = hash & mask; table->slots[slot].name != NULL; slot = (slot + 1) & mask) {
+        if (table->slots[slot].hash == hash && !strcmp(table->slots[slot].name, name)) {
+            return (int)slot;
+        }
+    }
+
+    return -1;
 }
 
-int bytebeam_unsubscribe_to_actions(bytebeam_device_config_t device_cfg, bytebeam_client_handle_t client)
+static void action_table_insert(bytebeam_action_functions_map_t *slots, uint32_t capacity, const bytebeam_action_functions_map_t *action)
 {
-    int msg_id = 0;
-    char topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = { 0 };
+    // called with the lock held, the table has a free slot and does not hold the action
+    uint32_t mask = capacity - 1;
+    uint32_t slot = action->hash & mask;
 
-    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
-    int temp_var = snprintf(topic, max_len, "/tenants/%s/devices/%s/actions", device_cfg.project_id, device_cfg.device_id);
+    while (slots[slot].name != NULL) {
+        slot = (slot + 1) & mask;
+    }
 
-    if(temp_var >= max_len)
+    slots[slot] = *action;
+}
+
+static void action_table_delete(bytebeam_action_table_t *table, uint32_t slot)
+{
+    // called with the lock held, the actions probed past the slot move back so no tombstone is left behind
+    uint32_t mask = table->capacity - 1;
+    uint32_t next = (slot + 1) & mask;
+
+    while (table->slots[next].name != NULL) {
+        uint32_t home = table->slots[next].hash & mask;
+
+        // an action moves into the hole unless its home lies cyclically between the hole and where it sits
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            table->slots[slot] = table->slots[next];
+            slot = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+
+    table->slots[slot].name = NULL;
+    table->slots[slot].func = NULL;
+    table->count--;
+}
+
+static bytebeam_err_t action_table_reserve(bytebeam_action_table_t *table, uint32_t count)
+{
+    bytebeam_action_functions_map_t *retired = NULL;
+    bytebeam_action_functions_map_t *slots = NULL;
+    uint32_t capacity = 0;
+
+    while (1) {
+        taskENTER_CRITICAL(&action_lock);
+
+        uint32_t needed = action_table_capacity(table->count > count ? table->count : count);
+
+        if (table->capacity >= needed) {
+            taskEXIT_CRITICAL(&action_lock);
+            break;
+        }
+
+        // the handlers are moved over in one go once the larger table is allocated
+        if (slots != NULL && capacity >= needed) {
+            for (uint32_t slot = 0; slot < table->capacity; slot++) {
+                if (table->slots[slot].name != NULL) {
+                    action_table_insert(slots, capacity, &table->slots[slot]);
+                }
+            }
+
+            retired = table->slots;
+            table->slots = slots;
+            table->capacity = capacity;
+            slots = NULL;
+
+            taskEXIT_CRITICAL(&action_lock);
+            break;
+        }
+
+        taskEXIT_CRITICAL(&action_lock);
+
+        // never allocate with the lock held, the table is checked again afterwards
+        free(slots);
+
+        capacity = needed;
+        slots = calloc(capacity, sizeof(bytebeam_action_functions_map_t));
+
+        if (slots == NULL) {
+            BB_LOGE(TAG, "Failed to allocate the action table for %u actions", (unsigned)count);
+            return BB_FAILURE;
+        }
+    }
+
+    free(slots);
+    free(retired);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_action_topics_init(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    const char *project_id = bytebeam_client->device_cfg.project_id;
+    const char *device_id = bytebeam_client->device_cfg.device_id;
+    const char *status_suffix = (BYTEBEAM_MESSAGE_ENCODING == BYTEBEAM_ENCODING_CBOR) ? "/cbor" : "";
+
+    // both topics go in one allocation, sized exactly
+    int actions_len = snprintf(NULL, 0, "/tenants/%s/devices/%s/actions", project_id, device_id) + 1;
+    int status_len = snprintf(NULL, 0, "/tenants/%s/devices/%s/action/status%s", project_id, device_id, status_suffix) + 1;
+
+    char *topics = malloc(actions_len + status_len);
+
+    if (topics == NULL)
     {
-        BB_LOGE(TAG, "unsubscribe topic size exceeded buffer size");
+        BB_LOGE(TAG, "Failed to allocate the memory for action topics");
+        return BB_FAILURE;
+    }
+
+    snprintf(topics, actions_len, "/tenants/%s/devices/%s/actions", project_id, device_id);
+    snprintf(topics + actions_len, status_len, "/tenants/%s/devices/%s/action/status%s", project_id, device_id, status_suffix);
+
+    bytebeam_client->topics.actions = topics;
+    bytebeam_client->topics.action_status = topics + actions_len;
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_action_topics_deinit(bytebeam_client_t *bytebeam_client)
+{
+    // the status topic lives in the same allocation
+    free(bytebeam_client->topics.actions);
+
+    bytebeam_client->topics.actions = NULL;
+    bytebeam_client->topics.action_status = NULL;
+}
+
+int bytebeam_subscribe_to_actions(bytebeam_client_t *bytebeam_client)
+{
+    int qos = 1;
+
+    if (bytebeam_client->topics.actions == NULL)
+    {
+        BB_LOGE(TAG, "action topics are not initialized");
+        return -1;
+    }
+
+    return bytebeam_hal_mqtt_subscribe(bytebeam_client->client, bytebeam_client->topics.actions, qos);
+}
+
+int bytebeam_unsubscribe_to_actions(bytebeam_client_t *bytebeam_client)
+{
+    int msg_id = 0;
+
+    if (bytebeam_client->topics.actions == NULL)
+    {
+        BB_LOGE(TAG, "action topics are not initialized");
         return -1;
     }
 
     // not yet supported by bytebeam
-    // msg_id = bytebeam_hal_mqtt_unsubscribe(client, topic);
+    // msg_id = bytebeam_hal_mqtt_unsubscribe(bytebeam_client->client, bytebeam_client->topics.actions);
 
     return msg_id;
 }
@@ -55,7 +222,6 @@ int bytebeam_handle_actions(char *action_received, bytebeam_client_handle_t clie
     cJSON *payload = NULL;
     cJSON *action_id_obj = NULL;
 
-    int action_iterator = 0;
     char action_id[BYTEBEAM_ACTION_ID_STR_LEN] = { 0 };
 
     root = cJSON_Parse(action_received);
@@ -113,16 +279,22 @@ int bytebeam_handle_actions(char *action_received, bytebeam_client_handle_t clie
     if (cJSON_IsString(payload) && (payload->valuestring != NULL)) {
         BB_LOGI(TAG, "Checking payload \"%s\"\n", payload->valuestring);
 
-        while (bytebeam_client->action_funcs[action_iterator].name) {
-            if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, name->valuestring)) {
-                bytebeam_client->action_funcs[action_iterator].func(bytebeam_client, payload->valuestring, action_id);
-                break;
-            }
+        int (*func)(bytebeam_client_t *, char *, char *) = NULL;
+
+        // only the handler is taken under the lock, it runs without it
+        taskENTER_CRITICAL(&action_lock);
+
+        int slot = action_table_find(&bytebeam_client->action_funcs, name->valuestring, action_hash(name->valuestring));
 
-            action_iterator++;
+        if (slot != -1) {
+            func = bytebeam_client->action_funcs.slots[slot].func;
         }
 
-        if (bytebeam_client->action_funcs[action_iterator].name == NULL) {
+        taskEXIT_CRITICAL(&action_lock);
+
+        if (func != NULL) {
+            func(bytebeam_client, payload->valuestring, action_id);
+        } else {
             BB_LOGI(TAG, "Invalid action:%s\n", name->valuestring);
 
             // publish action failed response indicating unregistered action
@@ -153,27 +325,55 @@ bytebeam_err_t bytebeam_add_action_handler(bytebeam_client_t *bytebeam_client, i
         return BB_NULL_CHECK_FAILURE;
     }
 
-    if (function_handler_index >= BYTEBEAM_NUMBER_OF_ACTIONS) {
+    bytebeam_action_table_t *table = &bytebeam_client->action_funcs;
+    bytebeam_action_functions_map_t action = { .name = strdup(func_name), .hash = action_hash(func_name), .func = func_ptr };
+
+    if (action.name == NULL) {
         BB_LOGE(TAG, "Creation of new action handler failed");
         return BB_FAILURE;
     }
 
-    int action_iterator = 0;
+    while (1) {
+        taskENTER_CRITICAL(&action_lock);
+
+        // checking for duplicates in the table, if there log the info about it and return
+        if (action_table_find(table, func_name, action.hash) != -1) {
+            taskEXIT_CRITICAL(&action_lock);
 
-    // checking for duplicates in the array, if there log the info about it and return 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
             BB_LOGE(TAG, "action : %s is already there, update the action instead\n", func_name);
+            free(action.name);
             return BB_FAILURE;
         }
-    }
 
-    bytebeam_client->action_funcs[function_handler_index].func = func_ptr;
-    bytebeam_client->action_funcs[function_handler_index].name = func_name;
+        if (table->count < table->capacity - table->capacity / 4) {
+            action_table_insert(table->slots, table->capacity, &action);
+            table->count++;
 
-    function_handler_index = function_handler_index + 1;
+            taskEXIT_CRITICAL(&action_lock);
+            return BB_SUCCESS;
+        }
 
-    return BB_SUCCESS;
+        uint32_t count = table->count + 1;
+
+        taskEXIT_CRITICAL(&action_lock);
+
+        // a full table grows to twice its size, the first handler sizes it for BYTEBEAM_NUMBER_OF_ACTIONS
+        if (action_table_reserve(table, (count > BYTEBEAM_NUMBER_OF_ACTIONS) ? count : BYTEBEAM_NUMBER_OF_ACTIONS) != BB_SUCCESS) {
+            BB_LOGE(TAG, "Creation of new action handler failed");
+            free(action.name);
+            return BB_FAILURE;
+        }
+    }
+}
+
+bytebeam_err_t bytebeam_reserve_action_handlers(bytebeam_client_t *bytebeam_client, uint32_t count)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    return action_table_reserve(&bytebeam_client->action_funcs, count);
 }
 
 bytebeam_err_t bytebeam_remove_action_handler(bytebeam_client_t *bytebeam_client, char *func_name)
@@ -183,29 +383,28 @@ bytebeam_err_t bytebeam_remove_action_handler(bytebeam_client_t *bytebeam_client
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
-    int target_action_index = -1;
+    bytebeam_action_table_t *table = &bytebeam_client->action_funcs;
+    char *removed_name = NULL;
 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
-            target_action_index = action_iterator;
-        }
+    taskENTER_CRITICAL(&action_lock);
+
+    int target_slot = action_table_find(table, func_name, action_hash(func_name));
+
+    if (target_slot != -1) {
+        removed_name = table->slots[target_slot].name;
+        action_table_delete(table, (uint32_t)target_slot);
     }
 
-    if (target_action_index == -1) {
+    taskEXIT_CRITICAL(&action_lock);
+
+    if (target_slot == -1) {
         BB_LOGE(TAG, "action : %s not found \n", func_name);
         return BB_FAILURE;
-    } else {
-        for(action_iterator = target_action_index; action_iterator < function_handler_index - 1; action_iterator++) {
-            bytebeam_client->action_funcs[action_iterator].func = bytebeam_client->action_funcs[action_iterator+1].func;
-            bytebeam_client->action_funcs[action_iterator].name = bytebeam_client->action_funcs[action_iterator+1].name;
-        }
-
-        function_handler_index = function_handler_index - 1;
-        bytebeam_client->action_funcs[function_handler_index].func = NULL;
-        bytebeam_client->action_funcs[function_handler_index].name = NULL;
-        return BB_SUCCESS;
     }
+
+    free(removed_name);
+
+    return BB_SUCCESS;
 }
 
 bytebeam_err_t bytebeam_update_action_handler(bytebeam_client_t *bytebeam_client, int (*new_func_ptr)(bytebeam_client_t *, char *, char *), char *func_name)
@@ -216,22 +415,22 @@ bytebeam_err_t bytebeam_update_action_handler(bytebeam_client_t *bytebeam_client
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
-    int target_action_index = -1;
+    taskENTER_CRITICAL(&action_lock);
 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
-            target_action_index = action_iterator;
-        }
+    int target_slot = action_table_find(&bytebeam_client->action_funcs, func_name, action_hash(func_name));
+
+    if (target_slot != -1) {
+        bytebeam_client->action_funcs.slots[target_slot].func = new_func_ptr;
     }
 
-    if (target_action_index == -1) {
+    taskEXIT_CRITICAL(&action_lock);
+
+    if (target_slot == -1) {
         BB_LOGE(TAG, "action : %s not found \n", func_name);
         return BB_FAILURE;
-    } else {
-        bytebeam_client->action_funcs[target_action_index].func = new_func_ptr;
-        return BB_SUCCESS;
     }
+
+    return BB_SUCCESS;
 }
 
 bytebeam_err_t bytebeam_is_action_handler_there(bytebeam_client_t *bytebeam_client, char *func_name)
@@ -242,20 +441,17 @@ bytebeam_err_t bytebeam_is_action_handler_there(bytebeam_client_t *bytebeam_clie
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
-    int target_action_index = -1;
+    taskENTER_CRITICAL(&action_lock);
 
-    for (action_iterator = 0; action_iterator < function_handler_index; action_iterator++) {
-        if (!strcmp(bytebeam_client->action_funcs[action_iterator].name, func_name)) {
-            target_action_index = action_iterator;
-        }
-    }
+    int target_slot = action_table_find(&bytebeam_client->action_funcs, func_name, action_hash(func_name));
+
+    taskEXIT_CRITICAL(&action_lock);
 
-    if (target_action_index == -1) {
+    if (target_slot == -1) {
         BB_LOGE(TAG, "action : %s not found \n", func_name);
         return BB_FAILURE;
     } else {
-        BB_LOGI(TAG, "action : %s found at index %d\n", func_name, target_action_index);
+        BB_LOGI(TAG, "action : %s found at slot %d\n", func_name, target_slot);
         return BB_SUCCESS;
     }
 }
@@ -268,18 +464,62 @@ bytebeam_err_t bytebeam_print_action_handler_array(bytebeam_client_t *bytebeam_c
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
+    bytebeam_action_table_t *table = &bytebeam_client->action_funcs;
+    char *names = NULL;
+    size_t names_len = 0;
 
-    BB_LOGI(TAG, "[");
-    for (action_iterator = 0; action_iterator < BYTEBEAM_NUMBER_OF_ACTIONS; action_iterator++) {
-        if (bytebeam_client->action_funcs[action_iterator].name != NULL) {
-            BB_LOGI(TAG, "       {%s : %s}       \n", bytebeam_client->action_funcs[action_iterator].name, "*******");
-        } else {
-            BB_LOGI(TAG, "       {%s : %s}       \n", "NULL", "NULL");
+    // the names are copied out under the lock and logged without it, a concurrent add may free the slots meanwhile
+    while (1) {
+        taskENTER_CRITICAL(&action_lock);
+
+        size_t needed = 0;
+
+        for (uint32_t slot = 0; slot < table->capacity; slot++) {
+            if (table->slots[slot].name != NULL) {
+                needed += strlen(table->slots[slot].name) + 1;
+            }
+        }
+
+        if (names != NULL && names_len >= needed) {
+            char *next = names;
+
+            for (uint32_t slot = 0; slot < table->capacity; slot++) {
+                if (table->slots[slot].name != NULL) {
+                    size_t len = strlen(table->slots[slot].name) + 1;
+
+                    memcpy(next, table->slots[slot].name, len);
+                    next += len;
+                }
+            }
+
+            names_len = needed;
+
+            taskEXIT_CRITICAL(&action_lock);
+            break;
+        }
+
+        taskEXIT_CRITICAL(&action_lock);
+
+        // never allocate with the lock held, the table is measured again afterwards
+        free(names);
+
+        names_len = needed;
+        names = malloc(names_len + 1);
+
+        if (names == NULL) {
+            BB_LOGE(TAG, "Failed to allocate the memory to print the action handlers");
+            return BB_FAILURE;
         }
     }
+
+    BB_LOGI(TAG, "[");
+    for (size_t offset = 0; offset < names_len; offset += strlen(names + offset) + 1) {
+        BB_LOGI(TAG, "       {%s : %s}       \n", names + offset, "*******");
+    }
     BB_LOGI(TAG, "]");
 
+    free(names);
+
     return BB_SUCCESS;
 }
 
@@ -291,14 +531,23 @@ bytebeam_err_t bytebeam_reset_action_handler_array(bytebeam_client_t *bytebeam_c
         return BB_NULL_CHECK_FAILURE;
     }
 
-    int action_iterator = 0;
+    bytebeam_action_table_t *table = &bytebeam_client->action_funcs;
+
+    taskENTER_CRITICAL(&action_lock);
 
-    for (action_iterator = 0; action_iterator < BYTEBEAM_NUMBER_OF_ACTIONS; action_iterator++) {
-        bytebeam_client->action_funcs[action_iterator].func = NULL;
-        bytebeam_client->action_funcs[action_iterator].name = NULL;
+    bytebeam_action_table_t retired = *table;
+
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+
+    taskEXIT_CRITICAL(&action_lock);
+
+    for (uint32_t slot = 0; slot < retired.capacity; slot++) {
+        free(retired.slots[slot].name);
     }
 
-    function_handler_index = 0;
+    free(retired.slots);
 
     return BB_SUCCESS;
 }
@@ -366,160 +615,75 @@ bytebeam_err_t bytebeam_publish_action_progress(bytebeam_client_t *bytebeam_clie
 bytebeam_err_t bytebeam_publish_action_status(bytebeam_client_t *bytebeam_client, char *action_id, int percentage, char *status, char *error_message)
 {
     static uint64_t sequence = 0;
-    unsigned long long milliseconds = 0;
-
-    cJSON *action_status_json_list = NULL;
-    cJSON *action_status_json = NULL;
-    cJSON *percentage_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *device_status_json = NULL;
-    cJSON *action_id_json = NULL;
-    cJSON *action_errors_json = NULL;
-    cJSON *seq_json = NULL;
-    char *string_json = NULL;
-    const char *ota_states[1] = { "" };
 
     int qos = 1;
     int msg_id = 0;
-    char topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = {0};
-
-    action_status_json_list = cJSON_CreateArray();
-
-    if (action_status_json_list == NULL) {
-        BB_LOGE(TAG, "Json Init failed.");
-
-        return BB_FAILURE;
-    }
-
-    action_status_json = cJSON_CreateObject();
-
-    if (action_status_json == NULL) {
-        BB_LOGE(TAG, "Json add failed.");
+    char status_str[BYTEBEAM_ACTION_STATUS_STR_LEN];
+    size_t status_len = 0;
+    bytebeam_encoder_t encoder;
 
-        cJSON_Delete(action_status_json_list);
+    if (bytebeam_client->topics.action_status == NULL)
+    {
+        BB_LOGE(TAG, "action topics are not initialized");
         return BB_FAILURE;
     }
 
-    milliseconds = bytebeam_hal_get_epoch_millis();
+    unsigned long long milliseconds = bytebeam_hal_get_epoch_millis();
 
     if(milliseconds == 0)
     {
         BB_LOGE(TAG, "failed to get epoch millis.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    timestamp_json = cJSON_CreateNumber(milliseconds);
-
-    if (timestamp_json == NULL) {
-        BB_LOGE(TAG, "Json add time stamp failed.");
-
-        cJSON_Delete(action_status_json_list);
         return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(action_status_json, "timestamp", timestamp_json);
-
     sequence++;
-    seq_json = cJSON_CreateNumber(sequence);
-
-    if (seq_json == NULL) {
-        BB_LOGE(TAG, "Json add seq id failed.");
-     
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "sequence", seq_json);
-
-    device_status_json = cJSON_CreateString(status);
-
-    if (device_status_json == NULL) {
-        BB_LOGE(TAG, "Json add device status failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "state", device_status_json);
-
-    ota_states[0] = error_message;
-    action_errors_json = cJSON_CreateStringArray(ota_states, 1);
-
-    if (action_errors_json == NULL) {
-        BB_LOGE(TAG, "Json add action errors failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
 
-    cJSON_AddItemToObject(action_status_json, "errors", action_errors_json);
-
-    action_id_json = cJSON_CreateString(action_id);
-
-    if (action_id_json == NULL) {
-        BB_LOGE(TAG, "Json add action_id failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "id", action_id_json);
-
-    percentage_json = cJSON_CreateNumber(percentage);
-
-    if (percentage_json == NULL) {
-        BB_LOGE(TAG, "Json add progress percentage failed.");
-
-        cJSON_Delete(action_status_json_list);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(action_status_json, "progress", percentage_json);
-
-    cJSON_AddItemToArray(action_status_json_list, action_status_json);
-
-    string_json = cJSON_Print(action_status_json_list);
-
-    if(string_json == NULL)
+    bytebeam_encoder_init(&encoder, BYTEBEAM_MESSAGE_ENCODING, status_str, sizeof(status_str));
+    bytebeam_encoder_begin_array(&encoder, 1);
+    bytebeam_encoder_begin_map(&encoder, 6);
+    bytebeam_encoder_put_key(&encoder, "timestamp");
+    bytebeam_encoder_put_uint(&encoder, milliseconds);
+    bytebeam_encoder_put_key(&encoder, "sequence");
+    bytebeam_encoder_put_uint(&encoder, sequence);
+    bytebeam_encoder_put_key(&encoder, "state");
+    bytebeam_encoder_put_string(&encoder, status);
+    bytebeam_encoder_put_key(&encoder, "errors");
+    bytebeam_encoder_begin_array(&encoder, 1);
+    bytebeam_encoder_put_string(&encoder, error_message);
+    bytebeam_encoder_end(&encoder);
+    bytebeam_encoder_put_key(&encoder, "id");
+    bytebeam_encoder_put_string(&encoder, action_id);
+    bytebeam_encoder_put_key(&encoder, "progress");
+    bytebeam_encoder_put_int(&encoder, percentage);
+    bytebeam_encoder_end(&encoder);
+    bytebeam_encoder_end(&encoder);
+
+    if (bytebeam_encoder_finish(&encoder, &status_len) != BB_SUCCESS)
     {
-        BB_LOGE(TAG, "Json string print failed.");
-
-        cJSON_Delete(action_status_json_list);
+        BB_LOGE(TAG, "Action status exceeded buffer size");
         return BB_FAILURE;
-    } 
-
-    BB_LOGD(TAG, "\nTrying to print:\n%s\n", string_json);
-
-    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
-    int temp_var = snprintf(topic, max_len, "/tenants/%s/devices/%s/action/status", bytebeam_client->device_cfg.project_id, bytebeam_client->device_cfg.device_id);
+    }
 
-    if(temp_var >= max_len)
+    // the status takes the control lane, it only waits for the outbox once the reserved capacity is used up
+    if (bytebeam_flow_check(bytebeam_client, BYTEBEAM_PRIORITY_CONTROL) == BB_WOULD_BLOCK)
     {
-        BB_LOGE(TAG, "action status topic size exceeded topic buffer size");
-
-        cJSON_Delete(action_status_json_list);
-        cJSON_free(string_json);
-        return BB_FAILURE;
+        BB_LOGE(TAG, "Action status would block, outbox is full");
+        return BB_WOULD_BLOCK;
     }
 
-    BB_LOGI(TAG, "\nTopic is %s\n", topic);
+    long long start_us = bytebeam_hal_get_uptime_us();
 
-    msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, topic, string_json, strlen(string_json), qos);
+    msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, bytebeam_client->topics.action_status, status_str, status_len, qos);
 
     if (msg_id != -1) {
-        BB_LOGI(TAG, "sent publish successful, msg_id=%d, message:%s", msg_id, string_json);
+        BB_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+
+        // tracked for the latency statistics, nothing waits on it
+        bytebeam_inflight_add(msg_id, BYTEBEAM_PRIORITY_CONTROL, start_us, NULL, NULL);
     } else {
         BB_LOGE(TAG, "Publish Failed.");
-
-        cJSON_Delete(action_status_json_list);
-        cJSON_free(string_json);
         return BB_FAILURE;
     }
 
-    cJSON_Delete(action_status_json_list);
-    cJSON_free(string_json);
-
     return BB_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,348 @@
+#include "bytebeam_hal.h"
+#include "bytebeam_aggregate.h"
+
+/*
+ *  A window is split in panes of slide_ms, a tumbling window being a single pane. Each pane keeps the running
+ *  statistics of its samples (Welford), and a window is emitted by merging its panes (Chan et al.), so the memory
+ *  stays at one set of statistics per pane and field whatever the sample rate.
+ */
+
+/* suffixes of the schema fields emitted for every aggregated field, in order */
+#define AGGREGATE_SUFFIXES 4
+#define AGGREGATE_SUFFIX_MAX_LEN 5
+
+/**
+ * @struct aggregate_stats_t
+ * This struct contains the running statistics of a field over a pane or a window
+ * @var aggregate_stats_t::mean
+ * Mean of the samples
+ * @var aggregate_stats_t::m2
+ * Sum of the squared differences from the mean
+ * @var aggregate_stats_t::min
+ * Smallest sample
+ * @var aggregate_stats_t::max
+ * Largest sample
+ */
+typedef struct aggregate_stats {
+    double mean;
+    double m2;
+    double min;
+    double max;
+} aggregate_stats_t;
+
+/**
+ * @struct bytebeam_aggregate
+ * This struct contains an aggregation stage, the panes share its allocation
+ * @var bytebeam_aggregate::batch
+ * Batch stream the windows are emitted to
+ * @var bytebeam_aggregate::num_fields
+ * Number of aggregated fields
+ * @var bytebeam_aggregate::num_panes
+ * Number of panes in a window
+ * @var bytebeam_aggregate::slide_ms
+ * Length of a pane
+ * @var bytebeam_aggregate::current
+ * Pane taking the samples
+ * @var bytebeam_aggregate::pane_end_ms
+ * Uptime at which the current pane closes, 0 until the first sample
+ * @var bytebeam_aggregate::stats
+ * Statistics by pane, then by field
+ * @var bytebeam_aggregate::counts
+ * Samples in each pane
+ */
+struct bytebeam_aggregate {
+    bytebeam_batch_handle_t batch;
+    int num_fields;
+    int num_panes;
+    uint32_t slide_ms;
+    int current;
+    long long pane_end_ms;
+    aggregate_stats_t *stats;
+    uint32_t *counts;
+};
+
+static const char *aggregate_suffixes[AGGREGATE_SUFFIXES] = { "_min", "_max", "_mean", "_var" };
+
+static const char *TAG = "BYTEBEAM_AGGREGATE";
+
+static void aggregate_reset_pane(struct bytebeam_aggregate *aggregate, int pane)
+{
+    aggregate->counts[pane] = 0;
+    memset(&aggregate->stats[pane * aggregate->num_fields], 0, aggregate->num_fields * sizeof(aggregate_stats_t));
+}
+
+static void aggregate_merge(aggregate_stats_t *into, uint32_t into_count, const aggregate_stats_t *from, uint32_t from_count)
+{
+    if (into_count == 0)
+    {
+        *into = *from;
+        return;
+    }
+
+    double total = (double)into_count + from_count;
+    double delta = from->mean - into->mean;
+
+    into->mean += delta * from_count / total;
+    into->m2 += from->m2 + delta * delta * into_count * from_count / total;
+
+    if (from->min < into->min)
+    {
+        into->min = from->min;
+    }
+
+    if (from->max > into->max)
+    {
+        into->max = from->max;
+    }
+}
+
+static bytebeam_err_t aggregate_emit(struct bytebeam_aggregate *aggregate)
+{
+    aggregate_stats_t window[BYTEBEAM_AGGREGATE_MAX_FIELDS];
+    bytebeam_field_value_t values[BYTEBEAM_BATCH_MAX_FIELDS];
+    uint32_t count = 0;
+
+    for (int pane = 0; pane < aggregate->num_panes; pane++)
+    {
+        uint32_t pane_count = aggregate->counts[pane];
+
+        if (pane_count == 0)
+        {
+            continue;
+        }
+
+        for (int field = 0; field < aggregate->num_fields; field++)
+        {
+            aggregate_merge(&window[field], count, &aggregate->stats[pane * aggregate->num_fields + field], pane_count);
+        }
+
+        count += pane_count;
+    }
+
+    // an empty window is not worth a record
+    if (count == 0)
+    {
+        return BB_SUCCESS;
+    }
+
+    values[0].int_value = count;
+
+    for (int field = 0; field < aggregate->num_fields; field++)
+    {
+        bytebeam_field_value_t *field_values = &values[1 + field * AGGREGATE_SUFFIXES];
+
+        field_values[0].double_value = window[field].min;
+        field_values[1].double_value = window[field].max;
+        field_values[2].double_value = window[field].mean;
+        field_values[3].double_value = window[field].m2 / count;
+    }
+
+    return bytebeam_stream_record_push_values(aggregate->batch, values);
+}
+
+static bytebeam_err_t aggregate_advance(struct bytebeam_aggregate *aggregate, long long now_ms)
+{
+    bytebeam_err_t err_code = BB_SUCCESS;
+    int closed = 0;
+
+    if (aggregate->pane_end_ms == 0)
+    {
+        aggregate->pane_end_ms = now_ms + aggregate->slide_ms;
+        return BB_SUCCESS;
+    }
+
+    while (now_ms >= aggregate->pane_end_ms)
+    {
+        // every pane is empty once a whole window closed, the idle windows in between are skipped at once
+        if (closed == aggregate->num_panes)
+        {
+            long long idle_panes = (now_ms - aggregate->pane_end_ms) / aggregate->slide_ms + 1;
+
+            aggregate->pane_end_ms += idle_panes * aggregate->slide_ms;
+            break;
+        }
+
+        if (aggregate_emit(aggregate) != BB_SUCCESS)
+        {
+            BB_LOGE(TAG, "Failed to push the aggregated window");
+            err_code = BB_FAILURE;
+        }
+
+        // the oldest pane leaves the window and takes the next samples
+        aggregate->current = (aggregate->current + 1) % aggregate->num_panes;
+        aggregate_reset_pane(aggregate, aggregate->current);
+
+        aggregate->pane_end_ms += aggregate->slide_ms;
+        closed++;
+    }
+
+    return err_code;
+}
+
+bytebeam_err_t bytebeam_aggregate_init(bytebeam_batch_handle_t batch, const char *const *field_names, int num_fields,
+                                       const bytebeam_aggregate_config_t *config, bytebeam_aggregate_handle_t *handle)
+{
+    if (batch == NULL || field_names == NULL || config == NULL || handle == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (num_fields <= 0 || num_fields > BYTEBEAM_AGGREGATE_MAX_FIELDS)
+    {
+        BB_LOGE(TAG, "Aggregation must have 1 to %d fields", BYTEBEAM_AGGREGATE_MAX_FIELDS);
+        return BB_FAILURE;
+    }
+
+    uint32_t slide_ms = (config->slide_ms == 0) ? config->window_ms : config->slide_ms;
+
+    if (config->window_ms == 0 || config->window_ms % slide_ms != 0 || config->window_ms / slide_ms > BYTEBEAM_AGGREGATE_MAX_PANES)
+    {
+        BB_LOGE(TAG, "Aggregation window must be a multiple of the slide, up to %d panes", BYTEBEAM_AGGREGATE_MAX_PANES);
+        return BB_FAILURE;
+    }
+
+    int num_panes = config->window_ms / slide_ms;
+    size_t names_len = 0;
+
+    for (int field = 0; field < num_fields; field++)
+    {
+        if (field_names[field] == NULL)
+        {
+            return BB_NULL_CHECK_FAILURE;
+        }
+
+        names_len += AGGREGATE_SUFFIXES * (strlen(field_names[field]) + AGGREGATE_SUFFIX_MAX_LEN + 1);
+    }
+
+    // the schema copies the names, they are only built for the registration
+    bytebeam_field_t schema[BYTEBEAM_BATCH_MAX_FIELDS];
+    char *names = malloc(names_len);
+
+    if (names == NULL)
+    {
+        BB_LOGE(TAG, "Failed to allocate the memory for the aggregated field names");
+        return BB_FAILURE;
+    }
+
+    char *cursor = names;
+
+    schema[0].name = "count";
+    schema[0].type = BYTEBEAM_FIELD_TYPE_INT64;
+
+    for (int field = 0; field < num_fields; field++)
+    {
+        for (int suffix = 0; suffix < AGGREGATE_SUFFIXES; suffix++)
+        {
+            bytebeam_field_t *schema_field = &schema[1 + field * AGGREGATE_SUFFIXES + suffix];
+
+            schema_field->name = cursor;
+            schema_field->type = BYTEBEAM_FIELD_TYPE_DOUBLE;
+
+            cursor += sprintf(cursor, "%s%s", field_names[field], aggregate_suffixes[suffix]) + 1;
+        }
+    }
+
+    bytebeam_err_t err_code = bytebeam_batch_register_schema(batch, schema, 1 + num_fields * AGGREGATE_SUFFIXES);
+
+    free(names);
+
+    if (err_code != BB_SUCCESS)
+    {
+        return BB_FAILURE;
+    }
+
+    // the stage, its statistics and its counts go in one allocation
+    size_t stats_len = num_panes * num_fields * sizeof(aggregate_stats_t);
+    struct bytebeam_aggregate *aggregate = malloc(sizeof(struct bytebeam_aggregate) + stats_len + num_panes * sizeof(uint32_t));
+
+    if (aggregate == NULL)
+    {
+        BB_LOGE(TAG, "Failed to allocate the memory for the aggregation stage");
+        return BB_FAILURE;
+    }
+
+    aggregate->batch = batch;
+    aggregate->num_fields = num_fields;
+    aggregate->num_panes = num_panes;
+    aggregate->slide_ms = slide_ms;
+    aggregate->current = 0;
+    aggregate->pane_end_ms = 0;
+    aggregate->stats = (aggregate_stats_t *)(aggregate + 1);
+    aggregate->counts = (uint32_t *)((char *)aggregate->stats + stats_len);
+
+    for (int pane = 0; pane < num_panes; pane++)
+    {
+        aggregate_reset_pane(aggregate, pane);
+    }
+
+    *handle = aggregate;
+
+    BB_LOGI(TAG, "Aggregating %d fields over %u ms windows every %u ms", num_fields, (unsigned)config->window_ms, (unsigned)slide_ms);
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_aggregate_deinit(bytebeam_aggregate_handle_t handle)
+{
+    free(handle);
+}
+
+bytebeam_err_t bytebeam_aggregate_push(bytebeam_aggregate_handle_t handle, const double *values)
+{
+    if (handle == NULL || values == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_err_t err_code = aggregate_advance(handle, bytebeam_hal_get_uptime_ms());
+
+    uint32_t count = ++handle->counts[handle->current];
+    aggregate_stats_t *stats = &handle->stats[handle->current * handle->num_fields];
+
+    for (int field = 0; field < handle->num_fields; field++)
+    {
+        double value = values[field];
+
+        if (count == 1)
+        {
+            stats[field].mean = value;
+            stats[field].m2 = 0;
+            stats[field].min = value;
+            stats[field].max = value;
+            continue;
+        }
+
+        double delta = value - stats[field].mean;
+
+        stats[field].mean += delta / count;
+        stats[field].m2 += delta * (value - stats[field].mean);
+
+        if (value < stats[field].min)
+        {
+            stats[field].min = value;
+        }
+
+        if (value > stats[field].max)
+        {
+            stats[field].max = value;
+        }
+    }
+
+    return err_code;
+}
+
+bytebeam_err_t bytebeam_aggregate_poll(bytebeam_aggregate_handle_t handle)
+{
+    if (handle == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    // nothing was sampled yet, there is no window to close
+    if (handle->pane_end_ms == 0)
+    {
+        return BB_SUCCESS;
+    }
+
+    return aggregate_advance(handle, bytebeam_hal_get_uptime_ms());
+}
@@ -0,0 +1,1422 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_queue.h"
+#include "bytebeam_stream.h"
+#include "bytebeam_batch.h"
+#include "bytebeam_store.h"
+#include "bytebeam_encoder.h"
+#include "bytebeam_inflight.h"
+#include "bytebeam_flow.h"
+#include "bytebeam_time.h"
+
+/* room kept for the closing bracket (or the cbor break) and the NULL character */
+#define BATCH_WRITER_TRAILER_LEN 2
+
+/* cbor framing of a batch, an indefinite length array closed by a break */
+#define BATCH_CBOR_ARRAY_START 0x9F
+#define BATCH_CBOR_BREAK 0xFF
+
+/* longest encoded field value, a json double such as -2.2250738585072014e-308 or a cbor float64 */
+#define BATCH_JSON_VALUE_MAX_LEN 24
+#define BATCH_CBOR_ITEM_MAX_LEN 9
+
+/* This enum represents the life cycle of a batch buffer */
+typedef enum bytebeam_batch_buffer_state {
+    BATCH_BUFFER_FREE,          //!< Empty and not in use
+    BATCH_BUFFER_FILLING,       //!< Accepting records
+    BATCH_BUFFER_IN_FLIGHT,     //!< Sealed and owned by the transport until it is published
+    BATCH_BUFFER_SENT           //!< Published and kept until the publish completes
+} bytebeam_batch_buffer_state_t;
+
+/* publish result of a sent buffer that has not completed yet */
+#define BATCH_PUBLISH_PENDING -1
+
+/* publish result of a buffer waiting for its next retry */
+#define BATCH_PUBLISH_BACKOFF -2
+
+/* publish result of a buffer that ran out of retries and was handed to the spill handler */
+#define BATCH_PUBLISH_ABANDONED -3
+
+/* largest power of two the retry base delay is scaled by */
+#define BATCH_RETRY_MAX_SHIFT 16
+
+/**
+ * @struct batch_raw_record_t
+ * This struct contains a record of a batch stream with a schema as it is stored in a queue slot, only the values
+ * of the schema fields are stored
+ * @var batch_raw_record_t::uptime_us
+ * Uptime at which the record was pushed, turned into epoch milliseconds when the record is encoded
+ * @var batch_raw_record_t::sequence
+ * Record sequence number
+ * @var batch_raw_record_t::values
+ * Values of the schema fields, in schema order
+ */
+typedef struct batch_raw_record {
+    int64_t uptime_us;
+    uint64_t sequence;
+    bytebeam_field_value_t values[BYTEBEAM_BATCH_MAX_FIELDS];
+} batch_raw_record_t;
+
+/**
+ * @struct batch_field_filter_t
+ * This struct contains the reporting filter of a schema field and its running state
+ * @var batch_field_filter_t::enabled
+ * Set if the field has a filter
+ * @var batch_field_filter_t::filter
+ * Field filter
+ * @var batch_field_filter_t::state
+ * Running state of the filter
+ */
+typedef struct batch_field_filter {
+    bool enabled;
+    bytebeam_field_filter_t filter;
+    bytebeam_filter_state_t state;
+} batch_field_filter_t;
+
+/**
+ * @struct bytebeam_batch_buffer_t
+ * This struct contains a single batch buffer of a batch stream
+ * @var bytebeam_batch_buffer_t::writer
+ * Batch being built in the buffer
+ * @var bytebeam_batch_buffer_t::state
+ * Life cycle state of the buffer
+ * @var bytebeam_batch_buffer_t::result
+ * How the publish of a sent buffer completed, BATCH_PUBLISH_PENDING until then
+ * @var bytebeam_batch_buffer_t::attempts
+ * Failed publishes of the batch, a missing acknowledgement counts as one
+ * @var bytebeam_batch_buffer_t::sealed_tick
+ * Tick at which the batch was sealed, the retry age is counted from it
+ * @var bytebeam_batch_buffer_t::retry_tick
+ * Tick at which the batch is published again while its result is BATCH_PUBLISH_BACKOFF
+ */
+typedef struct bytebeam_batch_buffer {
+    bytebeam_batch_writer_t writer;
+    bytebeam_batch_buffer_state_t state;
+    atomic_int result;
+    uint32_t attempts;
+    TickType_t sealed_tick;
+    TickType_t retry_tick;
+} bytebeam_batch_buffer_t;
+
+/**
+ * @struct bytebeam_batch
+ * This struct contains the state of a single batch stream
+ * @var bytebeam_batch::active
+ * Set once the batch stream is fully initialized and can be serviced
+ * @var bytebeam_batch::claimed
+ * Set once the pool entry is taken by bytebeam_batch_init
+ * @var bytebeam_batch::client
+ * Bytebeam client used to publish the batches
+ * @var bytebeam_batch::stream_name
+ * Name of the target stream
+ * @var bytebeam_batch::stream
+ * Open handle of the target stream, NULL if the open streams table was full
+ * @var bytebeam_batch::policy
+ * Batch flush policy
+ * @var bytebeam_batch::queue
+ * Records waiting for the MQTT Data Publish Thread
+ * @var bytebeam_batch::buffers
+ * Ring of batch buffers, buffers are sealed and published in ring order
+ * @var bytebeam_batch::ack_index
+ * Index of the oldest sent buffer
+ * @var bytebeam_batch::sent
+ * Number of sent buffers waiting for their publish to complete, they precede the in flight ones
+ * @var bytebeam_batch::send_index
+ * Index of the oldest in flight buffer
+ * @var bytebeam_batch::in_flight
+ * Number of sealed buffers owned by the transport
+ * @var bytebeam_batch::deadline
+ * Tick at which the filling buffer must be sealed
+ * @var bytebeam_batch::buffers_full
+ * Set while every buffer is sent or in flight
+ * @var bytebeam_batch::event_handler
+ * Application callback for batch stream events
+ * @var bytebeam_batch::flush_requested
+ * Set by bytebeam_batch_flush
+ * @var bytebeam_batch::sequence
+ * Record sequence counter
+ * @var bytebeam_batch::fields
+ * Schema fields, NULL if the records are pushed already encoded
+ * @var bytebeam_batch::num_fields
+ * Number of schema fields
+ * @var bytebeam_batch::record_max_len
+ * Length of the largest encoded record, a buffer that can not take one more is sealed
+ * @var bytebeam_batch::filters
+ * Filters of the schema fields, NULL until the first filter is set
+ * @var bytebeam_batch::num_filters
+ * Number of schema fields with a filter
+ * @var bytebeam_batch::spill_handler
+ * Application handler for the batches that ran out of retries, NULL to store or drop them
+ * @var bytebeam_batch::retries
+ * Retry counter, see bytebeam_batch_stats_t
+ * @var bytebeam_batch::backoff_ms
+ * Backoff time counter, see bytebeam_batch_stats_t
+ * @var bytebeam_batch::spilled
+ * Spilled batch counter, see bytebeam_batch_stats_t
+ * @var bytebeam_batch::dropped
+ * Dropped batch counter, see bytebeam_batch_stats_t
+ * @var bytebeam_batch::filtered
+ * Filtered record counter, see bytebeam_batch_stats_t
+ */
+struct bytebeam_batch {
+    atomic_bool active;
+    bool claimed;
+    bytebeam_client_t *client;
+    char stream_name[BYTEBEAM_BATCH_STREAM_STR_LEN];
+    bytebeam_stream_handle_t stream;
+    bytebeam_batch_policy_t policy;
+    bytebeam_queue_t queue;
+    bytebeam_batch_buffer_t buffers[CONFIG_MQTT_BATCH_BUFFER_COUNT];
+    int ack_index;
+    int sent;
+    int send_index;
+    int in_flight;
+    TickType_t deadline;
+    bool buffers_full;
+    bytebeam_batch_event_handler_t event_handler;
+    atomic_bool flush_requested;
+    _Atomic uint64_t sequence;
+    bytebeam_field_t *fields;
+    int num_fields;
+    size_t record_max_len;
+    batch_field_filter_t *filters;
+    int num_filters;
+    bytebeam_batch_spill_handler_t spill_handler;
+    atomic_uint retries;
+    atomic_uint backoff_ms;
+    atomic_uint spilled;
+    atomic_uint dropped;
+    atomic_uint filtered;
+};
+
+static struct bytebeam_batch batch_streams[CONFIG_MQTT_BATCH_MAX_STREAMS];
+static portMUX_TYPE batch_streams_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE batch_filter_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t volatile batch_task_handle = NULL;
+
+static const char *TAG = "BYTEBEAM_BATCH";
+
+bytebeam_err_t bytebeam_batch_writer_init(bytebeam_batch_writer_t *writer, bytebeam_encoding_t encoding, char *buf, size_t capacity)
+{
+    if (writer == NULL || buf == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    // we need room for at least "[]" and the NULL character
+    if (capacity < 1 + BATCH_WRITER_TRAILER_LEN)
+    {
+        return BB_FAILURE;
+    }
+
+    writer->encoding = encoding;
+    writer->buf = buf;
+    writer->capacity = capacity;
+
+    bytebeam_batch_writer_reset(writer);
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_batch_writer_reset(bytebeam_batch_writer_t *writer)
+{
+    writer->buf[0] = (writer->encoding == BYTEBEAM_ENCODING_CBOR) ? (char)BATCH_CBOR_ARRAY_START : '[';
+    writer->buf[1] = '\0';
+    writer->len = 1;
+    writer->count = 0;
+}
+
+bytebeam_err_t bytebeam_batch_writer_append(bytebeam_batch_writer_t *writer, const char *element, size_t len)
+{
+    if (writer == NULL || element == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    // cbor items are self delimiting, only json needs a separator
+    size_t separator_len = (writer->count > 0 && writer->encoding == BYTEBEAM_ENCODING_JSON) ? 1 : 0;
+    size_t available = writer->capacity - writer->len - BATCH_WRITER_TRAILER_LEN;
+
+    if (separator_len + len > available)
+    {
+        return BB_FAILURE;
+    }
+
+    char *cursor = writer->buf + writer->len;
+
+    if (separator_len != 0)
+    {
+        *cursor++ = ',';
+    }
+
+    memcpy(cursor, element, len);
+    cursor[len] = '\0';
+
+    writer->len = writer->len + separator_len + len;
+    writer->count++;
+
+    return BB_SUCCESS;
+}
+
+size_t bytebeam_batch_writer_available(bytebeam_batch_writer_t *writer)
+{
+    size_t separator_len = (writer->count > 0 && writer->encoding == BYTEBEAM_ENCODING_JSON) ? 1 : 0;
+    size_t available = writer->capacity - writer->len - BATCH_WRITER_TRAILER_LEN;
+
+    return (available > separator_len) ? (available - separator_len) : 0;
+}
+
+const char* bytebeam_batch_writer_finish(bytebeam_batch_writer_t *writer, size_t *len)
+{
+    writer->buf[writer->len] = (writer->encoding == BYTEBEAM_ENCODING_CBOR) ? (char)BATCH_CBOR_BREAK : ']';
+    writer->buf[writer->len + 1] = '\0';
+
+    if (len != NULL)
+    {
+        *len = writer->len + 1;
+    }
+
+    return writer->buf;
+}
+
+void bytebeam_mqtt_thread_wake(void)
+{
+    TaskHandle_t task_handle = batch_task_handle;
+
+    // if the task is not running yet it will service every batch stream as soon as it starts
+    if (task_handle != NULL)
+    {
+        xTaskNotifyGive(task_handle);
+    }
+}
+
+bool bytebeam_mqtt_thread_is_current(void)
+{
+    TaskHandle_t task_handle = batch_task_handle;
+
+    return (task_handle != NULL && task_handle == xTaskGetCurrentTaskHandle());
+}
+
+bytebeam_err_t bytebeam_batch_init(bytebeam_client_t *bytebeam_client, char *stream_name, const bytebeam_batch_policy_t *policy, bytebeam_batch_handle_t *handle)
+{
+    const bytebeam_batch_policy_t default_policy = BYTEBEAM_BATCH_DEFAULT_POLICY();
+    struct bytebeam_batch *batch = NULL;
+
+    if (bytebeam_client == NULL || stream_name == NULL || handle == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (policy == NULL)
+    {
+        policy = &default_policy;
+    }
+
+    // an empty batch must always have room for the largest record, its brackets and the separator
+    if (policy->max_records <= 0 || policy->max_bytes < CONFIG_MQTT_BATCH_ELEMENT_SIZE + 1 + BATCH_WRITER_TRAILER_LEN)
+    {
+        BB_LOGE(TAG, "Batch policy must allow at least one record");
+        return BB_FAILURE;
+    }
+
+    if (strlen(stream_name) >= BYTEBEAM_BATCH_STREAM_STR_LEN)
+    {
+        BB_LOGE(TAG, "Batch stream name size exceeded buffer size");
+        return BB_FAILURE;
+    }
+
+    taskENTER_CRITICAL(&batch_streams_lock);
+
+    for (int loop_var = 0; loop_var < CONFIG_MQTT_BATCH_MAX_STREAMS; loop_var++)
+    {
+        if (!batch_streams[loop_var].claimed)
+        {
+            batch = &batch_streams[loop_var];
+            batch->claimed = true;
+            break;
+        }
+    }
+
+    taskEXIT_CRITICAL(&batch_streams_lock);
+
+    if (batch == NULL)
+    {
+        BB_LOGE(TAG, "All %d batch streams are in use", CONFIG_MQTT_BATCH_MAX_STREAMS);
+        return BB_FAILURE;
+    }
+
+    bytebeam_err_t err_code = bytebeam_queue_init(&batch->queue,
+                                                  CONFIG_MQTT_BATCH_QUEUE_DEPTH,
+                                                  CONFIG_MQTT_BATCH_ELEMENT_SIZE,
+                                                  CONFIG_MQTT_BATCH_QUEUE_POLICY,
+                                                  CONFIG_MQTT_BATCH_QUEUE_BLOCK_TIMEOUT);
+
+    if (err_code != BB_SUCCESS)
+    {
+        BB_LOGE(TAG, "Batch queue creation failed for %s stream", stream_name);
+
+        batch->claimed = false;
+        return BB_FAILURE;
+    }
+
+    for (int loop_var = 0; loop_var < CONFIG_MQTT_BATCH_BUFFER_COUNT; loop_var++)
+    {
+        // +1 for the NULL character, the policy limits the batch payload itself
+        char *buf = malloc(policy->max_bytes + 1);
+
+        if (buf == NULL)
+        {
+            BB_LOGE(TAG, "Batch buffer allocation failed for %s stream", stream_name);
+
+            while (loop_var-- > 0)
+            {
+                free(batch->buffers[loop_var].writer.buf);
+            }
+
+            bytebeam_queue_deinit(&batch->queue);
+            batch->claimed = false;
+            return BB_FAILURE;
+        }
+
+        bytebeam_batch_writer_init(&batch->buffers[loop_var].writer, policy->encoding, buf, policy->max_bytes + 1);
+        batch->buffers[loop_var].state = BATCH_BUFFER_FREE;
+    }
+
+    // the topics are built here once, a stream that does not fit the table is published by name instead
+    if (bytebeam_stream_open(bytebeam_client, stream_name, &batch->stream) != BB_SUCCESS)
+    {
+        batch->stream = NULL;
+    }
+
+    batch->client = bytebeam_client;
+    batch->policy = *policy;
+
+    // a zero delay takes the config menu value, so a policy written before the retry fields existed keeps working
+    if (batch->policy.retry_base_ms == 0)
+    {
+        batch->policy.retry_base_ms = CONFIG_MQTT_BATCH_RETRY_BASE;
+    }
+
+    if (batch->policy.retry_max_ms == 0)
+    {
+        batch->policy.retry_max_ms = CONFIG_MQTT_BATCH_RETRY_MAX;
+    }
+
+    batch->ack_index = 0;
+    batch->sent = 0;
+    batch->send_index = 0;
+    batch->in_flight = 0;
+    batch->deadline = 0;
+    batch->buffers_full = false;
+    batch->event_handler = NULL;
+    batch->fields = NULL;
+    batch->num_fields = 0;
+    batch->record_max_len = batch->queue.record_size;
+    batch->filters = NULL;
+    batch->num_filters = 0;
+    batch->spill_handler = NULL;
+    strcpy(batch->stream_name, stream_name);
+
+    atomic_store(&batch->retries, 0);
+    atomic_store(&batch->backoff_ms, 0);
+    atomic_store(&batch->spilled, 0);
+    atomic_store(&batch->dropped, 0);
+    atomic_store(&batch->filtered, 0);
+    atomic_store(&batch->flush_requested, false);
+    atomic_store(&batch->sequence, 0);
+    atomic_store(&batch->active, true);
+
+    *handle = batch;
+
+    BB_LOGI(TAG, "Batch stream %s initialized", stream_name);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_batch_publish_to_stream(bytebeam_batch_handle_t handle, char *payload)
+{
+    if (handle == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    return bytebeam_batch_publish_buffer_to_stream(handle, payload, strlen(payload));
+}
+
+static bytebeam_err_t batch_enqueue(struct bytebeam_batch *handle, const void *payload, size_t payload_len)
+{
+    bytebeam_err_t err_code = bytebeam_queue_push(&handle->queue, payload, payload_len);
+
+    if (err_code != BB_SUCCESS)
+    {
+        BB_LOGE(TAG, "Batch queue of %s stream is full, record dropped (%u dropped so far)",
+                handle->stream_name, (unsigned)atomic_load(&handle->queue.dropped));
+        return BB_FAILURE;
+    }
+
+    // one wake up drains every record queued so far
+    bytebeam_mqtt_thread_wake();
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_batch_publish_buffer_to_stream(bytebeam_batch_handle_t handle, const void *payload, size_t payload_len)
+{
+    if (handle == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (!atomic_load(&handle->active))
+    {
+        BB_LOGE(TAG, "Batch stream is not initialized");
+        return BB_FAILURE;
+    }
+
+    if (handle->fields != NULL)
+    {
+        BB_LOGE(TAG, "Batch stream %s has a schema, push records instead", handle->stream_name);
+        return BB_FAILURE;
+    }
+
+    return batch_enqueue(handle, payload, payload_len);
+}
+
+static size_t batch_record_max_len(bytebeam_encoding_t encoding, const bytebeam_field_t *fields, int num_fields)
+{
+    // the timestamp and sequence keys come first in every record
+    size_t keys_len = strlen("timestamp") + strlen("sequence");
+    int num_items = num_fields + 2;
+
+    for (int loop_var = 0; loop_var < num_fields; loop_var++)
+    {
+        keys_len += strlen(fields[loop_var].name);
+    }
+
+    if (encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        // map head plus a head for each key and an item for each value
+        return BATCH_CBOR_ITEM_MAX_LEN + keys_len + num_items * (2 * BATCH_CBOR_ITEM_MAX_LEN);
+    }
+    else
+    {
+        // braces, the commas, and the quotes and colon around each key
+        return 2 + (num_items - 1) + keys_len + num_items * (3 + BATCH_JSON_VALUE_MAX_LEN);
+    }
+}
+
+static bool batch_field_is_valid(const bytebeam_field_t *field)
+{
+    if (field->name == NULL || field->name[0] == '\0' || field->type > BYTEBEAM_FIELD_TYPE_BOOL)
+    {
+        return false;
+    }
+
+    if (!strcmp(field->name, "timestamp") || !strcmp(field->name, "sequence"))
+    {
+        return false;
+    }
+
+    // the keys are written without escaping
+    for (const char *cursor = field->name; *cursor != '\0'; cursor++)
+    {
+        if ((unsigned char)*cursor < 0x20 || *cursor == '"' || *cursor == '\\')
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bytebeam_err_t bytebeam_batch_register_schema(bytebeam_batch_handle_t handle, const bytebeam_field_t *fields, int num_fields)
+{
+    if (handle == NULL || fields == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (!atomic_load(&handle->active) || handle->fields != NULL || bytebeam_queue_count(&handle->queue) != 0)
+    {
+        BB_LOGE(TAG, "Schema must be registered once, before any record is published");
+        return BB_FAILURE;
+    }
+
+    if (num_fields <= 0 || num_fields > BYTEBEAM_BATCH_MAX_FIELDS)
+    {
+        BB_LOGE(TAG, "Schema must have 1 to %d fields", BYTEBEAM_BATCH_MAX_FIELDS);
+        return BB_FAILURE;
+    }
+
+    size_t names_len = 0;
+
+    for (int loop_var = 0; loop_var < num_fields; loop_var++)
+    {
+        if (!batch_field_is_valid(&fields[loop_var]))
+        {
+            BB_LOGE(TAG, "Schema field %d of %s stream is invalid", loop_var, handle->stream_name);
+            return BB_FAILURE;
+        }
+
+        names_len += strlen(fields[loop_var].name) + 1;
+    }
+
+    size_t raw_len = offsetof(batch_raw_record_t, values) + num_fields * sizeof(bytebeam_field_value_t);
+    size_t record_max_len = batch_record_max_len(handle->policy.encoding, fields, num_fields);
+
+    if (raw_len > handle->queue.record_size || record_max_len + 1 + BATCH_WRITER_TRAILER_LEN > handle->policy.max_bytes)
+    {
+        BB_LOGE(TAG, "Schema records of %s stream do not fit the batch element size or policy", handle->stream_name);
+        return BB_FAILURE;
+    }
+
+    // the fields and their names share one allocation, made once for the life of the stream
+    bytebeam_field_t *schema = malloc(num_fields * sizeof(bytebeam_field_t) + names_len);
+
+    if (schema == NULL)
+    {
+        BB_LOGE(TAG, "Schema allocation failed for %s stream", handle->stream_name);
+        return BB_FAILURE;
+    }
+
+    char *names = (char *)&schema[num_fields];
+
+    for (int loop_var = 0; loop_var < num_fields; loop_var++)
+    {
+        strcpy(names, fields[loop_var].name);
+
+        schema[loop_var].name = names;
+        schema[loop_var].type = fields[loop_var].type;
+
+        names += strlen(names) + 1;
+    }
+
+    handle->num_fields = num_fields;
+    handle->record_max_len = record_max_len;
+    handle->fields = schema;
+
+    BB_LOGI(TAG, "Schema of %d fields registered for %s stream", num_fields, handle->stream_name);
+
+    return BB_SUCCESS;
+}
+
+static double batch_field_to_double(bytebeam_field_type_t type, const bytebeam_field_value_t *value)
+{
+    switch (type)
+    {
+        case BYTEBEAM_FIELD_TYPE_INT    :
+        case BYTEBEAM_FIELD_TYPE_INT64  : return (double)value->int_value;
+        case BYTEBEAM_FIELD_TYPE_FLOAT  : return value->float_value;
+        case BYTEBEAM_FIELD_TYPE_DOUBLE : return value->double_value;
+        case BYTEBEAM_FIELD_TYPE_BOOL   : return value->bool_value ? 1 : 0;
+    }
+
+    return 0;
+}
+
+static bool batch_filter_record(struct bytebeam_batch *batch, const bytebeam_field_value_t *values)
+{
+    double samples[BYTEBEAM_BATCH_MAX_FIELDS];
+    long long now_ms = bytebeam_hal_get_uptime_ms();
+    bool wanted = false;
+
+    if (batch->num_filters == 0)
+    {
+        return true;
+    }
+
+    for (int loop_var = 0; loop_var < batch->num_fields; loop_var++)
+    {
+        samples[loop_var] = batch_field_to_double(batch->fields[loop_var].type, &values[loop_var]);
+    }
+
+    taskENTER_CRITICAL(&batch_filter_lock);
+
+    batch_field_filter_t *filters = batch->filters;
+
+    // every filter sees the sample, so the decimation counts stay true whatever the other fields decide
+    for (int loop_var = 0; filters != NULL && loop_var < batch->num_fields; loop_var++)
+    {
+        if (filters[loop_var].enabled && bytebeam_filter_wants(&filters[loop_var].filter, &filters[loop_var].state, samples[loop_var], now_ms))
+        {
+            wanted = true;
+        }
+    }
+
+    // the reported values become the reference of every filter, the record carries all of them
+    for (int loop_var = 0; wanted && loop_var < batch->num_fields; loop_var++)
+    {
+        if (filters[loop_var].enabled)
+        {
+            bytebeam_filter_reported(&filters[loop_var].state, samples[loop_var], now_ms);
+        }
+    }
+
+    // a filter removed meanwhile may leave none, then every record goes
+    if (batch->num_filters == 0)
+    {
+        wanted = true;
+    }
+
+    taskEXIT_CRITICAL(&batch_filter_lock);
+
+    if (!wanted)
+    {
+        atomic_fetch_add(&batch->filtered, 1);
+    }
+
+    return wanted;
+}
+
+bytebeam_err_t bytebeam_batch_set_field_filter(bytebeam_batch_handle_t handle, const char *field_name, const bytebeam_field_filter_t *filter)
+{
+    if (handle == NULL || field_name == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (!atomic_load(&handle->active) || handle->fields == NULL)
+    {
+        BB_LOGE(TAG, "Batch stream has no schema");
+        return BB_FAILURE;
+    }
+
+    if (filter != NULL && bytebeam_filter_validate(filter) != BB_SUCCESS)
+    {
+        BB_LOGE(TAG, "Filter of %s field is invalid", field_name);
+        return BB_FAILURE;
+    }
+
+    int field_index = -1;
+
+    for (int loop_var = 0; loop_var < handle->num_fields; loop_var++)
+    {
+        if (!strcmp(handle->fields[loop_var].name, field_name))
+        {
+            field_index = loop_var;
+            break;
+        }
+    }
+
+    if (field_index < 0)
+    {
+        BB_LOGE(TAG, "Field %s is not in the %s stream schema", field_name, handle->stream_name);
+        return BB_FAILURE;
+    }
+
+    batch_field_filter_t *filters = NULL;
+
+    // the filters are allocated with the first one and kept for the life of the stream, like the schema
+    if (handle->filters == NULL && filter != NULL)
+    {
+        filters = calloc(handle->num_fields, sizeof(batch_field_filter_t));
+
+        if (filters == NULL)
+        {
+            BB_LOGE(TAG, "Filter allocation failed for %s stream", handle->stream_name);
+            return BB_FAILURE;
+        }
+    }
+
+    taskENTER_CRITICAL(&batch_filter_lock);
+
+    if (handle->filters == NULL)
+    {
+        handle->filters = filters;
+        filters = NULL;
+    }
+
+    if (handle->filters != NULL)
+    {
+        batch_field_filter_t *field_filter = &handle->filters[field_index];
+
+        if (field_filter->enabled)
+        {
+            handle->num_filters--;
+        }
+
+        field_filter->enabled = (filter != NULL);
+
+        if (filter != NULL)
+        {
+            field_filter->filter = *filter;
+            bytebeam_filter_reset(&field_filter->state);
+            handle->num_filters++;
+        }
+    }
+
+    taskEXIT_CRITICAL(&batch_filter_lock);
+
+    // another task set the first filter meanwhile
+    free(filters);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_record_push_values(bytebeam_batch_handle_t handle, const bytebeam_field_value_t *values)
+{
+    batch_raw_record_t raw;
+
+    if (handle == NULL || values == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (!atomic_load(&handle->active) || handle->fields == NULL)
+    {
+        BB_LOGE(TAG, "Batch stream has no schema");
+        return BB_FAILURE;
+    }
+
+    // only the monotonic clock is read here, a record pushed before the wall clock is set still gets its time
+    raw.uptime_us = bytebeam_hal_get_uptime_us();
+
+    // a record nobody wants reported is dropped before it costs a sequence number, a queue slot or any encoding
+    if (!batch_filter_record(handle, values))
+    {
+        return BB_SUCCESS;
+    }
+
+    raw.sequence = bytebeam_batch_next_sequence(handle);
+    memcpy(raw.values, values, handle->num_fields * sizeof(bytebeam_field_value_t));
+
+    // only the values in use are queued, they are encoded once the record reaches the batch buffer
+    return batch_enqueue(handle, &raw, offsetof(batch_raw_record_t, values) + handle->num_fields * sizeof(bytebeam_field_value_t));
+}
+
+bytebeam_err_t bytebeam_stream_record_push(bytebeam_batch_handle_t handle, ...)
+{
+    bytebeam_field_value_t values[BYTEBEAM_BATCH_MAX_FIELDS];
+
+    if (handle == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (!atomic_load(&handle->active) || handle->fields == NULL)
+    {
+        BB_LOGE(TAG, "Batch stream has no schema");
+        return BB_FAILURE;
+    }
+
+    va_list args;
+    va_start(args, handle);
+
+    for (int loop_var = 0; loop_var < handle->num_fields; loop_var++)
+    {
+        switch (handle->fields[loop_var].type)
+        {
+            case BYTEBEAM_FIELD_TYPE_INT    : values[loop_var].int_value = va_arg(args, int);                break;
+            case BYTEBEAM_FIELD_TYPE_INT64  : values[loop_var].int_value = va_arg(args, int64_t);            break;
+            case BYTEBEAM_FIELD_TYPE_FLOAT  : values[loop_var].float_value = (float)va_arg(args, double);    break;
+            case BYTEBEAM_FIELD_TYPE_DOUBLE : values[loop_var].double_value = va_arg(args, double);          break;
+            case BYTEBEAM_FIELD_TYPE_BOOL   : values[loop_var].bool_value = (va_arg(args, int) != 0);        break;
+        }
+    }
+
+    va_end(args);
+
+    return bytebeam_stream_record_push_values(handle, values);
+}
+
+bytebeam_err_t bytebeam_batch_flush(bytebeam_batch_handle_t handle)
+{
+    if (handle != NULL)
+    {
+        atomic_store(&handle->flush_requested, true);
+    }
+    else
+    {
+        for (int loop_var = 0; loop_var < CONFIG_MQTT_BATCH_MAX_STREAMS; loop_var++)
+        {
+            atomic_store(&batch_streams[loop_var].flush_requested, true);
+        }
+    }
+
+    bytebeam_mqtt_thread_wake();
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_batch_register_event_handler(bytebeam_batch_handle_t handle, bytebeam_batch_event_handler_t event_handler)
+{
+    if (handle == NULL || event_handler == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    handle->event_handler = event_handler;
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_batch_register_spill_handler(bytebeam_batch_handle_t handle, bytebeam_batch_spill_handler_t spill_handler)
+{
+    if (handle == NULL || spill_handler == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    handle->spill_handler = spill_handler;
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_batch_get_stats(bytebeam_batch_handle_t handle, bytebeam_batch_stats_t *stats)
+{
+    if (handle == NULL || stats == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    stats->retries = atomic_load(&handle->retries);
+    stats->backoff_ms = atomic_load(&handle->backoff_ms);
+    stats->spilled = atomic_load(&handle->spilled);
+    stats->dropped = atomic_load(&handle->dropped);
+    stats->filtered = atomic_load(&handle->filtered);
+
+    return BB_SUCCESS;
+}
+
+uint64_t bytebeam_batch_next_sequence(bytebeam_batch_handle_t handle)
+{
+    if (handle == NULL)
+    {
+        return 0;
+    }
+
+    return atomic_fetch_add(&handle->sequence, 1) + 1;
+}
+
+static void batch_notify(struct bytebeam_batch *batch, bytebeam_batch_event_t event)
+{
+    if (batch->event_handler != NULL)
+    {
+        batch->event_handler(batch, event);
+    }
+}
+
+static bytebeam_batch_buffer_t* batch_filling_buffer(struct bytebeam_batch *batch)
+{
+    // the buffer right after the in flight ones is the one being filled, unless every buffer is taken
+    if (batch->sent + batch->in_flight == CONFIG_MQTT_BATCH_BUFFER_COUNT)
+    {
+        return NULL;
+    }
+
+    int fill_index = (batch->send_index + batch->in_flight) % CONFIG_MQTT_BATCH_BUFFER_COUNT;
+
+    return &batch->buffers[fill_index];
+}
+
+static void batch_seal(struct bytebeam_batch *batch, bytebeam_batch_buffer_t *buffer)
+{
+    buffer->state = BATCH_BUFFER_IN_FLIGHT;
+    buffer->attempts = 0;
+    buffer->sealed_tick = xTaskGetTickCount();
+    buffer->retry_tick = buffer->sealed_tick;
+    atomic_store(&buffer->result, BATCH_PUBLISH_PENDING);
+    batch->in_flight++;
+
+    // records keep waiting in the queue until the transport hands a buffer back
+    if (batch->sent + batch->in_flight == CONFIG_MQTT_BATCH_BUFFER_COUNT && !batch->buffers_full)
+    {
+        BB_LOGW(TAG, "Every %s batch buffer is in flight", batch->stream_name);
+
+        batch->buffers_full = true;
+        batch_notify(batch, BYTEBEAM_BATCH_EVENT_BUFFERS_FULL);
+    }
+}
+
+static void batch_publish_done(int msg_id, bytebeam_publish_status_t status, uint32_t latency_ms, void *user_data)
+{
+    bytebeam_batch_buffer_t *buffer = user_data;
+
+    // called from the MQTT task or from within the publish, the buffer is released by the MQTT Data Publish Thread
+    atomic_store(&buffer->result, (int)status);
+    bytebeam_mqtt_thread_wake();
+}
+
+static uint32_t batch_backoff_ms(struct bytebeam_batch *batch, uint32_t attempts)
+{
+    uint32_t shift = (attempts - 1 < BATCH_RETRY_MAX_SHIFT) ? attempts - 1 : BATCH_RETRY_MAX_SHIFT;
+    uint64_t cap_ms = (uint64_t)batch->policy.retry_base_ms << shift;
+
+    if (cap_ms > batch->policy.retry_max_ms)
+    {
+        cap_ms = batch->policy.retry_max_ms;
+    }
+
+    // full jitter, every device that lost the broker at once picks its own delay below the cap
+    return (uint32_t)(bytebeam_hal_random() % (cap_ms + 1));
+}
+
+static bool batch_backing_off(bytebeam_batch_buffer_t *buffer, TickType_t now)
+{
+    return atomic_load(&buffer->result) == BATCH_PUBLISH_BACKOFF && (int32_t)(buffer->retry_tick - now) > 0;
+}
+
+static bool batch_retry_later(struct bytebeam_batch *batch, bytebeam_batch_buffer_t *buffer, bytebeam_err_t err_code)
+{
+    // while the producers are paused the publish did not fail, it waits until the flow state is checked again,
+    // one yielding to the control lane only waits for the control publishes to be acknowledged
+    uint32_t delay_ms = bytebeam_flow_is_paused() ? BYTEBEAM_FLOW_RECHECK_MS : BYTEBEAM_FLOW_YIELD_MS;
+
+    if (err_code != BB_WOULD_BLOCK)
+    {
+        buffer->attempts++;
+        delay_ms = batch_backoff_ms(batch, buffer->attempts);
+    }
+
+    TickType_t now = xTaskGetTickCount();
+
+    if ((batch->policy.retry_max_attempts != 0 && buffer->attempts >= batch->policy.retry_max_attempts) ||
+        (batch->policy.retry_max_age_ms != 0 && now - buffer->sealed_tick >= pdMS_TO_TICKS(batch->policy.retry_max_age_ms)))
+    {
+        return false;
+    }
+
+    atomic_fetch_add(&batch->backoff_ms, delay_ms);
+
+    // every buffer keeps its own deadline so the jitter of one retry does not move another
+    buffer->retry_tick = now + pdMS_TO_TICKS(delay_ms);
+
+    return true;
+}
+
+static void batch_spill(struct bytebeam_batch *batch, bytebeam_batch_buffer_t *buffer)
+{
+    size_t batch_len = 0;
+    const char *batch_data = bytebeam_batch_writer_finish(&buffer->writer, &batch_len);
+    bool spilled = false;
+
+    BB_LOGW(TAG, "%s batch of %d records ran out of retries after %u attempts", batch->stream_name, buffer->writer.count, (unsigned)buffer->attempts);
+
+    if (batch->spill_handler != NULL)
+    {
+        spilled = batch->spill_handler(batch, batch_data, batch_len, batch->policy.encoding);
+    }
+    else
+    {
+#if CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED
+        // the store drain publishes it once the client is back online
+        spilled = (bytebeam_store_write(batch->stream_name, batch->policy.encoding, batch_data, batch_len) == BB_SUCCESS);
+#endif
+    }
+
+    atomic_store(&buffer->result, BATCH_PUBLISH_ABANDONED);
+
+    if (spilled)
+    {
+        atomic_fetch_add(&batch->spilled, 1);
+    }
+    else
+    {
+        BB_LOGE(TAG, "Dropping %s batch of %d records", batch->stream_name, buffer->writer.count);
+
+        atomic_fetch_add(&batch->dropped, 1);
+        batch_notify(batch, BYTEBEAM_BATCH_EVENT_BATCH_DROPPED);
+    }
+}
+
+static bool batch_publish(struct bytebeam_batch *batch, bytebeam_batch_buffer_t *buffer)
+{
+    size_t batch_len = 0;
+    const char *batch_data = bytebeam_batch_writer_finish(&buffer->writer, &batch_len);
+
+    BB_LOGI(TAG, "Trying to publish %s batch of %d records (%d bytes)", batch->stream_name, buffer->writer.count, (int)batch_len);
+
+    if (buffer->attempts > 0)
+    {
+        atomic_fetch_add(&batch->retries, 1);
+    }
+
+    // the publish may complete before the call returns
+    atomic_store(&buffer->result, BATCH_PUBLISH_PENDING);
+
+    bytebeam_err_t err_code;
+
+    if (batch->stream != NULL)
+    {
+        err_code = bytebeam_stream_publish_batch(batch->stream, batch->policy.encoding, batch_data, batch_len, batch_publish_done, buffer);
+    }
+    else
+    {
+        err_code = bytebeam_publish_batch_to_stream(batch->client, batch->stream_name, batch->policy.encoding, batch_data, batch_len);
+
+        if (err_code == BB_SUCCESS)
+        {
+            atomic_store(&buffer->result, BYTEBEAM_PUBLISH_SENT);
+        }
+    }
+
+    if (err_code != BB_SUCCESS)
+    {
+        // a failed publish never completes, so its result is ours to set
+        if (batch_retry_later(batch, buffer, err_code))
+        {
+            atomic_store(&buffer->result, BATCH_PUBLISH_BACKOFF);
+        }
+        else
+        {
+            batch_spill(batch, buffer);
+        }
+
+        return false;
+    }
+
+    return true;
+}
+
+static void batch_release(struct bytebeam_batch *batch)
+{
+    // sent buffers are released in ring order once their publish completes
+    while (batch->sent > 0)
+    {
+        bytebeam_batch_buffer_t *buffer = &batch->buffers[batch->ack_index];
+        int result = atomic_load(&buffer->result);
+
+        if (result == BATCH_PUBLISH_PENDING)
+        {
+            return;
+        }
+
+        // a missing acknowledgement counts as a failed attempt
+        if (result == BYTEBEAM_PUBLISH_TIMED_OUT)
+        {
+            BB_LOGW(TAG, "%s batch was not acknowledged", batch->stream_name);
+
+            if (batch_retry_later(batch, buffer, BB_FAILURE))
+            {
+                atomic_store(&buffer->result, BATCH_PUBLISH_BACKOFF);
+            }
+            else
+            {
+                batch_spill(batch, buffer);
+            }
+
+            continue;
+        }
+
+        if (result == BATCH_PUBLISH_BACKOFF)
+        {
+            if (batch_backing_off(buffer, xTaskGetTickCount()))
+            {
+                return;
+            }
+
+            BB_LOGW(TAG, "Publishing %s batch again", batch->stream_name);
+
+            // the buffer stays at the head of the ring until a publish of it completes or it runs out of retries
+            if (!batch_publish(batch, buffer) && atomic_load(&buffer->result) != BATCH_PUBLISH_ABANDONED)
+            {
+                return;
+            }
+
+            continue;
+        }
+
+        bytebeam_batch_writer_reset(&buffer->writer);
+        buffer->state = BATCH_BUFFER_FREE;
+
+        batch->ack_index = (batch->ack_index + 1) % CONFIG_MQTT_BATCH_BUFFER_COUNT;
+        batch->sent--;
+
+        if (batch->buffers_full)
+        {
+            batch->buffers_full = false;
+            batch_notify(batch, BYTEBEAM_BATCH_EVENT_BUFFERS_AVAILABLE);
+        }
+    }
+}
+
+static void batch_transmit(struct bytebeam_batch *batch)
+{
+    while (batch->in_flight > 0)
+    {
+        bytebeam_batch_buffer_t *buffer = &batch->buffers[batch->send_index];
+
+        if (batch_backing_off(buffer, xTaskGetTickCount()))
+        {
+            return;
+        }
+
+        // keep filling the other buffers meanwhile, batches are published in order so stop here
+        if (!batch_publish(batch, buffer) && atomic_load(&buffer->result) != BATCH_PUBLISH_ABANDONED)
+        {
+            return;
+        }
+
+        // a batch that ran out of retries is released in ring order with the sent ones
+
+        buffer->state = BATCH_BUFFER_SENT;
+
+        batch->send_index = (batch->send_index + 1) % CONFIG_MQTT_BATCH_BUFFER_COUNT;
+        batch->in_flight--;
+        batch->sent++;
+    }
+
+    // a publish that completed right away frees its buffer now
+    batch_release(batch);
+}
+
+static TickType_t batch_wait_ticks(struct bytebeam_batch *batch, TickType_t now)
+{
+    TickType_t wait_ticks = portMAX_DELAY;
+    bytebeam_batch_buffer_t *buffer = batch_filling_buffer(batch);
+
+    // linger timer of the filling buffer
+    if (buffer != NULL && buffer->writer.count > 0 && batch->policy.max_linger_ms != 0)
+    {
+        int32_t remaining = (int32_t)(batch->deadline - now);
+        wait_ticks = (remaining > 0) ? (TickType_t)remaining : 0;
+    }
+
+    // backoff timers of the sent and in flight buffers waiting to be published again
+    for (int loop_var = 0; loop_var < CONFIG_MQTT_BATCH_BUFFER_COUNT; loop_var++)
+    {
+        buffer = &batch->buffers[loop_var];
+
+        if (buffer->state == BATCH_BUFFER_FREE || atomic_load(&buffer->result) != BATCH_PUBLISH_BACKOFF)
+        {
+            continue;
+        }
+
+        int32_t remaining = (int32_t)(buffer->retry_tick - now);
+        TickType_t retry_ticks = (remaining > 0) ? (TickType_t)remaining : 0;
+
+        if (retry_ticks < wait_ticks)
+        {
+            wait_ticks = retry_ticks;
+        }
+    }
+
+    return wait_ticks;
+}
+
+static bytebeam_err_t batch_writer_append_record(bytebeam_batch_writer_t *writer, struct bytebeam_batch *batch, const batch_raw_record_t *raw)
+{
+    size_t separator_len = (writer->count > 0 && writer->encoding == BYTEBEAM_ENCODING_JSON) ? 1 : 0;
+    size_t available = writer->capacity - writer->len - BATCH_WRITER_TRAILER_LEN;
+
+    if (separator_len >= available)
+    {
+        return BB_FAILURE;
+    }
+
+    char *cursor = writer->buf + writer->len + separator_len;
+    size_t record_len = 0;
+    bytebeam_encoder_t encoder;
+
+    // the json writer ends with a NULL character, the trailer room takes it, a cbor record gets no such byte
+    size_t terminator_len = (writer->encoding == BYTEBEAM_ENCODING_JSON) ? 1 : 0;
+
+    bytebeam_encoder_init(&encoder, writer->encoding, cursor, available - separator_len + terminator_len);
+    bytebeam_encoder_begin_map(&encoder, batch->num_fields + 2);
+    bytebeam_encoder_put_key(&encoder, "timestamp");
+    bytebeam_encoder_put_uint(&encoder, bytebeam_time_to_epoch_millis(raw->uptime_us));
+    bytebeam_encoder_put_key(&encoder, "sequence");
+    bytebeam_encoder_put_uint(&encoder, raw->sequence);
+
+    for (int loop_var = 0; loop_var < batch->num_fields; loop_var++)
+    {
+        const bytebeam_field_value_t *value = &raw->values[loop_var];
+
+        bytebeam_encoder_put_key(&encoder, batch->fields[loop_var].name);
+
+        switch (batch->fields[loop_var].type)
+        {
+            case BYTEBEAM_FIELD_TYPE_INT    :
+            case BYTEBEAM_FIELD_TYPE_INT64  : bytebeam_encoder_put_int(&encoder, value->int_value);         break;
+            case BYTEBEAM_FIELD_TYPE_FLOAT  : bytebeam_encoder_put_float(&encoder, value->float_value);     break;
+            case BYTEBEAM_FIELD_TYPE_DOUBLE : bytebeam_encoder_put_double(&encoder, value->double_value);   break;
+            case BYTEBEAM_FIELD_TYPE_BOOL   : bytebeam_encoder_put_bool(&encoder, value->bool_value);       break;
+        }
+    }
+
+    bytebeam_encoder_end(&encoder);
+
+    if (bytebeam_encoder_finish(&encoder, &record_len) != BB_SUCCESS)
+    {
+        return BB_FAILURE;
+    }
+
+    if (separator_len != 0)
+    {
+        cursor[-1] = ',';
+    }
+
+    cursor[record_len] = '\0';
+
+    writer->len = writer->len + separator_len + record_len;
+    writer->count++;
+
+    return BB_SUCCESS;
+}
+
+static void batch_service(struct bytebeam_batch *batch)
+{
+    bytebeam_queue_item_t record;
+    bytebeam_batch_buffer_t *buffer = NULL;
+
+    // hand back whatever the transport can take before filling
+    batch_transmit(batch);
+
+    // the records of a schema stay queued until the wall clock is set, their time can only be encoded after it
+    bool hold = (batch->fields != NULL && !bytebeam_time_is_synced());
+
+    while (!hold && (buffer = batch_filling_buffer(batch)) != NULL && bytebeam_queue_pop_begin(&batch->queue, &record))
+    {
+        /*  A buffer is sealed as soon as it can no longer hold the largest record, so the append below can not fail
+         *  as long as the queue enforces the record size.
+         */
+        if (batch->fields != NULL)
+        {
+            batch_raw_record_t raw;
+
+            memcpy(&raw, record.data, (record.len < sizeof(raw)) ? record.len : sizeof(raw));
+            bytebeam_queue_pop_end(&batch->queue, &record);
+
+            if (batch_writer_append_record(&buffer->writer, batch, &raw) != BB_SUCCESS)
+            {
+                BB_LOGE(TAG, "Failed to encode %s record %llu", batch->stream_name, (unsigned long long)raw.sequence);
+                continue;
+            }
+        }
+        else
+        {
+            bytebeam_batch_writer_append(&buffer->writer, record.data, record.len);
+            bytebeam_queue_pop_end(&batch->queue, &record);
+        }
+
+        BB_LOGD(TAG, "%s batch size now : %d", batch->stream_name, buffer->writer.count);
+
+        // the linger clock starts with the first record of the batch
+        if (buffer->writer.count == 1)
+        {
+            buffer->state = BATCH_BUFFER_FILLING;
+            batch->deadline = xTaskGetTickCount() + pdMS_TO_TICKS(batch->policy.max_linger_ms);
+        }
+
+        if (buffer->writer.count >= batch->policy.max_records ||
+            bytebeam_batch_writer_available(&buffer->writer) < batch->record_max_len)
+        {
+            batch_seal(batch, buffer);
+            batch_transmit(batch);
+        }
+    }
+
+    bool flush_requested = atomic_exchange(&batch->flush_requested, false);
+    buffer = batch_filling_buffer(batch);
+
+    if (buffer != NULL && buffer->writer.count > 0)
+    {
+        if (flush_requested)
+        {
+            BB_LOGD(TAG, "Flushing %s batch on request", batch->stream_name);
+
+            batch_seal(batch, buffer);
+            batch_transmit(batch);
+        }
+        else if (batch->policy.max_linger_ms != 0 && (int32_t)(batch->deadline - xTaskGetTickCount()) <= 0)
+        {
+            BB_LOGD(TAG, "Flushing %s batch on linger timeout", batch->stream_name);
+
+            batch_seal(batch, buffer);
+            batch_transmit(batch);
+        }
+    }
+}
+
+void bytebeam_mqtt_thread_entry(void *pv)
+{
+    TickType_t wait_ticks = portMAX_DELAY;
+
+    batch_task_handle = xTaskGetCurrentTaskHandle();
+
+    while (1)
+    {
+        // the wait timeout doubles as the linger, retry, acknowledgement and drain timer
+        ulTaskNotifyTake(pdTRUE, wait_ticks);
+
+        wait_ticks = portMAX_DELAY;
+
+        // the offset follows the wall clock before anything is encoded, until it is set it is checked periodically
+        if (!bytebeam_time_sync())
+        {
+            wait_ticks = pdMS_TO_TICKS(BYTEBEAM_TIME_RECHECK_MS);
+        }
+
+        for (int loop_var = 0; loop_var < CONFIG_MQTT_BATCH_MAX_STREAMS; loop_var++)
+        {
+            struct bytebeam_batch *batch = &batch_streams[loop_var];
+
+            if (!atomic_load(&batch->active))
+            {
+                continue;
+            }
+
+            batch_service(batch);
+
+            TickType_t batch_wait = batch_wait_ticks(batch, xTaskGetTickCount());
+
+            if (batch_wait < wait_ticks)
+            {
+                wait_ticks = batch_wait;
+            }
+        }
+
+        // with the producers paused and nothing being acknowledged, only a periodic check can resume them
+        bytebeam_flow_poll();
+
+        if (bytebeam_flow_is_paused() && wait_ticks > pdMS_TO_TICKS(BYTEBEAM_FLOW_RECHECK_MS))
+        {
+            wait_ticks = pdMS_TO_TICKS(BYTEBEAM_FLOW_RECHECK_MS);
+        }
+
+        uint32_t next_expiry_ms = UINT32_MAX;
+
+        // publishes left without an acknowledgement time out here, their callbacks run on this thread
+        bytebeam_inflight_expire(&next_expiry_ms);
+
+        if (next_expiry_ms != UINT32_MAX && pdMS_TO_TICKS(next_expiry_ms) < wait_ticks)
+        {
+            wait_ticks = pdMS_TO_TICKS(next_expiry_ms);
+        }
+
+        uint32_t next_coalesced_ms = UINT32_MAX;
+
+        // publishes held back by a rate limit go out once their stream has the tokens
+        bytebeam_stream_rate_poll(&next_coalesced_ms);
+
+        if (next_coalesced_ms != UINT32_MAX && pdMS_TO_TICKS(next_coalesced_ms) < wait_ticks)
+        {
+            wait_ticks = pdMS_TO_TICKS(next_coalesced_ms);
+        }
+
+        uint32_t next_shadow_ms = UINT32_MAX;
+
+        // the device shadow is pushed from here on its interval, on request and on every connect
+        bytebeam_shadow_poll(&next_shadow_ms);
+
+        if (next_shadow_ms != UINT32_MAX && pdMS_TO_TICKS(next_shadow_ms) < wait_ticks)
+        {
+            wait_ticks = pdMS_TO_TICKS(next_shadow_ms);
+        }
+
+#if CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED
+        uint32_t next_drain_ms = UINT32_MAX;
+
+        // publishes stored while offline are drained at the configured rate alongside the live batches
+        bytebeam_store_drain(&next_drain_ms);
+
+        if (next_drain_ms != UINT32_MAX && pdMS_TO_TICKS(next_drain_ms) < wait_ticks)
+        {
+            wait_ticks = pdMS_TO_TICKS(next_drain_ms);
+        }
+#endif
+    }
+}
@@ -0,0 +1,221 @@
+#include "bytebeam_cbor.h"
+
+/* CBOR major types, already shifted into the initial byte */
+#define CBOR_MAJOR_UINT     0x00
+#define CBOR_MAJOR_NEGINT   0x20
+#define CBOR_MAJOR_TEXT     0x60
+#define CBOR_MAJOR_ARRAY    0x80
+#define CBOR_MAJOR_MAP      0xA0
+
+#define CBOR_FALSE          0xF4
+#define CBOR_TRUE           0xF5
+#define CBOR_NULL           0xF6
+#define CBOR_FLOAT32        0xFA
+#define CBOR_FLOAT64        0xFB
+#define CBOR_INDEFINITE     0x1F
+#define CBOR_BREAK          0xFF
+
+static bool cbor_reserve(bytebeam_cbor_writer_t *writer, size_t len)
+{
+    if (writer->overflow || writer->capacity - writer->len < len)
+    {
+        writer->overflow = true;
+        return false;
+    }
+
+    return true;
+}
+
+static void cbor_put_bytes(bytebeam_cbor_writer_t *writer, const void *data, size_t len)
+{
+    if (!cbor_reserve(writer, len))
+    {
+        return;
+    }
+
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+static void cbor_put_head(bytebeam_cbor_writer_t *writer, uint8_t major, uint64_t value)
+{
+    uint8_t head[9];
+    size_t head_len = 0;
+
+    // the argument is stored in the shortest of the inline, 1, 2, 4 or 8 byte forms
+    if (value < 24)
+    {
+        head[head_len++] = major | (uint8_t)value;
+    }
+    else if (value <= UINT8_MAX)
+    {
+        head[head_len++] = major | 24;
+        head[head_len++] = (uint8_t)value;
+    }
+    else if (value <= UINT16_MAX)
+    {
+        head[head_len++] = major | 25;
+        head[head_len++] = (uint8_t)(value >> 8);
+        head[head_len++] = (uint8_t)value;
+    }
+    else if (value <= UINT32_MAX)
+    {
+        head[head_len++] = major | 26;
+
+        for (int shift = 24; shift >= 0; shift -= 8)
+        {
+            head[head_len++] = (uint8_t)(value >> shift);
+        }
+    }
+    else
+    {
+        head[head_len++] = major | 27;
+
+        for (int shift = 56; shift >= 0; shift -= 8)
+        {
+            head[head_len++] = (uint8_t)(value >> shift);
+        }
+    }
+
+    cbor_put_bytes(writer, head, head_len);
+}
+
+void bytebeam_cbor_writer_init(bytebeam_cbor_writer_t *writer, void *buf, size_t capacity)
+{
+    writer->buf = buf;
+    writer->capacity = (buf != NULL) ? capacity : 0;
+    writer->len = 0;
+    writer->overflow = false;
+}
+
+void bytebeam_cbor_begin_array(bytebeam_cbor_writer_t *writer, size_t count)
+{
+    if (count == BYTEBEAM_CBOR_INDEFINITE)
+    {
+        uint8_t head = CBOR_MAJOR_ARRAY | CBOR_INDEFINITE;
+        cbor_put_bytes(writer, &head, 1);
+    }
+    else
+    {
+        cbor_put_head(writer, CBOR_MAJOR_ARRAY, count);
+    }
+}
+
+void bytebeam_cbor_begin_map(bytebeam_cbor_writer_t *writer, size_t count)
+{
+    if (count == BYTEBEAM_CBOR_INDEFINITE)
+    {
+        uint8_t head = CBOR_MAJOR_MAP | CBOR_INDEFINITE;
+        cbor_put_bytes(writer, &head, 1);
+    }
+    else
+    {
+        cbor_put_head(writer, CBOR_MAJOR_MAP, count);
+    }
+}
+
+void bytebeam_cbor_end(bytebeam_cbor_writer_t *writer)
+{
+    uint8_t head = CBOR_BREAK;
+    cbor_put_bytes(writer, &head, 1);
+}
+
+void bytebeam_cbor_put_uint(bytebeam_cbor_writer_t *writer, uint64_t value)
+{
+    cbor_put_head(writer, CBOR_MAJOR_UINT, value);
+}
+
+void bytebeam_cbor_put_int(bytebeam_cbor_writer_t *writer, int64_t value)
+{
+    if (value >= 0)
+    {
+        cbor_put_head(writer, CBOR_MAJOR_UINT, (uint64_t)value);
+    }
+    else
+    {
+        // negative integers store -1 - value, which can not overflow
+        cbor_put_head(writer, CBOR_MAJOR_NEGINT, (uint64_t)(-(value + 1)));
+    }
+}
+
+void bytebeam_cbor_put_double(bytebeam_cbor_writer_t *writer, double value)
+{
+    uint8_t item[9];
+    float single = (float)value;
+
+    // NaN never compares equal, it is encoded in single precision as well
+    if ((double)single == value || value != value)
+    {
+        uint32_t bits = 0;
+        memcpy(&bits, &single, sizeof(bits));
+
+        item[0] = CBOR_FLOAT32;
+
+        for (int loop_var = 0; loop_var < 4; loop_var++)
+        {
+            item[1 + loop_var] = (uint8_t)(bits >> (24 - 8 * loop_var));
+        }
+
+        cbor_put_bytes(writer, item, 5);
+    }
+    else
+    {
+        uint64_t bits = 0;
+        memcpy(&bits, &value, sizeof(bits));
+
+        item[0] = CBOR_FLOAT64;
+
+        for (int loop_var = 0; loop_var < 8; loop_var++)
+        {
+            item[1 + loop_var] = (uint8_t)(bits >> (56 - 8 * loop_var));
+        }
+
+        cbor_put_bytes(writer, item, 9);
+    }
+}
+
+void bytebeam_cbor_put_bool(bytebeam_cbor_writer_t *writer, bool value)
+{
+    uint8_t head = value ? CBOR_TRUE : CBOR_FALSE;
+    cbor_put_bytes(writer, &head, 1);
+}
+
+void bytebeam_cbor_put_null(bytebeam_cbor_writer_t *writer)
+{
+    uint8_t head = CBOR_NULL;
+    cbor_put_bytes(writer, &head, 1);
+}
+
+void bytebeam_cbor_put_string(bytebeam_cbor_writer_t *writer, const char *str)
+{
+    if (str == NULL)
+    {
+        bytebeam_cbor_put_null(writer);
+        return;
+    }
+
+    bytebeam_cbor_put_string_len(writer, str, strlen(str));
+}
+
+void bytebeam_cbor_put_string_len(bytebeam_cbor_writer_t *writer, const char *str, size_t len)
+{
+    cbor_put_head(writer, CBOR_MAJOR_TEXT, len);
+    cbor_put_bytes(writer, str, len);
+}
+
+bytebeam_err_t bytebeam_cbor_writer_finish(bytebeam_cbor_writer_t *writer, size_t *len)
+{
+    if (writer == NULL || len == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (writer->overflow)
+    {
+        return BB_FAILURE;
+    }
+
+    *len = writer->len;
+
+    return BB_SUCCESS;
+}
@@ -4,6 +4,8 @@
 #include "bytebeam_action.h"
 #include "bytebeam_stream.h"
 #include "bytebeam_client.h"
+#include "bytebeam_store.h"
+#include "bytebeam_inflight.h"
 
 static cJSON *bytebeam_cert_json = NULL;
 static char *bytebeam_device_config_data = NULL;
@@ -325,6 +327,16 @@ static void bytebeam_sdk_cleanup(bytebeam_client_t *bytebeam_client)
     // clearing bytebeam connection status
     bytebeam_client->connection_status = 0;
 
+    // stop the device shadow pushes before its stream is closed
+    bytebeam_shadow_deinit();
+
+    // clearing bytebeam client topics and the open streams
+    bytebeam_action_topics_deinit(bytebeam_client);
+    bytebeam_stream_close_all(bytebeam_client);
+
+    // the publishes still waiting for their acknowledgement will not get one
+    bytebeam_inflight_reset();
+
     // clearing OTA action id
     ota_action_id = NULL;
 
@@ -377,6 +389,28 @@ bytebeam_err_t bytebeam_init(bytebeam_client_t *bytebeam_client)
         BB_LOGI(TAG, "Using provided device config data !");
     }
 
+    // build the action topics once, they are used on every connect and action status
+    ret_val = bytebeam_action_topics_init(bytebeam_client);
+
+    if (ret_val != 0) {
+        BB_LOGE(TAG, "Error in building the action topics");
+
+        /* This call will clear all the bytebeam sdk variables so to avoid any memory leaks further */
+        bytebeam_sdk_cleanup(bytebeam_client);
+        return BB_FAILURE;
+    }
+
+    // serialize the device shadow fields that never change after boot, every push only copies them
+    ret_val = bytebeam_shadow_init(bytebeam_client);
+
+    if (ret_val != 0) {
+        BB_LOGE(TAG, "Error in building the device shadow");
+
+        /* This call will clear all the bytebeam sdk variables so to avoid any memory leaks further */
+        bytebeam_sdk_cleanup(bytebeam_client);
+        return BB_FAILURE;
+    }
+
     // set the mqtt configurations
     set_mqtt_conf(&(bytebeam_client->device_cfg), &(bytebeam_client->mqtt_cfg));
 
@@ -399,6 +433,13 @@ bytebeam_err_t bytebeam_init(bytebeam_client_t *bytebeam_client)
         bytebeam_log_stream_set(CONFIG_BYTEBEAM_CLOUD_LOGGING_STREAM);
     #endif
 
+    #if CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED
+        // the client keeps working without the store, publishes made while offline are lost then
+        if (bytebeam_store_init(bytebeam_client) != BB_SUCCESS) {
+            BB_LOGE(TAG, "Error in initializing store and forward");
+        }
+    #endif
+
     BB_LOGI(TAG, "Bytebeam Client Initialized !!");
 
     return BB_SUCCESS;
@@ -460,10 +501,38 @@ bytebeam_err_t bytebeam_destroy(bytebeam_client_t *bytebeam_client)
         return BB_FAILURE;
     }
 
+    #if CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED
+        bytebeam_store_deinit();
+    #endif
+
     /* This call will clearing all the bytebeam sdk variables so to avoid any memory leaks further */
     bytebeam_sdk_cleanup(bytebeam_client);
 
     BB_LOGI(TAG, "Bytebeam Client destroyed !!");
 
     return BB_SUCCESS;
-}
\ No newline at end of file
+}
+
+bytebeam_err_t bytebeam_get_outbox_size(bytebeam_client_t *bytebeam_client, int *outbox_size)
+{
+    if (bytebeam_client == NULL || outbox_size == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (bytebeam_client->client == NULL)
+    {
+        return BB_FAILURE;
+    }
+
+    int ret_val = bytebeam_hal_mqtt_get_outbox_size(bytebeam_client->client);
+
+    if (ret_val < 0)
+    {
+        return BB_FAILURE;
+    }
+
+    *outbox_size = ret_val;
+
+    return BB_SUCCESS;
+}
@@ -0,0 +1,225 @@
+#include "freertos/FreeRTOS.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_compress.h"
+
+/*
+ *  Byte aligned LZSS with a 4 KB window. Matches are found through a hash of the next three bytes and a chain of
+ *  previous positions with the same hash, the chain stores distances so it fits in 16 bits per window byte. The
+ *  input itself serves as the window, so only the hash heads and the chain need a work area. The work area is
+ *  allocated once and owned by the task that compresses, which is the MQTT task.
+ */
+
+#define COMPRESS_WINDOW_SIZE   4096
+#define COMPRESS_WINDOW_MASK   (COMPRESS_WINDOW_SIZE - 1)
+#define COMPRESS_MIN_MATCH     3
+#define COMPRESS_MAX_MATCH     (COMPRESS_MIN_MATCH + 15)
+#define COMPRESS_HASH_BITS     10
+#define COMPRESS_HASH_SIZE     (1 << COMPRESS_HASH_BITS)
+#define COMPRESS_CHAIN_DEPTH   16
+
+typedef struct compress_work {
+    int32_t head[COMPRESS_HASH_SIZE];
+    uint16_t prev[COMPRESS_WINDOW_SIZE];
+} compress_work_t;
+
+static compress_work_t compress_work;
+static bytebeam_compress_stats_t compress_stats;
+static portMUX_TYPE compress_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *TAG = "BYTEBEAM_COMPRESS";
+
+static uint32_t compress_hash(const uint8_t *data)
+{
+    uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+
+    return (value * 2654435761u) >> (32 - COMPRESS_HASH_BITS);
+}
+
+static void compress_insert(compress_work_t *work, const uint8_t *in, size_t in_len, size_t pos)
+{
+    if (pos + COMPRESS_MIN_MATCH > in_len)
+    {
+        return;
+    }
+
+    uint32_t hash = compress_hash(in + pos);
+    int32_t last = work->head[hash];
+    size_t dist = (last >= 0) ? pos - (size_t)last : 0;
+
+    // 0 ends the chain, so does a previous occurrence that already left the window
+    work->prev[pos & COMPRESS_WINDOW_MASK] = (dist > 0 && dist <= COMPRESS_WINDOW_SIZE) ? (uint16_t)dist : 0;
+    work->head[hash] = (int32_t)pos;
+}
+
+static size_t compress_find_match(compress_work_t *work, const uint8_t *in, size_t in_len, size_t pos, size_t *match_dist)
+{
+    size_t best_len = 0;
+    size_t max_len = in_len - pos;
+    int depth = COMPRESS_CHAIN_DEPTH;
+
+    if (max_len < COMPRESS_MIN_MATCH)
+    {
+        return 0;
+    }
+
+    if (max_len > COMPRESS_MAX_MATCH)
+    {
+        max_len = COMPRESS_MAX_MATCH;
+    }
+
+    int32_t cand = work->head[compress_hash(in + pos)];
+
+    while (cand >= 0 && pos - (size_t)cand <= COMPRESS_WINDOW_SIZE && depth-- > 0)
+    {
+        const uint8_t *match = in + cand;
+        size_t len = 0;
+
+        while (len < max_len && match[len] == in[pos + len])
+        {
+            len++;
+        }
+
+        if (len > best_len)
+        {
+            best_len = len;
+            *match_dist = pos - (size_t)cand;
+
+            if (len == max_len)
+            {
+                break;
+            }
+        }
+
+        uint16_t dist = work->prev[cand & COMPRESS_WINDOW_MASK];
+
+        if (dist == 0)
+        {
+            break;
+        }
+
+        cand -= dist;
+    }
+
+    return best_len;
+}
+
+size_t bytebeam_compress_bound(size_t len)
+{
+    // every 8 literals cost one flag byte
+    return BYTEBEAM_COMPRESS_HEADER_LEN + len + (len + 7) / 8;
+}
+
+bytebeam_err_t bytebeam_compress(const char *in, size_t in_len, char *out, size_t out_capacity, size_t *out_len)
+{
+    if (in == NULL || out == NULL || out_len == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (out_capacity < BYTEBEAM_COMPRESS_HEADER_LEN + 1 || in_len > UINT32_MAX)
+    {
+        return BB_FAILURE;
+    }
+
+    compress_work_t *work = &compress_work;
+
+    for (int loop_var = 0; loop_var < COMPRESS_HASH_SIZE; loop_var++)
+    {
+        work->head[loop_var] = -1;
+    }
+
+    const uint8_t *src = (const uint8_t *)in;
+    uint8_t *dst = (uint8_t *)out;
+
+    dst[0] = (uint8_t)(in_len);
+    dst[1] = (uint8_t)(in_len >> 8);
+    dst[2] = (uint8_t)(in_len >> 16);
+    dst[3] = (uint8_t)(in_len >> 24);
+
+    size_t pos = 0;
+    size_t op = BYTEBEAM_COMPRESS_HEADER_LEN;
+    size_t flag_pos = 0;
+    int flag_bit = 8;
+
+    while (pos < in_len)
+    {
+        size_t match_dist = 0;
+        size_t match_len = compress_find_match(work, src, in_len, pos, &match_dist);
+        bool is_match = (match_len >= COMPRESS_MIN_MATCH);
+
+        // the item plus a new flag byte when the current one is used up must fit
+        if (op + (flag_bit == 8) + (is_match ? 2 : 1) > out_capacity)
+        {
+            BB_LOGV(TAG, "Compressed payload exceeded %d bytes", (int)out_capacity);
+            return BB_FAILURE;
+        }
+
+        if (flag_bit == 8)
+        {
+            flag_pos = op++;
+            dst[flag_pos] = 0;
+            flag_bit = 0;
+        }
+
+        if (is_match)
+        {
+            dst[op++] = (uint8_t)(match_dist - 1);
+            dst[op++] = (uint8_t)((((match_dist - 1) >> 8) << 4) | (match_len - COMPRESS_MIN_MATCH));
+
+            for (size_t loop_var = 0; loop_var < match_len; loop_var++)
+            {
+                compress_insert(work, src, in_len, pos + loop_var);
+            }
+
+            pos += match_len;
+        }
+        else
+        {
+            dst[flag_pos] |= (1 << flag_bit);
+            dst[op++] = src[pos];
+
+            compress_insert(work, src, in_len, pos);
+            pos++;
+        }
+
+        flag_bit++;
+    }
+
+    *out_len = op;
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_compress_account(size_t in_len, size_t out_len, uint32_t cpu_time_us)
+{
+    taskENTER_CRITICAL(&compress_stats_lock);
+
+    if (out_len > 0)
+    {
+        compress_stats.publishes++;
+        compress_stats.bytes_in += in_len;
+        compress_stats.bytes_out += out_len;
+    }
+    else
+    {
+        compress_stats.skipped++;
+    }
+
+    compress_stats.cpu_time_us += cpu_time_us;
+
+    taskEXIT_CRITICAL(&compress_stats_lock);
+}
+
+bytebeam_err_t bytebeam_compress_get_stats(bytebeam_compress_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    taskENTER_CRITICAL(&compress_stats_lock);
+    *stats = compress_stats;
+    taskEXIT_CRITICAL(&compress_stats_lock);
+
+    return BB_SUCCESS;
+}
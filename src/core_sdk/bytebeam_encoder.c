@@ -0,0 +1,162 @@
+#include "bytebeam_encoder.h"
+
+void bytebeam_encoder_init(bytebeam_encoder_t *encoder, bytebeam_encoding_t encoding, void *buf, size_t capacity)
+{
+    encoder->encoding = encoding;
+
+    if (encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_writer_init(&encoder->cbor, buf, capacity);
+    }
+    else
+    {
+        bytebeam_json_writer_init(&encoder->json, buf, capacity);
+    }
+}
+
+void bytebeam_encoder_begin_array(bytebeam_encoder_t *encoder, size_t count)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_begin_array(&encoder->cbor, count);
+    }
+    else
+    {
+        bytebeam_json_begin_array(&encoder->json);
+    }
+}
+
+void bytebeam_encoder_begin_map(bytebeam_encoder_t *encoder, size_t count)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_begin_map(&encoder->cbor, count);
+    }
+    else
+    {
+        bytebeam_json_begin_map(&encoder->json);
+    }
+}
+
+void bytebeam_encoder_end(bytebeam_encoder_t *encoder)
+{
+    // the CBOR containers carry their count, there is nothing to close
+    if (encoder->encoding == BYTEBEAM_ENCODING_JSON)
+    {
+        bytebeam_json_end(&encoder->json);
+    }
+}
+
+void bytebeam_encoder_put_key(bytebeam_encoder_t *encoder, const char *key)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_string(&encoder->cbor, key);
+    }
+    else
+    {
+        bytebeam_json_put_key(&encoder->json, key);
+    }
+}
+
+void bytebeam_encoder_put_uint(bytebeam_encoder_t *encoder, uint64_t value)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_uint(&encoder->cbor, value);
+    }
+    else
+    {
+        bytebeam_json_put_uint(&encoder->json, value);
+    }
+}
+
+void bytebeam_encoder_put_int(bytebeam_encoder_t *encoder, int64_t value)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_int(&encoder->cbor, value);
+    }
+    else
+    {
+        bytebeam_json_put_int(&encoder->json, value);
+    }
+}
+
+void bytebeam_encoder_put_double(bytebeam_encoder_t *encoder, double value)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_double(&encoder->cbor, value);
+    }
+    else
+    {
+        bytebeam_json_put_double(&encoder->json, value);
+    }
+}
+
+void bytebeam_encoder_put_float(bytebeam_encoder_t *encoder, float value)
+{
+    // a float always fits the single precision form of the CBOR writer
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_double(&encoder->cbor, value);
+    }
+    else
+    {
+        bytebeam_json_put_float(&encoder->json, value);
+    }
+}
+
+void bytebeam_encoder_put_bool(bytebeam_encoder_t *encoder, bool value)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_bool(&encoder->cbor, value);
+    }
+    else
+    {
+        bytebeam_json_put_bool(&encoder->json, value);
+    }
+}
+
+void bytebeam_encoder_put_null(bytebeam_encoder_t *encoder)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_null(&encoder->cbor);
+    }
+    else
+    {
+        bytebeam_json_put_null(&encoder->json);
+    }
+}
+
+void bytebeam_encoder_put_string(bytebeam_encoder_t *encoder, const char *str)
+{
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        bytebeam_cbor_put_string(&encoder->cbor, str);
+    }
+    else
+    {
+        bytebeam_json_put_string(&encoder->json, str);
+    }
+}
+
+bytebeam_err_t bytebeam_encoder_finish(bytebeam_encoder_t *encoder, size_t *len)
+{
+    if (encoder == NULL || len == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (encoder->encoding == BYTEBEAM_ENCODING_CBOR)
+    {
+        return bytebeam_cbor_writer_finish(&encoder->cbor, len);
+    }
+    else
+    {
+        return bytebeam_json_writer_finish(&encoder->json, len);
+    }
+}
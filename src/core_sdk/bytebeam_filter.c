@@ -0,0 +1,78 @@
+#include <math.h>
+#include "bytebeam_filter.h"
+
+bytebeam_err_t bytebeam_filter_validate(const bytebeam_field_filter_t *filter)
+{
+    if (filter == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (filter->mode > BYTEBEAM_FILTER_MODE_DEADBAND_PCT || !(filter->threshold >= 0))
+    {
+        return BB_FAILURE;
+    }
+
+    if (filter->max_interval_ms != 0 && filter->min_interval_ms > filter->max_interval_ms)
+    {
+        return BB_FAILURE;
+    }
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_filter_reset(bytebeam_filter_state_t *state)
+{
+    state->reported = false;
+    state->last_value = 0;
+    state->last_report_ms = 0;
+    state->samples = 0;
+}
+
+static bool filter_changed(const bytebeam_field_filter_t *filter, const bytebeam_filter_state_t *state, double value)
+{
+    double delta = fabs(value - state->last_value);
+
+    switch (filter->mode)
+    {
+        case BYTEBEAM_FILTER_MODE_DEADBAND_ABS : return delta > filter->threshold;
+        case BYTEBEAM_FILTER_MODE_DEADBAND_PCT : return delta * 100 > filter->threshold * fabs(state->last_value);
+        default                                : return true;
+    }
+}
+
+bool bytebeam_filter_wants(const bytebeam_field_filter_t *filter, bytebeam_filter_state_t *state, double value, long long now_ms)
+{
+    // the samples in between are skipped before anything else looks at them
+    if (filter->decimation > 1)
+    {
+        if (++state->samples < filter->decimation)
+        {
+            return false;
+        }
+
+        state->samples = 0;
+    }
+
+    if (!state->reported)
+    {
+        return true;
+    }
+
+    long long elapsed_ms = now_ms - state->last_report_ms;
+
+    // the heartbeat goes out whatever the value, so a quiet field still shows it is alive
+    if (filter->max_interval_ms != 0 && elapsed_ms >= filter->max_interval_ms)
+    {
+        return true;
+    }
+
+    return elapsed_ms >= filter->min_interval_ms && filter_changed(filter, state, value);
+}
+
+void bytebeam_filter_reported(bytebeam_filter_state_t *state, double value, long long now_ms)
+{
+    state->reported = true;
+    state->last_value = value;
+    state->last_report_ms = now_ms;
+}
@@ -0,0 +1,180 @@
+#include "freertos/FreeRTOS.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_inflight.h"
+#include "bytebeam_flow.h"
+
+static bytebeam_flow_config_t flow_config = {
+    .outbox_high_bytes = CONFIG_BYTEBEAM_OUTBOX_HIGH_WATERMARK,
+    .outbox_low_bytes = CONFIG_BYTEBEAM_OUTBOX_LOW_WATERMARK,
+    .inflight_high = CONFIG_BYTEBEAM_INFLIGHT_HIGH_WATERMARK,
+    .inflight_low = CONFIG_BYTEBEAM_INFLIGHT_LOW_WATERMARK,
+    .control_reserved_bytes = CONFIG_BYTEBEAM_CONTROL_OUTBOX_RESERVE,
+    .control_yield_ms = CONFIG_BYTEBEAM_CONTROL_YIELD_MAX
+};
+
+static bytebeam_flow_cb_t flow_callback = NULL;
+static void *flow_user_data = NULL;
+static bool flow_paused = false;
+static bytebeam_client_t *flow_client = NULL;
+static long long flow_control_us = 0;
+static portMUX_TYPE flow_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *TAG = "BYTEBEAM_FLOW";
+
+bytebeam_err_t bytebeam_flow_set_config(const bytebeam_flow_config_t *config)
+{
+    if (config == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (config->outbox_low_bytes >= config->outbox_high_bytes || config->inflight_low >= config->inflight_high)
+    {
+        BB_LOGE(TAG, "Low watermarks must be below the high watermarks");
+        return BB_FAILURE;
+    }
+
+    if (config->control_reserved_bytes < 0)
+    {
+        BB_LOGE(TAG, "Reserved control capacity can not be negative");
+        return BB_FAILURE;
+    }
+
+    taskENTER_CRITICAL(&flow_lock);
+    flow_config = *config;
+    taskEXIT_CRITICAL(&flow_lock);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_flow_register_callback(bytebeam_flow_cb_t callback, void *user_data)
+{
+    taskENTER_CRITICAL(&flow_lock);
+    flow_callback = callback;
+    flow_user_data = user_data;
+    taskEXIT_CRITICAL(&flow_lock);
+
+    return BB_SUCCESS;
+}
+
+static bytebeam_err_t flow_check_control(int outbox_bytes)
+{
+    long long now_us = bytebeam_hal_get_uptime_us();
+    bool refused;
+
+    taskENTER_CRITICAL(&flow_lock);
+
+    // the control lane ignores the bulk pause and only stops once its reserve is used up too
+    refused = outbox_bytes >= 0 && outbox_bytes >= flow_config.outbox_high_bytes + flow_config.control_reserved_bytes;
+
+    if (!refused)
+    {
+        flow_control_us = now_us;
+    }
+
+    taskEXIT_CRITICAL(&flow_lock);
+
+    if (refused)
+    {
+        BB_LOGW(TAG, "Reserved control capacity used up, outbox holds %d bytes", outbox_bytes);
+        return BB_WOULD_BLOCK;
+    }
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_flow_check(bytebeam_client_t *bytebeam_client, bytebeam_publish_priority_t priority)
+{
+    flow_client = bytebeam_client;
+
+    // read outside the lock, the outbox size takes the MQTT client lock
+    int outbox_bytes = (bytebeam_client->client != NULL) ? bytebeam_hal_mqtt_get_outbox_size(bytebeam_client->client) : -1;
+
+    if (priority == BYTEBEAM_PRIORITY_CONTROL)
+    {
+        return flow_check_control(outbox_bytes);
+    }
+
+    int inflight = (int)bytebeam_inflight_count();
+
+    bytebeam_flow_cb_t callback = NULL;
+    void *user_data = NULL;
+    bool changed = false;
+    bool paused;
+
+    taskENTER_CRITICAL(&flow_lock);
+
+    // an outbox that can not be read only leaves the in flight count to go by
+    bool above_high = inflight >= flow_config.inflight_high || (outbox_bytes >= 0 && outbox_bytes >= flow_config.outbox_high_bytes);
+    bool below_low = inflight <= flow_config.inflight_low && (outbox_bytes < 0 || outbox_bytes <= flow_config.outbox_low_bytes);
+
+    if ((!flow_paused && above_high) || (flow_paused && below_low))
+    {
+        flow_paused = !flow_paused;
+        callback = flow_callback;
+        user_data = flow_user_data;
+        changed = true;
+    }
+
+    paused = flow_paused;
+
+    taskEXIT_CRITICAL(&flow_lock);
+
+    if (changed)
+    {
+        if (paused)
+        {
+            BB_LOGW(TAG, "Pausing producers, outbox holds %d bytes and %d publishes are in flight", outbox_bytes, inflight);
+        }
+        else
+        {
+            BB_LOGI(TAG, "Resuming producers, outbox holds %d bytes and %d publishes are in flight", outbox_bytes, inflight);
+        }
+
+        if (callback != NULL)
+        {
+            callback(paused, user_data);
+        }
+    }
+
+    if (paused)
+    {
+        return BB_WOULD_BLOCK;
+    }
+
+    return BB_SUCCESS;
+}
+
+bool bytebeam_flow_is_yielding(void)
+{
+    if (bytebeam_inflight_control_count() == 0)
+    {
+        return false;
+    }
+
+    long long now_us = bytebeam_hal_get_uptime_us();
+    bool yielding;
+
+    // the bulk lane stays out of the way until the recent control publishes are acknowledged
+    taskENTER_CRITICAL(&flow_lock);
+    yielding = now_us - flow_control_us < (long long)flow_config.control_yield_ms * 1000;
+    taskEXIT_CRITICAL(&flow_lock);
+
+    return yielding;
+}
+
+void bytebeam_flow_poll(void)
+{
+    bytebeam_client_t *bytebeam_client = flow_client;
+
+    // the outbox also drains without any event, e.g. QoS 0 publishes, so a paused state is polled
+    if (bytebeam_flow_is_paused() && bytebeam_client != NULL)
+    {
+        bytebeam_flow_check(bytebeam_client, BYTEBEAM_PRIORITY_BULK);
+    }
+}
+
+bool bytebeam_flow_is_paused(void)
+{
+    return *(volatile bool *)&flow_paused;
+}
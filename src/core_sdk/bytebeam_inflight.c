@@ -0,0 +1,383 @@
+#include <limits.h>
+#include "freertos/FreeRTOS.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_inflight.h"
+
+/*
+ *  The in flight table holds the QoS 1 publishes waiting for their PUBACK, keyed by message id. A blocking publish
+ *  can be acknowledged before its caller gets the message id back, so an acknowledgement that finds no entry is
+ *  kept as an early entry and matched by the add that follows. Early entries nobody claims expire like the rest.
+ *  Callbacks are always called outside the lock.
+ */
+
+/* This enum represents the state of an in flight table entry */
+typedef enum inflight_entry_state {
+    INFLIGHT_ENTRY_FREE,            //!< Not in use
+    INFLIGHT_ENTRY_WAITING,         //!< Publish waiting for its acknowledgement
+    INFLIGHT_ENTRY_EARLY            //!< Acknowledgement waiting for its publish to be added
+} inflight_entry_state_t;
+
+/**
+ * @struct inflight_entry_t
+ * This struct contains a single entry of the in flight table
+ * @var inflight_entry_t::state
+ * Entry state
+ * @var inflight_entry_t::msg_id
+ * Message id of the publish
+ * @var inflight_entry_t::priority
+ * Priority lane of the publish
+ * @var inflight_entry_t::time_us
+ * Uptime at which the publish was made, or at which the early acknowledgement arrived
+ * @var inflight_entry_t::callback
+ * Completion callback, may be NULL
+ * @var inflight_entry_t::user_data
+ * User data passed to the callback
+ */
+typedef struct inflight_entry {
+    inflight_entry_state_t state;
+    int msg_id;
+    bytebeam_publish_priority_t priority;
+    long long time_us;
+    bytebeam_publish_cb_t callback;
+    void *user_data;
+} inflight_entry_t;
+
+static inflight_entry_t inflight_table[CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES];
+static portMUX_TYPE inflight_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bytebeam_publish_stats_t inflight_stats = { .latency_min_ms = UINT32_MAX };
+static uint64_t inflight_latency_sum_ms = 0;
+
+static const char *TAG = "BYTEBEAM_INFLIGHT";
+
+static inflight_entry_t* inflight_find(int msg_id)
+{
+    // the message ids grow by one per publish, so the home slot is nearly always the right one
+    int index = (unsigned)msg_id % CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES;
+
+    for (int loop_var = 0; loop_var < CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES; loop_var++)
+    {
+        inflight_entry_t *entry = &inflight_table[index];
+
+        if (entry->state != INFLIGHT_ENTRY_FREE && entry->msg_id == msg_id)
+        {
+            return entry;
+        }
+
+        index = (index + 1) % CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES;
+    }
+
+    return NULL;
+}
+
+static inflight_entry_t* inflight_claim(int msg_id)
+{
+    int index = (unsigned)msg_id % CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES;
+
+    for (int loop_var = 0; loop_var < CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES; loop_var++)
+    {
+        inflight_entry_t *entry = &inflight_table[index];
+
+        if (entry->state == INFLIGHT_ENTRY_FREE)
+        {
+            entry->msg_id = msg_id;
+            return entry;
+        }
+
+        index = (index + 1) % CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES;
+    }
+
+    return NULL;
+}
+
+static uint32_t inflight_elapsed_ms(long long from_us, long long to_us)
+{
+    return (to_us > from_us) ? (uint32_t)((to_us - from_us) / 1000) : 0;
+}
+
+static void inflight_untrack(const inflight_entry_t *entry)
+{
+    // called with the lock held, for an entry leaving the waiting state
+    inflight_stats.in_flight--;
+
+    if (entry->priority == BYTEBEAM_PRIORITY_CONTROL)
+    {
+        inflight_stats.control_in_flight--;
+    }
+}
+
+static void inflight_account(bytebeam_publish_status_t status, uint32_t latency_ms)
+{
+    // called with the lock held
+    if (status == BYTEBEAM_PUBLISH_ACKED)
+    {
+        inflight_stats.acked++;
+        inflight_stats.latency_last_ms = latency_ms;
+        inflight_latency_sum_ms += latency_ms;
+
+        if (latency_ms < inflight_stats.latency_min_ms)
+        {
+            inflight_stats.latency_min_ms = latency_ms;
+        }
+
+        if (latency_ms > inflight_stats.latency_max_ms)
+        {
+            inflight_stats.latency_max_ms = latency_ms;
+        }
+    }
+    else
+    {
+        inflight_stats.timed_out++;
+    }
+}
+
+bytebeam_err_t bytebeam_inflight_add(int msg_id, bytebeam_publish_priority_t priority, long long start_us, bytebeam_publish_cb_t callback, void *user_data)
+{
+    bytebeam_publish_status_t status = BYTEBEAM_PUBLISH_ACKED;
+    uint32_t latency_ms = 0;
+    bool completed = false;
+
+    taskENTER_CRITICAL(&inflight_lock);
+
+    inflight_entry_t *entry = inflight_find(msg_id);
+
+    if (entry != NULL && entry->state == INFLIGHT_ENTRY_EARLY)
+    {
+        latency_ms = inflight_elapsed_ms(start_us, entry->time_us);
+        inflight_account(status, latency_ms);
+
+        entry->state = INFLIGHT_ENTRY_FREE;
+        completed = true;
+    }
+    else
+    {
+        // a waiting entry with the same id is stale, the message id wrapped around since, it is taken over
+        if (entry == NULL)
+        {
+            entry = inflight_claim(msg_id);
+        }
+        else
+        {
+            inflight_untrack(entry);
+        }
+
+        if (entry != NULL)
+        {
+            inflight_stats.in_flight++;
+
+            if (priority == BYTEBEAM_PRIORITY_CONTROL)
+            {
+                inflight_stats.control_in_flight++;
+            }
+
+            entry->state = INFLIGHT_ENTRY_WAITING;
+            entry->priority = priority;
+            entry->time_us = start_us;
+            entry->callback = callback;
+            entry->user_data = user_data;
+        }
+        else
+        {
+            inflight_stats.untracked++;
+        }
+    }
+
+    taskEXIT_CRITICAL(&inflight_lock);
+
+    if (entry == NULL)
+    {
+        BB_LOGW(TAG, "In flight table is full, msg_id=%d is not tracked", msg_id);
+        return BB_FAILURE;
+    }
+
+    if (completed && callback != NULL)
+    {
+        callback(msg_id, status, latency_ms, user_data);
+    }
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_inflight_complete(int msg_id, bytebeam_publish_status_t status)
+{
+    long long now_us = bytebeam_hal_get_uptime_us();
+    bytebeam_publish_cb_t callback = NULL;
+    void *user_data = NULL;
+    uint32_t latency_ms = 0;
+    bool completed = false;
+
+    taskENTER_CRITICAL(&inflight_lock);
+
+    inflight_entry_t *entry = inflight_find(msg_id);
+
+    if (entry != NULL && entry->state == INFLIGHT_ENTRY_WAITING)
+    {
+        latency_ms = inflight_elapsed_ms(entry->time_us, now_us);
+        inflight_account(status, latency_ms);
+
+        callback = entry->callback;
+        user_data = entry->user_data;
+        entry->state = INFLIGHT_ENTRY_FREE;
+        inflight_untrack(entry);
+        completed = true;
+    }
+    else if (entry == NULL && status == BYTEBEAM_PUBLISH_ACKED)
+    {
+        // the publish call has not returned yet, keep the acknowledgement for its add
+        entry = inflight_claim(msg_id);
+
+        if (entry != NULL)
+        {
+            entry->state = INFLIGHT_ENTRY_EARLY;
+            entry->time_us = now_us;
+            entry->callback = NULL;
+            entry->user_data = NULL;
+        }
+    }
+
+    taskEXIT_CRITICAL(&inflight_lock);
+
+    if (completed)
+    {
+        BB_LOGD(TAG, "msg_id=%d completed in %u ms", msg_id, (unsigned)latency_ms);
+
+        if (callback != NULL)
+        {
+            callback(msg_id, status, latency_ms, user_data);
+        }
+    }
+}
+
+void bytebeam_inflight_expire(uint32_t *next_expiry_ms)
+{
+    long long timeout_us = (long long)CONFIG_BYTEBEAM_PUBLISH_ACK_TIMEOUT_MS * 1000;
+
+    *next_expiry_ms = UINT32_MAX;
+
+    // one expired entry per pass, its callback runs without the lock
+    while (1)
+    {
+        long long now_us = bytebeam_hal_get_uptime_us();
+        inflight_entry_t expired = { .state = INFLIGHT_ENTRY_FREE };
+        long long oldest_us = LLONG_MAX;
+
+        taskENTER_CRITICAL(&inflight_lock);
+
+        for (int loop_var = 0; loop_var < CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES; loop_var++)
+        {
+            inflight_entry_t *entry = &inflight_table[loop_var];
+
+            if (entry->state == INFLIGHT_ENTRY_FREE)
+            {
+                continue;
+            }
+
+            if (now_us - entry->time_us >= timeout_us)
+            {
+                expired = *entry;
+                entry->state = INFLIGHT_ENTRY_FREE;
+
+                // an unclaimed early acknowledgement goes silently
+                if (expired.state == INFLIGHT_ENTRY_WAITING)
+                {
+                    inflight_account(BYTEBEAM_PUBLISH_TIMED_OUT, 0);
+                    inflight_untrack(&expired);
+                }
+
+                break;
+            }
+
+            if (entry->time_us < oldest_us)
+            {
+                oldest_us = entry->time_us;
+            }
+        }
+
+        taskEXIT_CRITICAL(&inflight_lock);
+
+        if (expired.state == INFLIGHT_ENTRY_FREE)
+        {
+            // rounded up so the next call finds the entry expired
+            if (oldest_us != LLONG_MAX)
+            {
+                *next_expiry_ms = inflight_elapsed_ms(now_us, oldest_us + timeout_us) + 1;
+            }
+
+            return;
+        }
+
+        if (expired.state == INFLIGHT_ENTRY_WAITING)
+        {
+            BB_LOGW(TAG, "msg_id=%d was not acknowledged in %d ms", expired.msg_id, CONFIG_BYTEBEAM_PUBLISH_ACK_TIMEOUT_MS);
+
+            if (expired.callback != NULL)
+            {
+                expired.callback(expired.msg_id, BYTEBEAM_PUBLISH_TIMED_OUT, inflight_elapsed_ms(expired.time_us, now_us), expired.user_data);
+            }
+        }
+    }
+}
+
+void bytebeam_inflight_reset(void)
+{
+    long long now_us = bytebeam_hal_get_uptime_us();
+
+    for (int loop_var = 0; loop_var < CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES; loop_var++)
+    {
+        inflight_entry_t expired;
+
+        taskENTER_CRITICAL(&inflight_lock);
+
+        expired = inflight_table[loop_var];
+        inflight_table[loop_var].state = INFLIGHT_ENTRY_FREE;
+
+        if (expired.state == INFLIGHT_ENTRY_WAITING)
+        {
+            inflight_account(BYTEBEAM_PUBLISH_TIMED_OUT, 0);
+            inflight_untrack(&expired);
+        }
+
+        taskEXIT_CRITICAL(&inflight_lock);
+
+        if (expired.state == INFLIGHT_ENTRY_WAITING && expired.callback != NULL)
+        {
+            expired.callback(expired.msg_id, BYTEBEAM_PUBLISH_TIMED_OUT, inflight_elapsed_ms(expired.time_us, now_us), expired.user_data);
+        }
+    }
+}
+
+uint32_t bytebeam_inflight_count(void)
+{
+    // a single aligned word, read without the lock
+    return *(volatile uint32_t *)&inflight_stats.in_flight;
+}
+
+uint32_t bytebeam_inflight_control_count(void)
+{
+    return *(volatile uint32_t *)&inflight_stats.control_in_flight;
+}
+
+bytebeam_err_t bytebeam_inflight_get_stats(bytebeam_publish_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    taskENTER_CRITICAL(&inflight_lock);
+
+    *stats = inflight_stats;
+
+    if (inflight_stats.acked > 0)
+    {
+        stats->latency_avg_ms = (uint32_t)(inflight_latency_sum_ms / inflight_stats.acked);
+    }
+    else
+    {
+        stats->latency_min_ms = 0;
+    }
+
+    taskEXIT_CRITICAL(&inflight_lock);
+
+    return BB_SUCCESS;
+}
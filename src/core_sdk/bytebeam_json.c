@@ -0,0 +1,311 @@
+#include <stdio.h>
+#include <math.h>
+#include "bytebeam_json.h"
+
+static const char json_hex_digits[] = "0123456789abcdef";
+
+static bool json_reserve(bytebeam_json_writer_t *writer, size_t len)
+{
+    if (writer->overflow || writer->capacity - writer->len < len)
+    {
+        writer->overflow = true;
+        return false;
+    }
+
+    return true;
+}
+
+static void json_put_bytes(bytebeam_json_writer_t *writer, const void *data, size_t len)
+{
+    if (!json_reserve(writer, len))
+    {
+        return;
+    }
+
+    memcpy(writer->buf + writer->len, data, len);
+    writer->len += len;
+}
+
+static void json_put_char(bytebeam_json_writer_t *writer, char c)
+{
+    json_put_bytes(writer, &c, 1);
+}
+
+static void json_begin_value(bytebeam_json_writer_t *writer)
+{
+    // a value right after its key is already separated by the colon
+    if (writer->after_key)
+    {
+        writer->after_key = false;
+        return;
+    }
+
+    if (writer->depth == 0)
+    {
+        return;
+    }
+
+    uint32_t level = 1u << (writer->depth - 1);
+
+    if (writer->has_items & level)
+    {
+        json_put_char(writer, ',');
+    }
+
+    writer->has_items |= level;
+}
+
+static void json_begin_container(bytebeam_json_writer_t *writer, bool is_map)
+{
+    json_begin_value(writer);
+
+    if (writer->depth >= BYTEBEAM_JSON_MAX_DEPTH)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    uint32_t level = 1u << writer->depth;
+
+    if (is_map)
+    {
+        writer->is_map |= level;
+    }
+    else
+    {
+        writer->is_map &= ~level;
+    }
+
+    writer->has_items &= ~level;
+    writer->depth++;
+
+    json_put_char(writer, is_map ? '{' : '[');
+}
+
+static void json_put_escaped(bytebeam_json_writer_t *writer, const char *str, size_t len)
+{
+    size_t start = 0;
+
+    json_put_char(writer, '"');
+
+    for (size_t loop_var = 0; loop_var < len; loop_var++)
+    {
+        unsigned char c = (unsigned char)str[loop_var];
+        char escape[6] = { '\\', 0, '0', '0', 0, 0 };
+        size_t escape_len = 2;
+
+        if (c >= 0x20 && c != '"' && c != '\\')
+        {
+            continue;
+        }
+
+        // copy the run of plain characters before the one that needs an escape
+        json_put_bytes(writer, str + start, loop_var - start);
+        start = loop_var + 1;
+
+        switch (c)
+        {
+            case '"'  : escape[1] = '"';  break;
+            case '\\' : escape[1] = '\\'; break;
+            case '\b' : escape[1] = 'b';  break;
+            case '\f' : escape[1] = 'f';  break;
+            case '\n' : escape[1] = 'n';  break;
+            case '\r' : escape[1] = 'r';  break;
+            case '\t' : escape[1] = 't';  break;
+
+            default:
+                escape[1] = 'u';
+                escape[4] = json_hex_digits[c >> 4];
+                escape[5] = json_hex_digits[c & 0x0F];
+                escape_len = 6;
+        }
+
+        json_put_bytes(writer, escape, escape_len);
+    }
+
+    json_put_bytes(writer, str + start, len - start);
+    json_put_char(writer, '"');
+}
+
+static void json_put_digits(bytebeam_json_writer_t *writer, bool negative, uint64_t magnitude)
+{
+    char digits[21];
+    size_t pos = sizeof(digits);
+
+    do
+    {
+        digits[--pos] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    if (negative)
+    {
+        digits[--pos] = '-';
+    }
+
+    json_put_bytes(writer, digits + pos, sizeof(digits) - pos);
+}
+
+void bytebeam_json_writer_init(bytebeam_json_writer_t *writer, void *buf, size_t capacity)
+{
+    writer->buf = buf;
+    writer->capacity = (buf != NULL) ? capacity : 0;
+    writer->len = 0;
+    writer->overflow = false;
+    writer->depth = 0;
+    writer->is_map = 0;
+    writer->has_items = 0;
+    writer->after_key = false;
+}
+
+void bytebeam_json_begin_array(bytebeam_json_writer_t *writer)
+{
+    json_begin_container(writer, false);
+}
+
+void bytebeam_json_begin_map(bytebeam_json_writer_t *writer)
+{
+    json_begin_container(writer, true);
+}
+
+void bytebeam_json_end(bytebeam_json_writer_t *writer)
+{
+    if (writer->depth == 0)
+    {
+        writer->overflow = true;
+        return;
+    }
+
+    writer->depth--;
+
+    json_put_char(writer, (writer->is_map & (1u << writer->depth)) ? '}' : ']');
+}
+
+void bytebeam_json_put_key(bytebeam_json_writer_t *writer, const char *key)
+{
+    json_begin_value(writer);
+    json_put_escaped(writer, key, strlen(key));
+    json_put_char(writer, ':');
+
+    writer->after_key = true;
+}
+
+void bytebeam_json_put_uint(bytebeam_json_writer_t *writer, uint64_t value)
+{
+    json_begin_value(writer);
+    json_put_digits(writer, false, value);
+}
+
+void bytebeam_json_put_int(bytebeam_json_writer_t *writer, int64_t value)
+{
+    json_begin_value(writer);
+
+    // the magnitude of INT64_MIN does not fit in an int64_t, it is taken in unsigned arithmetic
+    json_put_digits(writer, value < 0, (value < 0) ? (uint64_t)0 - (uint64_t)value : (uint64_t)value);
+}
+
+void bytebeam_json_put_double(bytebeam_json_writer_t *writer, double value)
+{
+    char number[32];
+
+    if (isnan(value) || isinf(value))
+    {
+        bytebeam_json_put_null(writer);
+        return;
+    }
+
+    // 15 significant digits cover most values, 17 always read back the same
+    int len = snprintf(number, sizeof(number), "%1.15g", value);
+
+    if (strtod(number, NULL) != value)
+    {
+        len = snprintf(number, sizeof(number), "%1.17g", value);
+    }
+
+    json_begin_value(writer);
+    json_put_bytes(writer, number, (size_t)len);
+}
+
+void bytebeam_json_put_float(bytebeam_json_writer_t *writer, float value)
+{
+    char number[32];
+
+    if (isnan(value) || isinf(value))
+    {
+        bytebeam_json_put_null(writer);
+        return;
+    }
+
+    // printing the float as a double would show its binary error, e.g. 0.7f as 0.69999998807907104
+    int len = snprintf(number, sizeof(number), "%1.7g", (double)value);
+
+    if (strtof(number, NULL) != value)
+    {
+        len = snprintf(number, sizeof(number), "%1.9g", (double)value);
+    }
+
+    json_begin_value(writer);
+    json_put_bytes(writer, number, (size_t)len);
+}
+
+void bytebeam_json_put_bool(bytebeam_json_writer_t *writer, bool value)
+{
+    json_begin_value(writer);
+
+    if (value)
+    {
+        json_put_bytes(writer, "true", 4);
+    }
+    else
+    {
+        json_put_bytes(writer, "false", 5);
+    }
+}
+
+void bytebeam_json_put_null(bytebeam_json_writer_t *writer)
+{
+    json_begin_value(writer);
+    json_put_bytes(writer, "null", 4);
+}
+
+void bytebeam_json_put_string(bytebeam_json_writer_t *writer, const char *str)
+{
+    if (str == NULL)
+    {
+        bytebeam_json_put_null(writer);
+        return;
+    }
+
+    bytebeam_json_put_string_len(writer, str, strlen(str));
+}
+
+void bytebeam_json_put_string_len(bytebeam_json_writer_t *writer, const char *str, size_t len)
+{
+    json_begin_value(writer);
+    json_put_escaped(writer, str, len);
+}
+
+void bytebeam_json_put_raw(bytebeam_json_writer_t *writer, const char *json, size_t len)
+{
+    json_begin_value(writer);
+    json_put_bytes(writer, json, len);
+}
+
+bytebeam_err_t bytebeam_json_writer_finish(bytebeam_json_writer_t *writer, size_t *len)
+{
+    if (writer == NULL || len == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    // the terminator is not part of the message, it only needs room
+    if (writer->overflow || writer->depth != 0 || writer->capacity - writer->len < 1)
+    {
+        return BB_FAILURE;
+    }
+
+    writer->buf[writer->len] = '\0';
+    *len = writer->len;
+
+    return BB_SUCCESS;
+}
@@ -1,18 +1,37 @@
-#include "cJSON.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "bytebeam_hal.h"
 #include "bytebeam_stream.h"
 #include "bytebeam_log.h"
+#include "bytebeam_encoder.h"
+
+/*This macro is used to specify the size of the encoded log buffer, room for the keys, the numbers and the escapes*/
+#define BYTEBEAM_LOG_ENCODED_STR_LEN (2 * CONFIG_BYTEBEAM_CLOUD_LOG_MESSAGE_SIZE + 128)
 
 // bytebeam log module variables
 static bool is_cloud_logging_enable = false;
 static char bytebeam_log_stream[BYTEBEAM_LOG_STREAM_STR_LEN] = "";
 static bytebeam_log_level_t bytebeam_log_level = BYTEBEAM_LOG_LEVEL_INFO;
 static bytebeam_client_t *bytebeam_log_client = NULL;
+static SemaphoreHandle_t bytebeam_log_lock = NULL;
+static char bytebeam_log_message[CONFIG_BYTEBEAM_CLOUD_LOG_MESSAGE_SIZE];
+static char bytebeam_log_encoded[BYTEBEAM_LOG_ENCODED_STR_LEN];
 
 static const char *TAG = "BYTEBEAM_LOG";
 
 void bytebeam_log_client_set(bytebeam_client_t *bytebeam_client)
 {
+    // created once and kept, the log buffers may be in use by another task while the client is cleared
+    if (bytebeam_log_lock == NULL)
+    {
+        bytebeam_log_lock = xSemaphoreCreateMutex();
+
+        if (bytebeam_log_lock == NULL)
+        {
+            BB_LOGE(TAG, "Failed to create the log lock");
+        }
+    }
+
     bytebeam_log_client = bytebeam_client;
 }
 
@@ -73,19 +92,11 @@ char* bytebeam_log_stream_get()
 bytebeam_err_t bytebeam_log_publish(const char *level, const char *tag, const char *fmt, ...)
 {
     static uint64_t sequence = 0;
-    unsigned long long milliseconds = 0;
 
-    cJSON *device_log_json_list = NULL;
-    cJSON *device_log_json = NULL;
-    cJSON *sequence_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *log_level_json = NULL;
-    cJSON *log_tag_json = NULL;
-    cJSON *log_message_json = NULL;
+    size_t log_len = 0;
+    bytebeam_encoder_t encoder;
 
-    char *log_string_json = NULL;
-
-    if(bytebeam_log_client == NULL)
+    if(bytebeam_log_client == NULL || bytebeam_log_lock == NULL)
     {
         BB_LOGE(TAG, "Bytebeam log client handle is not set");
         return BB_FAILURE;
@@ -98,153 +109,61 @@ bytebeam_err_t bytebeam_log_publish(const char *level, const char *tag, const ch
         return BB_FAILURE;
     }
 
-    va_list args;
+    unsigned long long milliseconds = bytebeam_hal_get_epoch_millis();
 
-    // get the buffer size (+1 for NULL Character)
-    va_start(args, fmt);
-    int buffer_size = vsnprintf(NULL, 0, fmt, args) + 1; 
-    va_end(args);
-
-    // Check the buffer size
-    if(buffer_size <= 0) 
+    if(milliseconds == 0)
     {
-        BB_LOGE(TAG, "Failed to Get the buffer size for Bytebeam Log.");
+        BB_LOGE(TAG, "failed to get epoch millis.");
         return BB_FAILURE;
     }
 
-    // allocate the memory for the buffer to store the message
-    char *message_buffer = (char*) malloc(buffer_size);
-    if (message_buffer == NULL) 
-    {
-        BB_LOGE(TAG, "Failed to ALlocate the memory for Bytebeam Log.");
-        return BB_FAILURE;
-    }
+    // the buffers are shared by all the tasks that log
+    xSemaphoreTake(bytebeam_log_lock, portMAX_DELAY);
+
+    va_list args;
 
-    // get the message in the buffer
+    // get the message in the buffer, longer messages are truncated
     va_start(args, fmt);
-    int temp_var = vsnprintf(message_buffer, buffer_size, fmt, args);
+    int temp_var = vsnprintf(bytebeam_log_message, sizeof(bytebeam_log_message), fmt, args);
     va_end(args);
 
-    // Check for argument loss
-    if (temp_var >= buffer_size) 
+    if (temp_var < 0)
     {
         BB_LOGE(TAG, "Failed to Get the message for Bytebeam Log.");
 
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-
-    device_log_json_list = cJSON_CreateArray();
-
-    if (device_log_json_list == NULL) {
-        BB_LOGE(TAG, "Log Json Init failed.");
-
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-
-    device_log_json = cJSON_CreateObject();
-
-    if (device_log_json == NULL) {
-        BB_LOGE(TAG, "Log Json add failed.");
-
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-    
-    milliseconds = bytebeam_hal_get_epoch_millis();
-
-    if(milliseconds == 0)
-    {
-        BB_LOGE(TAG, "failed to get epoch millis.");
-
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
+        xSemaphoreGive(bytebeam_log_lock);
         return BB_FAILURE;
     }
 
-    timestamp_json = cJSON_CreateNumber(milliseconds);
-
-    if (timestamp_json == NULL) {
-        BB_LOGE(TAG, "Log Json add time stamp failed.");
-
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(device_log_json, "timestamp", timestamp_json);
-
     sequence++;
-    sequence_json = cJSON_CreateNumber(sequence);
-
-    if (sequence_json == NULL) {
-        BB_LOGE(TAG, "Log Json add sequence id failed.");
-
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(device_log_json, "sequence", sequence_json);
-
-    log_level_json = cJSON_CreateString(level);
-
-    if (log_level_json == NULL) {
-        BB_LOGE(TAG, "Log Json add level failed.");
-
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(device_log_json, "level", log_level_json);
 
-    log_tag_json = cJSON_CreateString(tag);
-
-    if (log_tag_json == NULL) {
-        BB_LOGE(TAG, "Log Json add tag failed.");
-
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(device_log_json, "tag", log_tag_json);
-
-    log_message_json = cJSON_CreateString(message_buffer);
-
-    if (log_message_json == NULL) {
-        BB_LOGE(TAG, "Log Json add message failed.");
-
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
-        return BB_FAILURE;
-    }
-
-    cJSON_AddItemToObject(device_log_json, "message", log_message_json);
-
-    cJSON_AddItemToArray(device_log_json_list, device_log_json);
-
-    log_string_json = cJSON_Print(device_log_json_list);
-
-    if(log_string_json == NULL)
+    bytebeam_encoder_init(&encoder, BYTEBEAM_MESSAGE_ENCODING, bytebeam_log_encoded, sizeof(bytebeam_log_encoded));
+    bytebeam_encoder_begin_array(&encoder, 1);
+    bytebeam_encoder_begin_map(&encoder, 5);
+    bytebeam_encoder_put_key(&encoder, "timestamp");
+    bytebeam_encoder_put_uint(&encoder, milliseconds);
+    bytebeam_encoder_put_key(&encoder, "sequence");
+    bytebeam_encoder_put_uint(&encoder, sequence);
+    bytebeam_encoder_put_key(&encoder, "level");
+    bytebeam_encoder_put_string(&encoder, level);
+    bytebeam_encoder_put_key(&encoder, "tag");
+    bytebeam_encoder_put_string(&encoder, tag);
+    bytebeam_encoder_put_key(&encoder, "message");
+    bytebeam_encoder_put_string(&encoder, bytebeam_log_message);
+    bytebeam_encoder_end(&encoder);
+    bytebeam_encoder_end(&encoder);
+
+    if (bytebeam_encoder_finish(&encoder, &log_len) != BB_SUCCESS)
     {
-        BB_LOGE(TAG, "Json string print failed.");
+        BB_LOGE(TAG, "Log exceeded buffer size");
 
-        cJSON_Delete(device_log_json_list);
-        free(message_buffer);
+        xSemaphoreGive(bytebeam_log_lock);
         return BB_FAILURE;
-    } 
-
-    BB_LOGD(TAG, "\n Log to Send :\n%s\n", log_string_json);
+    }
 
-    int ret_val = bytebeam_publish_to_stream(bytebeam_log_client, bytebeam_log_stream, log_string_json);
+    int ret_val = bytebeam_publish_encoded_to_stream(bytebeam_log_client, bytebeam_log_stream, BYTEBEAM_MESSAGE_ENCODING, bytebeam_log_encoded, log_len);
 
-    cJSON_Delete(device_log_json_list);
-    cJSON_free(log_string_json);
-    free(message_buffer);
+    xSemaphoreGive(bytebeam_log_lock);
 
     return ret_val;
-}
\ No newline at end of file
+}
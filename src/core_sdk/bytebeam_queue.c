@@ -0,0 +1,274 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_queue.h"
+
+/*
+ *  Bounded MPMC ring based on per slot sequence numbers (D. Vyukov). A slot is free for the producer claiming
+ *  position pos when its sequence equals pos, and holds a record for the consumer claiming position pos when its
+ *  sequence equals pos + 1. Positions are claimed with a CAS so producers never take a lock, and the overwrite
+ *  policy can safely evict the oldest record from the producer side.
+ */
+
+typedef struct bytebeam_queue_slot {
+    atomic_size_t seq;
+    size_t len;
+    char data[];
+} bytebeam_queue_slot_t;
+
+static const char *TAG = "BYTEBEAM_QUEUE";
+
+static bytebeam_queue_slot_t* queue_slot(bytebeam_queue_t *queue, size_t pos)
+{
+    return (bytebeam_queue_slot_t *)(queue->slots + (pos & queue->mask) * queue->slot_size);
+}
+
+static bool queue_claim_push(bytebeam_queue_t *queue, size_t *pos_out)
+{
+    size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+
+    while (1)
+    {
+        bytebeam_queue_slot_t *slot = queue_slot(queue, pos);
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                *pos_out = pos;
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            // slot still holds a record from the previous lap, queue is full
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static bool queue_claim_pop(bytebeam_queue_t *queue, size_t *pos_out)
+{
+    size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+
+    while (1)
+    {
+        bytebeam_queue_slot_t *slot = queue_slot(queue, pos);
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                *pos_out = pos;
+                return true;
+            }
+        }
+        else if (diff < 0)
+        {
+            // slot is not yet published, queue is empty
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+static void queue_release_pop(bytebeam_queue_t *queue, size_t pos)
+{
+    bytebeam_queue_slot_t *slot = queue_slot(queue, pos);
+    atomic_store_explicit(&slot->seq, pos + queue->mask + 1, memory_order_release);
+}
+
+bytebeam_err_t bytebeam_queue_init(bytebeam_queue_t *queue, size_t depth, size_t record_size, bytebeam_queue_policy_t policy, uint32_t block_timeout_ms)
+{
+    if (queue == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    size_t num_slots = 2;
+
+    // round the depth up to a power of two so the position can be masked
+    while (num_slots < depth)
+    {
+        num_slots = num_slots << 1;
+    }
+
+    size_t slot_size = sizeof(bytebeam_queue_slot_t) + record_size;
+    slot_size = (slot_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+
+    queue->slots = malloc(num_slots * slot_size);
+
+    if (queue->slots == NULL)
+    {
+        BB_LOGE(TAG, "Failed to allocate the memory for %d queue slots", (int)num_slots);
+        return BB_FAILURE;
+    }
+
+    queue->mask = num_slots - 1;
+    queue->record_size = record_size;
+    queue->slot_size = slot_size;
+    queue->policy = policy;
+    queue->block_timeout_ms = block_timeout_ms;
+
+    atomic_init(&queue->enqueue_pos, 0);
+    atomic_init(&queue->dequeue_pos, 0);
+    atomic_init(&queue->dropped, 0);
+    atomic_init(&queue->overwritten, 0);
+
+    for (size_t loop_var = 0; loop_var < num_slots; loop_var++)
+    {
+        bytebeam_queue_slot_t *slot = queue_slot(queue, loop_var);
+
+        atomic_init(&slot->seq, loop_var);
+        slot->len = 0;
+    }
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_queue_deinit(bytebeam_queue_t *queue)
+{
+    if (queue == NULL)
+    {
+        return;
+    }
+
+    free(queue->slots);
+    queue->slots = NULL;
+}
+
+bytebeam_err_t bytebeam_queue_push(bytebeam_queue_t *queue, const char *data, size_t len)
+{
+    if (queue == NULL || data == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (len > queue->record_size)
+    {
+        BB_LOGE(TAG, "Record size %d exceeded queue record size %d", (int)len, (int)queue->record_size);
+        atomic_fetch_add(&queue->dropped, 1);
+        return BB_FAILURE;
+    }
+
+    size_t pos = 0;
+    uint32_t overwrite_waits = 0;
+    TickType_t start_tick = xTaskGetTickCount();
+
+    while (!queue_claim_push(queue, &pos))
+    {
+        switch (queue->policy)
+        {
+            case BYTEBEAM_QUEUE_POLICY_OVERWRITE:
+            {
+                size_t evict_pos = 0;
+                size_t used = bytebeam_queue_count(queue);
+
+                // discard the oldest record and claim again, another producer may take the freed slot first
+                if (used > queue->mask && queue_claim_pop(queue, &evict_pos))
+                {
+                    queue_release_pop(queue, evict_pos);
+                    atomic_fetch_add(&queue->overwritten, 1);
+                    break;
+                }
+
+                /*  Fewer than depth records outstanding means the slot we need is held by the consumer, and a failed
+                 *  eviction means another producer or the consumer got to the oldest record first. Either frees a
+                 *  slot shortly, so wait for it a bounded number of times before giving up on the record.
+                 */
+                if (overwrite_waits >= BYTEBEAM_QUEUE_OVERWRITE_YIELDS + BYTEBEAM_QUEUE_OVERWRITE_DELAYS)
+                {
+                    atomic_fetch_add(&queue->dropped, 1);
+                    return BB_FAILURE;
+                }
+
+                vTaskDelay((overwrite_waits++ < BYTEBEAM_QUEUE_OVERWRITE_YIELDS) ? 0 : 1);
+                break;
+            }
+
+            case BYTEBEAM_QUEUE_POLICY_BLOCK:
+                if ((xTaskGetTickCount() - start_tick) >= pdMS_TO_TICKS(queue->block_timeout_ms))
+                {
+                    atomic_fetch_add(&queue->dropped, 1);
+                    return BB_FAILURE;
+                }
+
+                vTaskDelay(1);
+                break;
+
+            default:
+                atomic_fetch_add(&queue->dropped, 1);
+                return BB_FAILURE;
+        }
+    }
+
+    bytebeam_queue_slot_t *slot = queue_slot(queue, pos);
+
+    memcpy(slot->data, data, len);
+    slot->len = len;
+
+    // publish the record to the consumer
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    return BB_SUCCESS;
+}
+
+bool bytebeam_queue_pop_begin(bytebeam_queue_t *queue, bytebeam_queue_item_t *item)
+{
+    size_t pos = 0;
+
+    if (queue == NULL || item == NULL)
+    {
+        return false;
+    }
+
+    if (!queue_claim_pop(queue, &pos))
+    {
+        return false;
+    }
+
+    bytebeam_queue_slot_t *slot = queue_slot(queue, pos);
+
+    item->data = slot->data;
+    item->len = slot->len;
+    item->pos = pos;
+
+    return true;
+}
+
+void bytebeam_queue_pop_end(bytebeam_queue_t *queue, bytebeam_queue_item_t *item)
+{
+    if (queue == NULL || item == NULL)
+    {
+        return;
+    }
+
+    queue_release_pop(queue, item->pos);
+
+    item->data = NULL;
+    item->len = 0;
+}
+
+size_t bytebeam_queue_count(bytebeam_queue_t *queue)
+{
+    if (queue == NULL)
+    {
+        return 0;
+    }
+
+    size_t enqueue_pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    size_t dequeue_pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+
+    return enqueue_pos - dequeue_pos;
+}
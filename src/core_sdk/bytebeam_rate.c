@@ -0,0 +1,171 @@
+#include "freertos/FreeRTOS.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_rate.h"
+
+/* tokens are kept in millionths of a byte, a microsecond of refill at one byte per second adds one */
+#define RATE_TOKENS_PER_BYTE 1000000LL
+
+/* bucket size of a limit, one second worth of the rate unless given */
+#define RATE_CAPACITY(rate, burst) ((int64_t)((burst) != 0 ? (burst) : (rate)) * RATE_TOKENS_PER_BYTE)
+
+static bytebeam_token_bucket_t rate_global_bucket = {
+    .rate = CONFIG_BYTEBEAM_RATE_GLOBAL_BYTES_PER_SEC,
+    .capacity = RATE_CAPACITY(CONFIG_BYTEBEAM_RATE_GLOBAL_BYTES_PER_SEC, CONFIG_BYTEBEAM_RATE_GLOBAL_BURST_BYTES),
+    .level = RATE_CAPACITY(CONFIG_BYTEBEAM_RATE_GLOBAL_BYTES_PER_SEC, CONFIG_BYTEBEAM_RATE_GLOBAL_BURST_BYTES),
+    .last_us = 0
+};
+
+static bytebeam_rate_policy_t rate_global_policy = CONFIG_BYTEBEAM_RATE_GLOBAL_POLICY;
+static bytebeam_rate_stats_t rate_stats = { 0 };
+static portMUX_TYPE rate_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static const char *TAG = "BYTEBEAM_RATE";
+
+static void rate_refill(bytebeam_token_bucket_t *bucket, long long now_us)
+{
+    // called with the lock held
+    long long elapsed_us = now_us - bucket->last_us;
+
+    bucket->last_us = now_us;
+
+    if (elapsed_us <= 0)
+    {
+        return;
+    }
+
+    // an idle bucket fills up, so the refill of a long pause is capped before it can overflow
+    int64_t fill_us = bucket->capacity / bucket->rate + 1;
+    int64_t level = bucket->level + (int64_t)((elapsed_us < fill_us) ? elapsed_us : fill_us) * bucket->rate;
+
+    bucket->level = (level < bucket->capacity) ? level : bucket->capacity;
+}
+
+static uint32_t rate_shortfall_ms(bytebeam_token_bucket_t *bucket, int64_t tokens, long long now_us)
+{
+    // called with the lock held, 0 if the bucket has the tokens
+    if (bucket == NULL || bucket->rate == 0)
+    {
+        return 0;
+    }
+
+    rate_refill(bucket, now_us);
+
+    // a publish larger than the bucket only needs it full
+    int64_t needed = (tokens < bucket->capacity) ? tokens : bucket->capacity;
+
+    if (bucket->level >= needed)
+    {
+        return 0;
+    }
+
+    return (uint32_t)((needed - bucket->level) / bucket->rate / 1000) + 1;
+}
+
+void bytebeam_token_bucket_init(bytebeam_token_bucket_t *bucket, const bytebeam_rate_limit_t *limit)
+{
+    taskENTER_CRITICAL(&rate_lock);
+
+    bucket->rate = limit->bytes_per_sec;
+    bucket->capacity = RATE_CAPACITY(limit->bytes_per_sec, limit->burst_bytes);
+    bucket->level = bucket->capacity;
+    bucket->last_us = bytebeam_hal_get_uptime_us();
+
+    taskEXIT_CRITICAL(&rate_lock);
+}
+
+bytebeam_err_t bytebeam_rate_set_global_limit(const bytebeam_rate_limit_t *limit)
+{
+    if (limit == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (limit->policy > BYTEBEAM_RATE_POLICY_SPILL)
+    {
+        BB_LOGE(TAG, "Rate limit policy %d is not supported", (int)limit->policy);
+        return BB_FAILURE;
+    }
+
+    bytebeam_token_bucket_init(&rate_global_bucket, limit);
+
+    taskENTER_CRITICAL(&rate_lock);
+    rate_global_policy = limit->policy;
+    taskEXIT_CRITICAL(&rate_lock);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_rate_policy_t bytebeam_rate_global_policy(void)
+{
+    return *(volatile bytebeam_rate_policy_t *)&rate_global_policy;
+}
+
+bytebeam_err_t bytebeam_rate_admit(bytebeam_token_bucket_t *bucket, bytebeam_publish_priority_t priority, size_t len, uint32_t *wait_ms)
+{
+    long long now_us = bytebeam_hal_get_uptime_us();
+    int64_t tokens = (int64_t)len * RATE_TOKENS_PER_BYTE;
+    bytebeam_token_bucket_t *global = (priority == BYTEBEAM_PRIORITY_BULK) ? &rate_global_bucket : NULL;
+
+    taskENTER_CRITICAL(&rate_lock);
+
+    uint32_t stream_wait_ms = rate_shortfall_ms(bucket, tokens, now_us);
+    uint32_t global_wait_ms = rate_shortfall_ms(global, tokens, now_us);
+
+    // the tokens are only taken once every bucket has them
+    if (stream_wait_ms == 0 && global_wait_ms == 0)
+    {
+        if (bucket != NULL && bucket->rate != 0)
+        {
+            bucket->level -= tokens;
+        }
+
+        if (global != NULL && global->rate != 0)
+        {
+            global->level -= tokens;
+        }
+    }
+
+    taskEXIT_CRITICAL(&rate_lock);
+
+    uint32_t shortfall_ms = (stream_wait_ms > global_wait_ms) ? stream_wait_ms : global_wait_ms;
+
+    if (wait_ms != NULL)
+    {
+        *wait_ms = shortfall_ms;
+    }
+
+    return (shortfall_ms == 0) ? BB_SUCCESS : BB_RATE_LIMITED;
+}
+
+void bytebeam_rate_account(bytebeam_rate_policy_t policy, bool replaced)
+{
+    taskENTER_CRITICAL(&rate_lock);
+
+    switch (policy)
+    {
+        case BYTEBEAM_RATE_POLICY_DROP     : rate_stats.dropped++;      break;
+        case BYTEBEAM_RATE_POLICY_COALESCE : rate_stats.coalesced++;    break;
+        case BYTEBEAM_RATE_POLICY_SPILL    : rate_stats.spilled++;      break;
+    }
+
+    if (replaced)
+    {
+        rate_stats.dropped++;
+    }
+
+    taskEXIT_CRITICAL(&rate_lock);
+}
+
+bytebeam_err_t bytebeam_rate_get_stats(bytebeam_rate_stats_t *stats)
+{
+    if (stats == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    taskENTER_CRITICAL(&rate_lock);
+    *stats = rate_stats;
+    taskEXIT_CRITICAL(&rate_lock);
+
+    return BB_SUCCESS;
+}
@@ -0,0 +1,854 @@
+#include <limits.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_stream.h"
+#include "bytebeam_json.h"
+#include "bytebeam_rate.h"
+#include "bytebeam_batch.h"
+#include "bytebeam_shadow.h"
+
+/* device shadow publishes waiting for their acknowledgement, the oldest one is forgotten beyond this */
+#define SHADOW_PENDING_PUBLISHES 4
+
+/* fields tracked for changes, the built in ones followed by the registered ones */
+#define SHADOW_TRACKED_FIELDS (SHADOW_FIELDS + CONFIG_DEVICE_SHADOW_MAX_FIELDS)
+#define SHADOW_MASK_WORDS ((SHADOW_TRACKED_FIELDS + 31) / 32)
+
+/* first retry of a failed device shadow publish, doubled with every failure up to the push interval */
+#define SHADOW_RETRY_MIN_MS 1000
+
+/* longest wait between the retries of a failed publish, also when the shadow is only pushed on request */
+#define SHADOW_RETRY_MAX_MS 60000
+
+/* room taken by a registered field in the shadow buffer, a longer string needs the custom json room */
+#define SHADOW_FIELD_JSON_LEN 64
+
+/* room for the static fields, the config strings may need escaping and the reset reason is at most 24 characters */
+#define SHADOW_STATIC_JSON_LEN (128 + 2 * (sizeof(CONFIG_DEVICE_SHADOW_STATUS) + sizeof(CONFIG_DEVICE_SHADOW_SOFTWARE_TYPE) +   \
+                                           sizeof(CONFIG_DEVICE_SHADOW_SOFTWARE_VERSION) + sizeof(CONFIG_DEVICE_SHADOW_HARDWARE_TYPE) + \
+                                           sizeof(CONFIG_DEVICE_SHADOW_HARDWARE_VERSION) + 24))
+
+/* This enum represents the fields of the device shadow tracked for changes, in publish order */
+typedef enum shadow_field {
+    SHADOW_FIELD_STATIC,                //!< Reset reason, status, software and hardware details, fixed at boot
+    SHADOW_FIELD_UPTIME,
+    SHADOW_FIELD_RATE_LIMIT_DROPS,
+    SHADOW_FIELD_RATE_LIMIT_SPILLS,
+    SHADOW_FIELD_CUSTOM,                //!< Custom json set by bytebeam_add_custom_device_shadow, as a whole
+    SHADOW_FIELDS
+} shadow_field_t;
+
+/**
+ * @struct shadow_acked_t
+ * This struct contains the last acknowledged value of a shadow field
+ * @var shadow_acked_t::known
+ * Set once a value of the field is acknowledged
+ * @var shadow_acked_t::hash
+ * Hash of the acknowledged value
+ * @var shadow_acked_t::sequence
+ * Sequence of the publish that carried it, an older acknowledgement arriving late does not replace it
+ */
+typedef struct shadow_acked {
+    bool known;
+    uint32_t hash;
+    uint64_t sequence;
+} shadow_acked_t;
+
+/**
+ * @struct shadow_pending_t
+ * This struct contains a device shadow publish waiting for its acknowledgement
+ * @var shadow_pending_t::in_use
+ * Set while the publish is waiting
+ * @var shadow_pending_t::sequence
+ * Sequence of the publish
+ * @var shadow_pending_t::sent_mask
+ * Fields carried by the publish, one bit per tracked field
+ * @var shadow_pending_t::hashes
+ * Hashes of the values of every field at the time of the publish
+ */
+typedef struct shadow_pending {
+    bool in_use;
+    uint64_t sequence;
+    uint32_t sent_mask[SHADOW_MASK_WORDS];
+    uint32_t hashes[SHADOW_TRACKED_FIELDS];
+} shadow_pending_t;
+
+/**
+ * @struct shadow_build_t
+ * This struct contains the state of a device shadow publish being written
+ * @var shadow_build_t::writer
+ * Writer of the message
+ * @var shadow_build_t::full
+ * Set if every field is written whatever its acknowledged value
+ * @var shadow_build_t::acked
+ * Acknowledged values as they were when the publish started
+ * @var shadow_build_t::pending
+ * Fields written so far and the hashes of every field
+ */
+typedef struct shadow_build {
+    bytebeam_json_writer_t writer;
+    bool full;
+    shadow_acked_t acked[SHADOW_TRACKED_FIELDS];
+    shadow_pending_t pending;
+} shadow_build_t;
+
+/**
+ * @struct shadow_custom_field_t
+ * This struct contains a field of the registry, merged into the device shadow record
+ * @var shadow_custom_field_t::key
+ * Key of the field, copied
+ * @var shadow_custom_field_t::value
+ * Value of the field, a string value is copied. Unused for a getter
+ * @var shadow_custom_field_t::hash
+ * Hash of the value, unused for a getter
+ * @var shadow_custom_field_t::getter
+ * Callback giving the value when the shadow is written, NULL for a set value
+ * @var shadow_custom_field_t::user_data
+ * User data passed to the getter
+ */
+typedef struct shadow_custom_field {
+    char *key;
+    bytebeam_shadow_value_t value;
+    uint32_t hash;
+    bytebeam_shadow_getter_t getter;
+    void *user_data;
+} shadow_custom_field_t;
+
+static shadow_custom_field_t shadow_fields[CONFIG_DEVICE_SHADOW_MAX_FIELDS];
+static int shadow_num_fields = 0;
+static SemaphoreHandle_t volatile shadow_fields_lock = NULL;
+
+static shadow_acked_t shadow_acked[SHADOW_TRACKED_FIELDS];
+static shadow_pending_t shadow_pending[SHADOW_PENDING_PUBLISHES];
+static portMUX_TYPE shadow_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// members of the fields that never change after boot, serialized once
+static char shadow_static_json[SHADOW_STATIC_JSON_LEN];
+static size_t shadow_static_len = 0;
+static uint32_t shadow_static_hash = 0;
+
+// only the task publishing the shadow reads the due time, the first publish is a full snapshot
+static long long shadow_snapshot_due_ms = 0;
+static atomic_bool shadow_snapshot_requested = false;
+
+// the schedule is run by the MQTT task, the other tasks only touch the atomics
+static bytebeam_client_t *volatile shadow_client = NULL;
+static atomic_uint shadow_interval_ms = CONFIG_DEVICE_SHADOW_PUSH_INTERVAL * 1000U;
+static atomic_bool shadow_publish_requested = false;
+static long long shadow_published_ms = 0;
+static long long shadow_retry_ms = 0;
+static uint32_t shadow_backoff_ms = SHADOW_RETRY_MIN_MS;
+
+static const char *TAG = "BYTEBEAM_SHADOW";
+
+static uint32_t shadow_hash(const void *data, size_t len)
+{
+    // FNV-1a, only for tracking what was acknowledged, a collision costs a field left out of the deltas until the
+    // next full snapshot
+    const uint8_t *bytes = data;
+    uint32_t hash = 2166136261u;
+
+    while (len-- > 0)
+    {
+        hash = (hash ^ *bytes++) * 16777619u;
+    }
+
+    return hash;
+}
+
+static uint32_t shadow_value_hash(const bytebeam_shadow_value_t *value)
+{
+    // the type is part of the value, 1 and "1" are different
+    uint32_t hash = shadow_hash(&value->type, sizeof(value->type));
+
+    switch (value->type)
+    {
+        case BYTEBEAM_SHADOW_TYPE_INT    : return hash ^ shadow_hash(&value->int_value, sizeof(value->int_value));
+        case BYTEBEAM_SHADOW_TYPE_FLOAT  : return hash ^ shadow_hash(&value->float_value, sizeof(value->float_value));
+        case BYTEBEAM_SHADOW_TYPE_STRING : return hash ^ shadow_hash(value->string_value, strlen(value->string_value));
+    }
+
+    return hash;
+}
+
+static bool shadow_value_equal(const bytebeam_shadow_value_t *a, const bytebeam_shadow_value_t *b)
+{
+    if (a->type != b->type)
+    {
+        return false;
+    }
+
+    switch (a->type)
+    {
+        case BYTEBEAM_SHADOW_TYPE_INT    : return a->int_value == b->int_value;
+        case BYTEBEAM_SHADOW_TYPE_FLOAT  : return !memcmp(&a->float_value, &b->float_value, sizeof(a->float_value));
+        case BYTEBEAM_SHADOW_TYPE_STRING : return !strcmp(a->string_value, b->string_value);
+    }
+
+    return false;
+}
+
+static bool shadow_wants(shadow_build_t *build, int field, uint32_t hash)
+{
+    build->pending.hashes[field] = hash;
+
+    if (!build->full && build->acked[field].known && build->acked[field].hash == hash)
+    {
+        return false;
+    }
+
+    build->pending.sent_mask[field / 32] |= 1u << (field % 32);
+
+    return true;
+}
+
+static void shadow_put_int(shadow_build_t *build, shadow_field_t field, const char *key, int64_t value)
+{
+    if (shadow_wants(build, field, shadow_hash(&value, sizeof(value))))
+    {
+        bytebeam_json_put_key(&build->writer, key);
+        bytebeam_json_put_int(&build->writer, value);
+    }
+}
+
+static void shadow_put_uint(shadow_build_t *build, shadow_field_t field, const char *key, uint64_t value)
+{
+    if (shadow_wants(build, field, shadow_hash(&value, sizeof(value))))
+    {
+        bytebeam_json_put_key(&build->writer, key);
+        bytebeam_json_put_uint(&build->writer, value);
+    }
+}
+
+static void shadow_track(const shadow_pending_t *pending)
+{
+    taskENTER_CRITICAL(&shadow_lock);
+
+    shadow_pending_t *slot = &shadow_pending[0];
+
+    // a free slot, otherwise the oldest publish, its fields simply go out again
+    for (int loop_var = 0; loop_var < SHADOW_PENDING_PUBLISHES; loop_var++)
+    {
+        if (!shadow_pending[loop_var].in_use)
+        {
+            slot = &shadow_pending[loop_var];
+            break;
+        }
+
+        if (shadow_pending[loop_var].sequence < slot->sequence)
+        {
+            slot = &shadow_pending[loop_var];
+        }
+    }
+
+    *slot = *pending;
+    slot->in_use = true;
+
+    taskEXIT_CRITICAL(&shadow_lock);
+}
+
+static void shadow_complete(uint32_t sequence, bool delivered)
+{
+    taskENTER_CRITICAL(&shadow_lock);
+
+    for (int loop_var = 0; loop_var < SHADOW_PENDING_PUBLISHES; loop_var++)
+    {
+        shadow_pending_t *pending = &shadow_pending[loop_var];
+
+        if (!pending->in_use || (uint32_t)pending->sequence != sequence)
+        {
+            continue;
+        }
+
+        for (int field = 0; delivered && field < SHADOW_TRACKED_FIELDS; field++)
+        {
+            shadow_acked_t *acked = &shadow_acked[field];
+            bool sent = pending->sent_mask[field / 32] & (1u << (field % 32));
+
+            if (sent && (!acked->known || pending->sequence > acked->sequence))
+            {
+                acked->known = true;
+                acked->hash = pending->hashes[field];
+                acked->sequence = pending->sequence;
+            }
+        }
+
+        pending->in_use = false;
+        break;
+    }
+
+    taskEXIT_CRITICAL(&shadow_lock);
+}
+
+static void shadow_publish_done(int msg_id, bytebeam_publish_status_t status, uint32_t latency_ms, void *user_data)
+{
+    // a stored or timed out shadow is not known to have reached the platform, its fields go out again
+    shadow_complete((uint32_t)(uintptr_t)user_data, status == BYTEBEAM_PUBLISH_ACKED || status == BYTEBEAM_PUBLISH_SENT);
+}
+
+bytebeam_err_t bytebeam_shadow_init(bytebeam_client_t *bytebeam_client)
+{
+    bytebeam_json_writer_t writer;
+    size_t static_len = 0;
+
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    switch(bytebeam_hal_get_reset_reason()) {
+        case BB_RST_UNKNOWN   : bytebeam_client->device_shadow.stream.reboot_reason = "Unknown Reset";            break;
+        case BB_RST_POWERON   : bytebeam_client->device_shadow.stream.reboot_reason = "Power On Reset";           break;
+        case BB_RST_EXT       : bytebeam_client->device_shadow.stream.reboot_reason = "External Pin Reset";       break;
+        case BB_RST_SW        : bytebeam_client->device_shadow.stream.reboot_reason = "Software Reset";           break;
+        case BB_RST_PANIC     : bytebeam_client->device_shadow.stream.reboot_reason = "Hard Fault Reset";         break;
+        case BB_RST_INT_WDT   : bytebeam_client->device_shadow.stream.reboot_reason = "Interrupt Watchdog Reset"; break;
+        case BB_RST_TASK_WDT  : bytebeam_client->device_shadow.stream.reboot_reason = "Task Watchdog Reset";      break;
+        case BB_RST_WDT       : bytebeam_client->device_shadow.stream.reboot_reason = "Other Watchdog Reset";     break;
+        case BB_RST_DEEPSLEEP : bytebeam_client->device_shadow.stream.reboot_reason = "Exiting Deep Sleep Reset"; break;
+        case BB_RST_BROWNOUT  : bytebeam_client->device_shadow.stream.reboot_reason = "Brownout Reset";           break;
+        case BB_RST_SDIO      : bytebeam_client->device_shadow.stream.reboot_reason = "SDIO Reset";               break;
+
+        default: bytebeam_client->device_shadow.stream.reboot_reason = "Unknown Reset Id";
+    }
+
+    // get the device shadow status, software and hardware details from config menu
+    bytebeam_client->device_shadow.stream.status = CONFIG_DEVICE_SHADOW_STATUS;
+    bytebeam_client->device_shadow.stream.software_type = CONFIG_DEVICE_SHADOW_SOFTWARE_TYPE;
+    bytebeam_client->device_shadow.stream.software_version = CONFIG_DEVICE_SHADOW_SOFTWARE_VERSION;
+    bytebeam_client->device_shadow.stream.hardware_type = CONFIG_DEVICE_SHADOW_HARDWARE_TYPE;
+    bytebeam_client->device_shadow.stream.hardware_version = CONFIG_DEVICE_SHADOW_HARDWARE_VERSION;
+
+    // written as a map, only the members between the braces are kept
+    bytebeam_json_writer_init(&writer, shadow_static_json, sizeof(shadow_static_json));
+    bytebeam_json_begin_map(&writer);
+    bytebeam_json_put_key(&writer, "Reset_Reason");
+    bytebeam_json_put_string(&writer, bytebeam_client->device_shadow.stream.reboot_reason);
+    bytebeam_json_put_key(&writer, "Status");
+    bytebeam_json_put_string(&writer, bytebeam_client->device_shadow.stream.status);
+    bytebeam_json_put_key(&writer, "Software_Type");
+    bytebeam_json_put_string(&writer, bytebeam_client->device_shadow.stream.software_type);
+    bytebeam_json_put_key(&writer, "Software_Version");
+    bytebeam_json_put_string(&writer, bytebeam_client->device_shadow.stream.software_version);
+    bytebeam_json_put_key(&writer, "Hardware_Type");
+    bytebeam_json_put_string(&writer, bytebeam_client->device_shadow.stream.hardware_type);
+    bytebeam_json_put_key(&writer, "Hardware_Version");
+    bytebeam_json_put_string(&writer, bytebeam_client->device_shadow.stream.hardware_version);
+    bytebeam_json_end(&writer);
+
+    if (bytebeam_json_writer_finish(&writer, &static_len) != BB_SUCCESS)
+    {
+        BB_LOGE(TAG, "Device shadow static fields exceeded buffer size");
+        return BB_FAILURE;
+    }
+
+    memmove(shadow_static_json, shadow_static_json + 1, static_len - 2);
+    shadow_static_len = static_len - 2;
+    shadow_static_hash = shadow_hash(shadow_static_json, shadow_static_len);
+
+    // the MQTT task publishes for this client from now on
+    shadow_client = bytebeam_client;
+
+    return BB_SUCCESS;
+}
+
+static SemaphoreHandle_t shadow_fields_mutex(void)
+{
+    if (shadow_fields_lock != NULL)
+    {
+        return shadow_fields_lock;
+    }
+
+    SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+
+    if (lock == NULL)
+    {
+        BB_LOGE(TAG, "Failed to create the shadow fields lock");
+        return NULL;
+    }
+
+    taskENTER_CRITICAL(&shadow_lock);
+
+    SemaphoreHandle_t created = shadow_fields_lock;
+
+    if (created == NULL)
+    {
+        shadow_fields_lock = lock;
+    }
+
+    taskEXIT_CRITICAL(&shadow_lock);
+
+    // another task created it meanwhile
+    if (created != NULL)
+    {
+        vSemaphoreDelete(lock);
+        return created;
+    }
+
+    return lock;
+}
+
+static bytebeam_err_t shadow_set(const char *key, const bytebeam_shadow_value_t *value, bytebeam_shadow_getter_t getter, void *user_data)
+{
+    if (key == NULL || (value != NULL && value->type == BYTEBEAM_SHADOW_TYPE_STRING && value->string_value == NULL))
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (key[0] == '\0' || !strcmp(key, "timestamp") || !strcmp(key, "sequence"))
+    {
+        BB_LOGE(TAG, "Shadow field key \"%s\" is reserved", key);
+        return BB_FAILURE;
+    }
+
+    SemaphoreHandle_t lock = shadow_fields_mutex();
+
+    if (lock == NULL)
+    {
+        return BB_FAILURE;
+    }
+
+    bytebeam_err_t err_code = BB_SUCCESS;
+    shadow_custom_field_t *field = NULL;
+    uint32_t hash = (value != NULL) ? shadow_value_hash(value) : 0;
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (int loop_var = 0; loop_var < shadow_num_fields; loop_var++)
+    {
+        if (!strcmp(shadow_fields[loop_var].key, key))
+        {
+            field = &shadow_fields[loop_var];
+            break;
+        }
+    }
+
+    // setting the same value again is the common case, it costs a compare and nothing else
+    if (field != NULL && value != NULL && field->getter == NULL && shadow_value_equal(&field->value, value))
+    {
+        xSemaphoreGive(lock);
+        return BB_SUCCESS;
+    }
+
+    char *string_copy = NULL;
+
+    if (value != NULL && value->type == BYTEBEAM_SHADOW_TYPE_STRING)
+    {
+        string_copy = strdup(value->string_value);
+
+        if (string_copy == NULL)
+        {
+            BB_LOGE(TAG, "Failed to allocate the memory for shadow field %s", key);
+            err_code = BB_FAILURE;
+        }
+    }
+
+    if (err_code == BB_SUCCESS && field == NULL)
+    {
+        if (shadow_num_fields == CONFIG_DEVICE_SHADOW_MAX_FIELDS)
+        {
+            BB_LOGE(TAG, "All %d shadow fields are in use", CONFIG_DEVICE_SHADOW_MAX_FIELDS);
+            err_code = BB_FAILURE;
+        }
+        else if ((shadow_fields[shadow_num_fields].key = strdup(key)) == NULL)
+        {
+            BB_LOGE(TAG, "Failed to allocate the memory for shadow field %s", key);
+            err_code = BB_FAILURE;
+        }
+        else
+        {
+            field = &shadow_fields[shadow_num_fields++];
+            field->value.type = BYTEBEAM_SHADOW_TYPE_INT;
+        }
+    }
+
+    if (err_code != BB_SUCCESS)
+    {
+        xSemaphoreGive(lock);
+        free(string_copy);
+        return err_code;
+    }
+
+    char *replaced = (field->value.type == BYTEBEAM_SHADOW_TYPE_STRING) ? (char *)field->value.string_value : NULL;
+
+    if (value != NULL)
+    {
+        field->value = *value;
+
+        if (value->type == BYTEBEAM_SHADOW_TYPE_STRING)
+        {
+            field->value.string_value = string_copy;
+        }
+    }
+    else
+    {
+        field->value.type = BYTEBEAM_SHADOW_TYPE_INT;
+    }
+
+    field->hash = hash;
+    field->getter = getter;
+    field->user_data = user_data;
+
+    xSemaphoreGive(lock);
+
+    free(replaced);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_shadow_set_int(const char *key, int64_t value)
+{
+    bytebeam_shadow_value_t shadow_value = { .type = BYTEBEAM_SHADOW_TYPE_INT, .int_value = value };
+
+    return shadow_set(key, &shadow_value, NULL, NULL);
+}
+
+bytebeam_err_t bytebeam_shadow_set_float(const char *key, double value)
+{
+    bytebeam_shadow_value_t shadow_value = { .type = BYTEBEAM_SHADOW_TYPE_FLOAT, .float_value = value };
+
+    return shadow_set(key, &shadow_value, NULL, NULL);
+}
+
+bytebeam_err_t bytebeam_shadow_set_string(const char *key, const char *value)
+{
+    bytebeam_shadow_value_t shadow_value = { .type = BYTEBEAM_SHADOW_TYPE_STRING, .string_value = value };
+
+    return shadow_set(key, &shadow_value, NULL, NULL);
+}
+
+bytebeam_err_t bytebeam_shadow_set_getter(const char *key, bytebeam_shadow_getter_t getter, void *user_data)
+{
+    if (getter == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    return shadow_set(key, NULL, getter, user_data);
+}
+
+static void shadow_put_fields(shadow_build_t *build)
+{
+    SemaphoreHandle_t lock = shadow_fields_lock;
+
+    // nothing was ever registered
+    if (lock == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(lock, portMAX_DELAY);
+
+    for (int loop_var = 0; loop_var < shadow_num_fields; loop_var++)
+    {
+        shadow_custom_field_t *field = &shadow_fields[loop_var];
+        bytebeam_shadow_value_t value = field->value;
+        uint32_t hash = field->hash;
+
+        if (field->getter != NULL)
+        {
+            // a field the getter has no value for is left out of this publish
+            if (field->getter(field->key, &value, field->user_data) != BB_SUCCESS ||
+                (value.type == BYTEBEAM_SHADOW_TYPE_STRING && value.string_value == NULL))
+            {
+                continue;
+            }
+
+            hash = shadow_value_hash(&value);
+        }
+
+        if (!shadow_wants(build, SHADOW_FIELDS + loop_var, hash))
+        {
+            continue;
+        }
+
+        bytebeam_json_put_key(&build->writer, field->key);
+
+        switch (value.type)
+        {
+            case BYTEBEAM_SHADOW_TYPE_INT    : bytebeam_json_put_int(&build->writer, value.int_value);         break;
+            case BYTEBEAM_SHADOW_TYPE_FLOAT  : bytebeam_json_put_double(&build->writer, value.float_value);     break;
+            case BYTEBEAM_SHADOW_TYPE_STRING : bytebeam_json_put_string(&build->writer, value.string_value);    break;
+        }
+    }
+
+    xSemaphoreGive(lock);
+}
+
+void bytebeam_shadow_request_snapshot(void)
+{
+    atomic_store(&shadow_snapshot_requested, true);
+}
+
+static bytebeam_err_t shadow_publish(bytebeam_client_t *bytebeam_client)
+{
+    // only called by the MQTT task, which owns the buffer and the build state
+    bytebeam_err_t ret_val = 0;
+    bytebeam_stream_handle_t handle = NULL;
+    static char device_shadow_json_str[512 + CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN + CONFIG_DEVICE_SHADOW_MAX_FIELDS * SHADOW_FIELD_JSON_LEN] = "";
+    static shadow_build_t build;
+
+    size_t device_shadow_json_len = 0;
+
+    if(shadow_static_len == 0 && bytebeam_shadow_init(bytebeam_client) != BB_SUCCESS)
+    {
+        return BB_FAILURE;
+    }
+
+    bytebeam_client->device_shadow.stream.milliseconds = bytebeam_hal_get_epoch_millis();
+
+    if(bytebeam_client->device_shadow.stream.milliseconds == 0)
+    {
+        BB_LOGE(TAG, "failed to get epoch millis.");
+        return -1;
+    }
+
+    bytebeam_client->device_shadow.stream.sequence++;
+
+    bytebeam_client->device_shadow.stream.uptime = bytebeam_hal_get_uptime_ms();
+
+    long long now_ms = bytebeam_client->device_shadow.stream.uptime;
+
+    // the full snapshot lets the platform recover whatever state it lost, the fields in between only go out on change
+    build.full = atomic_exchange(&shadow_snapshot_requested, false) || CONFIG_DEVICE_SHADOW_SNAPSHOT_INTERVAL == 0 || now_ms >= shadow_snapshot_due_ms;
+
+    if (build.full)
+    {
+        shadow_snapshot_due_ms = now_ms + CONFIG_DEVICE_SHADOW_SNAPSHOT_INTERVAL * 1000LL;
+    }
+
+    taskENTER_CRITICAL(&shadow_lock);
+    memcpy(build.acked, shadow_acked, sizeof(shadow_acked));
+    taskEXIT_CRITICAL(&shadow_lock);
+
+    memset(&build.pending, 0, sizeof(build.pending));
+    build.pending.sequence = bytebeam_client->device_shadow.stream.sequence;
+
+    // call the device shadow updater if exists, it may set the registered fields or the custom json
+    if(bytebeam_client->device_shadow.updater != NULL)
+    {
+        bytebeam_client->device_shadow.updater(bytebeam_client);
+    }
+
+    bytebeam_rate_stats_t rate_stats;
+
+    bytebeam_rate_get_stats(&rate_stats);
+
+    // the shadow is written straight into the static buffer, nothing is allocated
+    bytebeam_json_writer_init(&build.writer, device_shadow_json_str, sizeof(device_shadow_json_str));
+    bytebeam_json_begin_array(&build.writer);
+    bytebeam_json_begin_map(&build.writer);
+    bytebeam_json_put_key(&build.writer, "timestamp");
+    bytebeam_json_put_uint(&build.writer, bytebeam_client->device_shadow.stream.milliseconds);
+    bytebeam_json_put_key(&build.writer, "sequence");
+    bytebeam_json_put_uint(&build.writer, bytebeam_client->device_shadow.stream.sequence);
+
+    // the fields fixed at boot are copied as serialized by bytebeam_shadow_init
+    if (shadow_wants(&build, SHADOW_FIELD_STATIC, shadow_static_hash))
+    {
+        bytebeam_json_put_raw(&build.writer, shadow_static_json, shadow_static_len);
+    }
+
+    shadow_put_int(&build, SHADOW_FIELD_UPTIME, "Uptime", bytebeam_client->device_shadow.stream.uptime);
+
+    // publishes lost to the rate limits show up on the platform alongside the device health
+    shadow_put_uint(&build, SHADOW_FIELD_RATE_LIMIT_DROPS, "Rate_Limit_Drops", rate_stats.dropped);
+    shadow_put_uint(&build, SHADOW_FIELD_RATE_LIMIT_SPILLS, "Rate_Limit_Spills", rate_stats.spilled);
+
+    // the registered fields are merged into the same record
+    shadow_put_fields(&build);
+    bytebeam_json_end(&build.writer);
+
+    size_t custom_json_len = strlen(bytebeam_client->device_shadow.custom_json_str);
+
+    // add any additional json if provided, it is tracked as a whole
+    if(custom_json_len != 0 && shadow_wants(&build, SHADOW_FIELD_CUSTOM, shadow_hash(bytebeam_client->device_shadow.custom_json_str, custom_json_len)))
+    {
+        bytebeam_json_put_raw(&build.writer, bytebeam_client->device_shadow.custom_json_str, custom_json_len);
+    }
+
+    bytebeam_json_end(&build.writer);
+
+    if(bytebeam_json_writer_finish(&build.writer, &device_shadow_json_len) != BB_SUCCESS)
+    {
+        BB_LOGE(TAG, "Device shadow exceeded buffer size");
+        return -1;
+    }
+
+    BB_LOGI(TAG, "\nStatus to send:\n%s\n", device_shadow_json_str);
+
+    ret_val = bytebeam_stream_open(bytebeam_client, BYTEBEAM_SHADOW_STREAM, &handle);
+
+    if(ret_val != BB_SUCCESS)
+    {
+        return ret_val;
+    }
+
+    // tracked before the publish, a QoS 0 or stored publish completes before it returns
+    shadow_track(&build.pending);
+
+    // the shadow stream publishes through the outbox, so the MQTT task never waits on the network here
+    ret_val = bytebeam_stream_publish_with_callback(handle, BYTEBEAM_ENCODING_JSON, device_shadow_json_str, device_shadow_json_len,
+                                                    shadow_publish_done, (void *)(uintptr_t)build.pending.sequence);
+
+    if(ret_val != BB_SUCCESS)
+    {
+        shadow_complete((uint32_t)build.pending.sequence, false);
+
+        // the snapshot is owed until one goes out
+        if(build.full)
+        {
+            bytebeam_shadow_request_snapshot();
+        }
+    }
+
+    return ret_val;
+}
+
+bytebeam_err_t bytebeam_add_custom_device_shadow(bytebeam_client_t *bytebeam_client, char *custom_json_str)
+{
+    if(bytebeam_client == NULL || custom_json_str == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if(strlen(custom_json_str) >= CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN)
+    {
+        BB_LOGE(TAG, "Custom json size exceeded buffer size");
+        return BB_FAILURE;
+    }
+
+    memset(bytebeam_client->device_shadow.custom_json_str, 0x00, CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN);
+    strcpy(bytebeam_client->device_shadow.custom_json_str, custom_json_str);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_register_device_shadow_updater(bytebeam_client_t *bytebeam_client, int (*func_ptr)(bytebeam_client_t *))
+{
+    if(bytebeam_client == NULL || func_ptr == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    bytebeam_client->device_shadow.updater = func_ptr;
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_publish_device_shadow(bytebeam_client_t *bytebeam_client)
+{
+    if(bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    // the MQTT task builds and sends the shadow, so the caller never touches its buffers
+    bytebeam_shadow_request_publish();
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_shadow_deinit(void)
+{
+    shadow_client = NULL;
+}
+
+void bytebeam_shadow_request_publish(void)
+{
+    atomic_store(&shadow_publish_requested, true);
+
+    bytebeam_mqtt_thread_wake();
+}
+
+bytebeam_err_t bytebeam_shadow_set_interval(uint32_t interval_sec)
+{
+    if (interval_sec > UINT32_MAX / 1000)
+    {
+        BB_LOGE(TAG, "Device shadow interval of %u seconds is too long", (unsigned)interval_sec);
+        return BB_FAILURE;
+    }
+
+    atomic_store(&shadow_interval_ms, interval_sec * 1000);
+
+    // the next push is due a new interval after the last one
+    bytebeam_mqtt_thread_wake();
+
+    return BB_SUCCESS;
+}
+
+static long long shadow_due_ms(void)
+{
+    // called by the MQTT task, LLONG_MAX if nothing is due until a request
+    uint32_t interval_ms = atomic_load(&shadow_interval_ms);
+
+    if (shadow_retry_ms != 0)
+    {
+        return shadow_retry_ms;
+    }
+
+    return (interval_ms != 0) ? shadow_published_ms + interval_ms : LLONG_MAX;
+}
+
+bytebeam_err_t bytebeam_shadow_poll(uint32_t *next_ms)
+{
+    if (next_ms == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    *next_ms = UINT32_MAX;
+
+    bytebeam_client_t *bytebeam_client = shadow_client;
+
+    if (bytebeam_client == NULL)
+    {
+        return BB_FAILURE;
+    }
+
+    // nothing goes out while offline, the connection requests a publish once it is back
+    if (bytebeam_client->connection_status == 0)
+    {
+        return BB_SUCCESS;
+    }
+
+    bytebeam_err_t err_code = BB_SUCCESS;
+    long long now_ms = bytebeam_hal_get_uptime_ms();
+
+    if (atomic_exchange(&shadow_publish_requested, false) || now_ms >= shadow_due_ms())
+    {
+        BB_LOGI(TAG, "Device Shadow Message.\n");
+
+        err_code = shadow_publish(bytebeam_client);
+
+        if (err_code == BB_SUCCESS)
+        {
+            shadow_published_ms = now_ms;
+            shadow_retry_ms = 0;
+            shadow_backoff_ms = SHADOW_RETRY_MIN_MS;
+        }
+        else
+        {
+            BB_LOGE(TAG, "Failed to push Device Shadow Seq : %llu, retrying in %u ms\n",
+                     bytebeam_client->device_shadow.stream.sequence, (unsigned)shadow_backoff_ms);
+
+            uint32_t interval_ms = atomic_load(&shadow_interval_ms);
+            uint32_t max_backoff_ms = (interval_ms != 0 && interval_ms < SHADOW_RETRY_MAX_MS) ? interval_ms : SHADOW_RETRY_MAX_MS;
+
+            // a full outbox or a rate limit clears up by itself, the retries slow down while it lasts
+            shadow_retry_ms = now_ms + shadow_backoff_ms;
+            shadow_backoff_ms = (shadow_backoff_ms * 2 < max_backoff_ms) ? shadow_backoff_ms * 2 : max_backoff_ms;
+        }
+    }
+
+    long long due_ms = shadow_due_ms();
+
+    if (due_ms != LLONG_MAX)
+    {
+        *next_ms = (due_ms <= now_ms) ? 0 : (uint32_t)((due_ms - now_ms < UINT32_MAX) ? due_ms - now_ms : UINT32_MAX - 1);
+    }
+
+    return err_code;
+}
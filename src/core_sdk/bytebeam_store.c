@@ -0,0 +1,533 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <strings.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "bytebeam_hal.h"
+#include "bytebeam_stream.h"
+#include "bytebeam_store.h"
+
+#if CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED
+
+/*
+ *  The store is a ring of append only segment files named after a monotonic segment id. Publishes are appended to
+ *  the newest segment, drained from the oldest one and a segment is deleted once fully drained, so every flash page
+ *  is written once per lap and no cursor is ever rewritten in place. Each record carries a CRC over its header and
+ *  contents, a record that fails the check ends its segment. After a reset the writer always starts a new segment,
+ *  so a torn tail is never appended to and is simply skipped by the reader.
+ */
+
+/* magic number marking the start of a stored record */
+#define STORE_RECORD_MAGIC 0xBB5Au
+
+/* delay before a failed drain publish is tried again */
+#define STORE_DRAIN_RETRY_MS 1000
+
+/* longest segment file path, base path + '/' + 8 hex digits + ".seg" */
+#define STORE_PATH_STR_LEN (sizeof(BYTEBEAM_STORE_BASE_PATH) + 13)
+
+/**
+ * @struct store_record_header_t
+ * This struct is written in front of every stored record, followed by the stream name and the payload
+ * @var store_record_header_t::magic
+ * Always STORE_RECORD_MAGIC
+ * @var store_record_header_t::stream_len
+ * Length of the stream name in bytes, without the NULL character
+ * @var store_record_header_t::encoding
+ * Encoding of the payload
+ * @var store_record_header_t::payload_len
+ * Length of the payload in bytes
+ * @var store_record_header_t::crc
+ * CRC32 of the fields above, the stream name and the payload
+ */
+typedef struct store_record_header {
+    uint16_t magic;
+    uint8_t stream_len;
+    uint8_t encoding;
+    uint32_t payload_len;
+    uint32_t crc;
+} store_record_header_t;
+
+static bytebeam_client_t *store_client = NULL;
+static SemaphoreHandle_t store_lock = NULL;
+
+// segments [store_read_id, store_write_id) are sealed, store_write_id is the one being written
+static uint32_t store_read_id = 0;
+static uint32_t store_write_id = 0;
+
+static FILE *store_write_file = NULL;
+static size_t store_write_len = 0;
+
+static FILE *store_read_file = NULL;
+static long store_read_offset = 0;
+
+static atomic_bool store_pending = false;
+static TickType_t store_drain_tick = 0;
+static uint32_t store_evicted_segments = 0;
+
+static const char *TAG = "BYTEBEAM_STORE";
+
+static void store_segment_path(char *path, uint32_t segment_id)
+{
+    snprintf(path, STORE_PATH_STR_LEN, "%s/%08" PRIx32 ".seg", BYTEBEAM_STORE_BASE_PATH, segment_id);
+}
+
+static int store_mount(void)
+{
+#if CONFIG_BYTEBEAM_STORE_FILESYSTEM_IS_SPIFFS
+    return bytebeam_hal_spiffs_mount_partition(BYTEBEAM_STORE_BASE_PATH, CONFIG_BYTEBEAM_STORE_PARTITION_LABEL, 2);
+#else
+    return bytebeam_hal_fatfs_mount_partition(BYTEBEAM_STORE_BASE_PATH, CONFIG_BYTEBEAM_STORE_PARTITION_LABEL, false);
+#endif
+}
+
+static int store_unmount(void)
+{
+#if CONFIG_BYTEBEAM_STORE_FILESYSTEM_IS_SPIFFS
+    return bytebeam_hal_spiffs_unmount_partition(CONFIG_BYTEBEAM_STORE_PARTITION_LABEL);
+#else
+    return bytebeam_hal_fatfs_unmount_partition(BYTEBEAM_STORE_BASE_PATH, CONFIG_BYTEBEAM_STORE_PARTITION_LABEL, false);
+#endif
+}
+
+static uint32_t store_record_crc(const store_record_header_t *header, const char *stream_name, const void *payload)
+{
+    uint32_t crc = bytebeam_hal_crc32(0, header, offsetof(store_record_header_t, crc));
+
+    crc = bytebeam_hal_crc32(crc, stream_name, header->stream_len);
+    crc = bytebeam_hal_crc32(crc, payload, header->payload_len);
+
+    return crc;
+}
+
+static void store_remove_segment(uint32_t segment_id)
+{
+    char path[STORE_PATH_STR_LEN];
+
+    store_segment_path(path, segment_id);
+    remove(path);
+}
+
+static void store_seal_segment(void)
+{
+    if (store_write_file == NULL)
+    {
+        return;
+    }
+
+    fclose(store_write_file);
+
+    store_write_file = NULL;
+    store_write_len = 0;
+    store_write_id++;
+}
+
+static int store_open_segment(void)
+{
+    char path[STORE_PATH_STR_LEN];
+
+    // make room for the new segment by evicting the oldest ones
+    while (store_write_id - store_read_id >= CONFIG_BYTEBEAM_STORE_MAX_SEGMENTS)
+    {
+        if (store_read_file != NULL)
+        {
+            fclose(store_read_file);
+            store_read_file = NULL;
+        }
+
+        store_remove_segment(store_read_id);
+        store_read_id++;
+        store_evicted_segments++;
+
+        BB_LOGW(TAG, "Store is full, evicted the oldest segment (%u evicted so far)", (unsigned)store_evicted_segments);
+    }
+
+    store_segment_path(path, store_write_id);
+    store_write_file = fopen(path, "wb");
+
+    if (store_write_file == NULL)
+    {
+        BB_LOGE(TAG, "Failed to open segment %s for writing", path);
+        return -1;
+    }
+
+    store_write_len = 0;
+
+    return 0;
+}
+
+static int store_scan_segments(void)
+{
+    bool found = false;
+    uint32_t min_id = 0;
+    uint32_t max_id = 0;
+    struct dirent *entry = NULL;
+
+    DIR *dir = opendir(BYTEBEAM_STORE_BASE_PATH);
+
+    if (dir == NULL)
+    {
+        BB_LOGE(TAG, "Failed to open the store directory");
+        return -1;
+    }
+
+    while ((entry = readdir(dir)) != NULL)
+    {
+        uint32_t segment_id = 0;
+        char extension[4] = "";
+
+        if (sscanf(entry->d_name, "%8" SCNx32 ".%3s", &segment_id, extension) != 2 || strcasecmp(extension, "seg") != 0)
+        {
+            continue;
+        }
+
+        // segment ids are compared relative to each other so the ring survives the id wrapping around
+        if (!found || (int32_t)(segment_id - min_id) < 0)
+        {
+            min_id = segment_id;
+        }
+
+        if (!found || (int32_t)(segment_id - max_id) > 0)
+        {
+            max_id = segment_id;
+        }
+
+        found = true;
+    }
+
+    closedir(dir);
+
+    if (found)
+    {
+        store_read_id = min_id;
+        store_write_id = max_id + 1;
+
+        BB_LOGI(TAG, "Recovered %u stored segments", (unsigned)(store_write_id - store_read_id));
+    }
+    else
+    {
+        store_read_id = 0;
+        store_write_id = 0;
+    }
+
+    atomic_store(&store_pending, found);
+
+    return 0;
+}
+
+static int store_read_record(store_record_header_t *header, char *stream_name, char **payload)
+{
+    char *data = NULL;
+
+    if (fread(header, sizeof(store_record_header_t), 1, store_read_file) != 1)
+    {
+        // clean end of the segment or a torn header
+        return 0;
+    }
+
+    if (header->magic != STORE_RECORD_MAGIC || header->payload_len > CONFIG_BYTEBEAM_STORE_SEGMENT_SIZE)
+    {
+        BB_LOGW(TAG, "Skipping the corrupted tail of segment %08" PRIx32, store_read_id);
+        return 0;
+    }
+
+    data = malloc(header->payload_len + 1);
+
+    if (data == NULL)
+    {
+        BB_LOGE(TAG, "Failed to allocate the memory for a stored record");
+
+        // keep the record, it is read again on the next drain
+        fseek(store_read_file, store_read_offset, SEEK_SET);
+        return -1;
+    }
+
+    if (fread(stream_name, 1, header->stream_len, store_read_file) != header->stream_len ||
+        fread(data, 1, header->payload_len, store_read_file) != header->payload_len ||
+        store_record_crc(header, stream_name, data) != header->crc)
+    {
+        BB_LOGW(TAG, "Skipping the corrupted tail of segment %08" PRIx32, store_read_id);
+
+        free(data);
+        return 0;
+    }
+
+    stream_name[header->stream_len] = '\0';
+    data[header->payload_len] = '\0';
+
+    *payload = data;
+
+    return 1;
+}
+
+static bytebeam_err_t store_drain_record(void)
+{
+    char path[STORE_PATH_STR_LEN];
+    char stream_name[BYTEBEAM_STORE_STREAM_STR_LEN + 1];
+    char *payload = NULL;
+    store_record_header_t header;
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+
+    while (1)
+    {
+        if (store_read_file == NULL)
+        {
+            if (store_read_id == store_write_id)
+            {
+                if (store_write_len == 0)
+                {
+                    // everything is drained
+                    atomic_store(&store_pending, false);
+                    xSemaphoreGive(store_lock);
+                    return BB_SUCCESS;
+                }
+
+                // never read the segment being written, seal it so new records go to the next one
+                store_seal_segment();
+            }
+
+            store_segment_path(path, store_read_id);
+            store_read_file = fopen(path, "rb");
+
+            if (store_read_file == NULL)
+            {
+                store_read_id++;
+                continue;
+            }
+
+            store_read_offset = 0;
+        }
+
+        int ret_val = store_read_record(&header, stream_name, &payload);
+
+        if (ret_val > 0)
+        {
+            break;
+        }
+
+        if (ret_val < 0)
+        {
+            xSemaphoreGive(store_lock);
+            return BB_FAILURE;
+        }
+
+        // the whole segment is delivered, it is only now safe to delete it
+        fclose(store_read_file);
+        store_read_file = NULL;
+
+        store_remove_segment(store_read_id);
+        store_read_id++;
+    }
+
+    uint32_t segment_id = store_read_id;
+    long next_offset = ftell(store_read_file);
+
+    // publish without holding the lock, the writers may evict this segment meanwhile
+    xSemaphoreGive(store_lock);
+
+    bytebeam_err_t err_code = bytebeam_publish_stored_to_stream(store_client, stream_name, (bytebeam_encoding_t)header.encoding, payload, header.payload_len);
+
+    free(payload);
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+
+    if (store_read_file != NULL && store_read_id == segment_id)
+    {
+        if (err_code == BB_SUCCESS)
+        {
+            store_read_offset = next_offset;
+        }
+        else
+        {
+            fseek(store_read_file, store_read_offset, SEEK_SET);
+        }
+    }
+
+    xSemaphoreGive(store_lock);
+
+    return err_code;
+}
+
+bytebeam_err_t bytebeam_store_init(bytebeam_client_t *bytebeam_client)
+{
+    if (bytebeam_client == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (store_lock == NULL)
+    {
+        store_lock = xSemaphoreCreateMutex();
+
+        if (store_lock == NULL)
+        {
+            BB_LOGE(TAG, "Failed to create the store lock");
+            return BB_FAILURE;
+        }
+    }
+
+    if (store_mount() != 0)
+    {
+        BB_LOGE(TAG, "Failed to mount the store partition %s", CONFIG_BYTEBEAM_STORE_PARTITION_LABEL);
+        return BB_FAILURE;
+    }
+
+    if (store_scan_segments() != 0)
+    {
+        store_unmount();
+        return BB_FAILURE;
+    }
+
+    store_write_file = NULL;
+    store_write_len = 0;
+    store_read_file = NULL;
+    store_read_offset = 0;
+    store_drain_tick = xTaskGetTickCount();
+
+    store_client = bytebeam_client;
+
+    return BB_SUCCESS;
+}
+
+void bytebeam_store_deinit(void)
+{
+    if (store_client == NULL)
+    {
+        return;
+    }
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+
+    store_seal_segment();
+
+    if (store_read_file != NULL)
+    {
+        fclose(store_read_file);
+        store_read_file = NULL;
+    }
+
+    store_client = NULL;
+
+    xSemaphoreGive(store_lock);
+
+    if (store_unmount() != 0)
+    {
+        BB_LOGE(TAG, "Failed to unmount the store partition");
+    }
+}
+
+bytebeam_err_t bytebeam_store_write(const char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len)
+{
+    if (stream_name == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    if (store_client == NULL)
+    {
+        return BB_FAILURE;
+    }
+
+    size_t stream_len = strlen(stream_name);
+    size_t record_len = sizeof(store_record_header_t) + stream_len + payload_len;
+
+    if (stream_len > BYTEBEAM_STORE_STREAM_STR_LEN || record_len > CONFIG_BYTEBEAM_STORE_SEGMENT_SIZE)
+    {
+        BB_LOGE(TAG, "Publish to %s stream is too large to be stored (%d bytes)", stream_name, (int)record_len);
+        return BB_FAILURE;
+    }
+
+    store_record_header_t header = {
+        .magic = STORE_RECORD_MAGIC,
+        .stream_len = (uint8_t)stream_len,
+        .encoding = (uint8_t)encoding,
+        .payload_len = (uint32_t)payload_len,
+    };
+
+    header.crc = store_record_crc(&header, stream_name, payload);
+
+    xSemaphoreTake(store_lock, portMAX_DELAY);
+
+    if (store_write_file != NULL && store_write_len + record_len > CONFIG_BYTEBEAM_STORE_SEGMENT_SIZE)
+    {
+        store_seal_segment();
+    }
+
+    if (store_write_file == NULL && store_open_segment() != 0)
+    {
+        xSemaphoreGive(store_lock);
+        return BB_FAILURE;
+    }
+
+    // the record only counts as stored once it reached the flash
+    if (fwrite(&header, sizeof(header), 1, store_write_file) != 1 ||
+        fwrite(stream_name, 1, stream_len, store_write_file) != stream_len ||
+        fwrite(payload, 1, payload_len, store_write_file) != payload_len ||
+        fflush(store_write_file) != 0 ||
+        fsync(fileno(store_write_file)) != 0)
+    {
+        BB_LOGE(TAG, "Failed to store publish to %s stream", stream_name);
+
+        // the partial record ends this segment, the reader skips it
+        store_seal_segment();
+
+        xSemaphoreGive(store_lock);
+        return BB_FAILURE;
+    }
+
+    store_write_len += record_len;
+    atomic_store(&store_pending, true);
+
+    xSemaphoreGive(store_lock);
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_store_drain(uint32_t *next_drain_ms)
+{
+    if (next_drain_ms == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
+
+    *next_drain_ms = UINT32_MAX;
+
+    if (store_client == NULL)
+    {
+        return BB_FAILURE;
+    }
+
+    // the drain is resumed by the connect event
+    if (!atomic_load(&store_pending) || store_client->connection_status == 0)
+    {
+        return BB_SUCCESS;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    int32_t remaining = (int32_t)(store_drain_tick - now);
+
+    if (remaining > 0)
+    {
+        *next_drain_ms = remaining * portTICK_PERIOD_MS;
+        return BB_SUCCESS;
+    }
+
+    bytebeam_err_t err_code = store_drain_record();
+    uint32_t interval_ms = (err_code == BB_SUCCESS) ? (1000 / CONFIG_BYTEBEAM_STORE_DRAIN_RATE) : STORE_DRAIN_RETRY_MS;
+
+    store_drain_tick = now + pdMS_TO_TICKS(interval_ms);
+
+    if (atomic_load(&store_pending))
+    {
+        *next_drain_ms = interval_ms;
+    }
+
+    return err_code;
+}
+
+#endif /* CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED */
@@ -1,392 +1,759 @@
-#include "cJSON.h"
+#include <stdatomic.h>
+#include "freertos/FreeRTOS.h"
 #include "bytebeam_hal.h"
 #include "bytebeam_action.h"
 #include "bytebeam_stream.h"
+#include "bytebeam_store.h"
+#include "bytebeam_compress.h"
+#include "bytebeam_inflight.h"
+#include "bytebeam_flow.h"
+#include "bytebeam_rate.h"
+
+/* topic variants of an open stream, the compressed one only exists if compression is enabled */
+#define STREAM_TOPIC_ENCODINGS 2
+#define STREAM_TOPIC_PLAIN 0
+#define STREAM_TOPIC_COMPRESSED 1
+
+/* This enum represents where a publish comes from, only the application ones are subject to the rate limit policy */
+typedef enum stream_origin {
+    STREAM_ORIGIN_APP,              //!< Published by the application
+    STREAM_ORIGIN_STORE,            //!< Drained from the store and forward partition
+    STREAM_ORIGIN_COALESCED,        //!< Held back by the coalesce policy
+    STREAM_ORIGIN_BATCH             //!< Sealed batch sent by the MQTT task
+} stream_origin_t;
+
+#if CONFIG_BYTEBEAM_COMPRESSION_IS_ENABLED
+#define STREAM_TOPIC_VARIANTS 2
+#else
+#define STREAM_TOPIC_VARIANTS 1
+#endif
+
+/**
+ * @struct bytebeam_stream
+ * This struct contains an open stream, the name and the topics share one allocation made when the stream is opened.
+ * The allocation outlives the close, it is only replaced once the entry is opened again and no publish uses it
+ * @var bytebeam_stream::client
+ * Client the stream is opened for, NULL while the table entry is free
+ * @var bytebeam_stream::hash
+ * Hash of the stream name, compared ahead of the name
+ * @var bytebeam_stream::name
+ * Stream name
+ * @var bytebeam_stream::topics
+ * Publish topics by encoding, the plain variant followed by the compressed one
+ * @var bytebeam_stream::qos
+ * MQTT QoS of the publishes
+ * @var bytebeam_stream::blocking
+ * Set if the publishes are written by the calling task instead of the MQTT task
+ * @var bytebeam_stream::priority
+ * Priority lane of the publishes
+ * @var bytebeam_stream::bucket
+ * Token bucket of the stream rate limit, guarded by the rate limiter
+ * @var bytebeam_stream::rate_limited
+ * Set if the stream has a rate limit of its own
+ * @var bytebeam_stream::rate_policy
+ * Policy of the stream rate limit
+ * @var bytebeam_stream::rate_due_ms
+ * Uptime at which the last publish refused by a rate limit would have been admitted
+ * @var bytebeam_stream::coalesced
+ * Latest publish held back by the coalesce policy, NULL if none. The held publish is guarded by the table lock
+ * @var bytebeam_stream::coalesced_len
+ * Length of the held publish
+ * @var bytebeam_stream::coalesced_encoding
+ * Encoding of the held publish
+ * @var bytebeam_stream::users
+ * Number of publishes reading the name and the topics
+ */
+struct bytebeam_stream {
+    _Atomic(bytebeam_client_t *) client;
+    uint32_t hash;
+    char *name;
+    const char *topics[STREAM_TOPIC_ENCODINGS][STREAM_TOPIC_VARIANTS];
+    atomic_int qos;
+    atomic_bool blocking;
+    atomic_int priority;
+    bytebeam_token_bucket_t bucket;
+    atomic_bool rate_limited;
+    atomic_int rate_policy;
+    atomic_llong rate_due_ms;
+    void *coalesced;
+    size_t coalesced_len;
+    bytebeam_encoding_t coalesced_encoding;
+    atomic_int users;
+};
+
+static struct bytebeam_stream stream_table[CONFIG_BYTEBEAM_MAX_OPEN_STREAMS];
+static portMUX_TYPE stream_table_lock = portMUX_INITIALIZER_UNLOCKED;
 
-static char json_paylaod[CONFIG_MQTT_BATCH_ELEMENT_SIZE] = "";
-static char batch_json_data[CONFIG_NUM_MESSAGES_IN_MQTT_BATCH * CONFIG_MQTT_BATCH_ELEMENT_SIZE] = "";
+static const char *TAG = "BYTEBEAM_STREAM";
 
-static char batch_mqtt_stream[100] = "";
-static bytebeam_client_t *bytebeam_batch_mqtt_client = NULL;
-SemaphoreHandle_t batch_mqtt_semaphore = NULL;
+#if CONFIG_BYTEBEAM_COMPRESSION_IS_ENABLED
+/* output of the compression, owned by the MQTT task like the compression work area */
+static char stream_compress_buf[CONFIG_BYTEBEAM_COMPRESSION_BUFFER_SIZE];
 
-static const char *TAG = "BYTEBEAM_STREAM";
+static char* stream_compress_payload(const char *payload, size_t payload_len, size_t *compressed_len)
+{
+    // other tasks send their publishes as they are instead of contending for the buffers
+    if (!bytebeam_mqtt_thread_is_current())
+    {
+        return NULL;
+    }
 
-bytebeam_err_t bytebeam_publish_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload)
+    // compression is only worth it if it saves something, give up as soon as the output is not smaller
+    size_t capacity = payload_len - 1;
+
+    if (capacity > sizeof(stream_compress_buf))
+    {
+        capacity = sizeof(stream_compress_buf);
+    }
+
+    long long start_us = bytebeam_hal_get_uptime_us();
+    bytebeam_err_t err_code = bytebeam_compress(payload, payload_len, stream_compress_buf, capacity, compressed_len);
+    uint32_t cpu_time_us = (uint32_t)(bytebeam_hal_get_uptime_us() - start_us);
+
+    if (err_code != BB_SUCCESS)
+    {
+        bytebeam_compress_account(payload_len, 0, cpu_time_us);
+        return NULL;
+    }
+
+    bytebeam_compress_account(payload_len, *compressed_len, cpu_time_us);
+
+    BB_LOGD(TAG, "Compressed %d bytes to %d bytes in %u us", (int)payload_len, (int)*compressed_len, (unsigned)cpu_time_us);
+
+    return stream_compress_buf;
+}
+#endif
+
+static uint32_t stream_name_hash(const char *stream_name)
 {
-    if (bytebeam_client == NULL || stream_name == NULL || payload == NULL)
+    // FNV-1a, only used to skip most of the name comparisons
+    uint32_t hash = 2166136261u;
+
+    while (*stream_name != '\0')
     {
-        return BB_NULL_CHECK_FAILURE;
+        hash = (hash ^ (uint8_t)*stream_name++) * 16777619u;
     }
 
-    int qos = 1;
-    int msg_id = 0;
-    char topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = {0};
+    return hash;
+}
 
-    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
-    int temp_var = snprintf(topic, max_len,  "/tenants/%s/devices/%s/events/%s/jsonarray",
+static int stream_format_topic(char *topic, size_t max_len, bytebeam_client_t *bytebeam_client, const char *stream_name, bytebeam_encoding_t encoding, int variant)
+{
+    return snprintf(topic, max_len, "/tenants/%s/devices/%s/events/%s/%s%s",
             bytebeam_client->device_cfg.project_id,
             bytebeam_client->device_cfg.device_id,
-            stream_name);
+            stream_name,
+            (encoding == BYTEBEAM_ENCODING_CBOR) ? "cborarray" : "jsonarray",
+            (variant == STREAM_TOPIC_COMPRESSED) ? BYTEBEAM_COMPRESS_TOPIC_SUFFIX : "");
+}
 
-    if(temp_var >= max_len)
+static struct bytebeam_stream* stream_find(bytebeam_client_t *bytebeam_client, const char *stream_name, uint32_t hash)
+{
+    for (int loop_var = 0; loop_var < CONFIG_BYTEBEAM_MAX_OPEN_STREAMS; loop_var++)
     {
-        BB_LOGE(TAG, "Publish topic size exceeded buffer size");
-        return BB_FAILURE;
-    }
-
-    BB_LOGI(TAG, "Topic is %s", topic);
+        struct bytebeam_stream *stream = &stream_table[loop_var];
 
-    msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, topic, payload, strlen(payload), qos);
-    
-    if (msg_id != -1) {
-        BB_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
-        return BB_SUCCESS;
-    } else {
-        BB_LOGE(TAG, "Publish to %s stream Failed", stream_name);
-        return BB_FAILURE;
+        if (atomic_load(&stream->client) == bytebeam_client && stream->hash == hash && !strcmp(stream->name, stream_name))
+        {
+            return stream;
+        }
     }
+
+    return NULL;
 }
 
-bytebeam_err_t bytebeam_publish_device_shadow(bytebeam_client_t *bytebeam_client)
+bytebeam_err_t bytebeam_stream_open(bytebeam_client_t *bytebeam_client, const char *stream_name, bytebeam_stream_handle_t *handle)
 {
-    bytebeam_err_t ret_val = 0;
-    bytebeam_reset_reason_t reboot_reason_id;
-    static char device_shadow_json_str[512 + CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN] = "";
-    
-    cJSON *device_shadow_json = NULL;
-    cJSON *sequence_json = NULL;
-    cJSON *timestamp_json = NULL;
-    cJSON *device_status_json = NULL;
-    cJSON *device_reset_reason_json = NULL;
-    cJSON *device_uptime_json = NULL;
-    cJSON *device_software_type_json = NULL;
-    cJSON *device_software_version_json = NULL;
-    cJSON *device_hardware_type_json = NULL;
-    cJSON *device_hardware_version_json = NULL;
+    if (bytebeam_client == NULL || stream_name == NULL || handle == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
 
-    char *string_json = NULL;
+    uint32_t hash = stream_name_hash(stream_name);
 
-    device_shadow_json = cJSON_CreateObject();
+    // the names of the free entries are replaced under the lock, so they are only compared under it
+    taskENTER_CRITICAL(&stream_table_lock);
+    struct bytebeam_stream *stream = stream_find(bytebeam_client, stream_name, hash);
+    taskEXIT_CRITICAL(&stream_table_lock);
 
-    if(device_shadow_json == NULL)
+    if (stream != NULL)
     {
-        BB_LOGE(TAG, "Json object creation failed.");
-        return -1;
+        *handle = stream;
+        return BB_SUCCESS;
     }
 
-    bytebeam_client->device_shadow.stream.milliseconds = bytebeam_hal_get_epoch_millis();
+    // the name and every topic variant go in one allocation, sized exactly
+    size_t name_len = strlen(stream_name) + 1;
+    size_t arena_len = name_len;
 
-    if(bytebeam_client->device_shadow.stream.milliseconds == 0)
+    for (int encoding = 0; encoding < STREAM_TOPIC_ENCODINGS; encoding++)
     {
-        BB_LOGE(TAG, "failed to get epoch millis.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        for (int variant = 0; variant < STREAM_TOPIC_VARIANTS; variant++)
+        {
+            arena_len += stream_format_topic(NULL, 0, bytebeam_client, stream_name, encoding, variant) + 1;
+        }
     }
 
-    timestamp_json = cJSON_CreateNumber(bytebeam_client->device_shadow.stream.milliseconds);
+    char *arena = malloc(arena_len);
 
-    if(timestamp_json == NULL)
+    if (arena == NULL)
     {
-        BB_LOGE(TAG, "Json add time stamp failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        BB_LOGE(TAG, "Failed to allocate the memory for %s stream topics", stream_name);
+        return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "timestamp", timestamp_json);
+    struct bytebeam_stream entry = { .hash = hash, .name = arena };
+    char *cursor = arena + name_len;
 
-    bytebeam_client->device_shadow.stream.sequence++;
-    sequence_json = cJSON_CreateNumber(bytebeam_client->device_shadow.stream.sequence);
+    memcpy(arena, stream_name, name_len);
 
-    if(sequence_json == NULL)
+    for (int encoding = 0; encoding < STREAM_TOPIC_ENCODINGS; encoding++)
     {
-        BB_LOGE(TAG, "Json add sequence id failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        for (int variant = 0; variant < STREAM_TOPIC_VARIANTS; variant++)
+        {
+            entry.topics[encoding][variant] = cursor;
+            cursor += stream_format_topic(cursor, arena + arena_len - cursor, bytebeam_client, stream_name, encoding, variant) + 1;
+        }
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "sequence", sequence_json);
+    bool claimed = false;
+    bool is_shadow = !strcmp(stream_name, BYTEBEAM_SHADOW_STREAM);
+    char *retired = NULL;
+
+    // another task may have opened the same stream meanwhile, the entry is published by setting its client last
+    taskENTER_CRITICAL(&stream_table_lock);
 
-    reboot_reason_id = bytebeam_hal_get_reset_reason();
+    stream = stream_find(bytebeam_client, stream_name, hash);
 
-    switch(reboot_reason_id) {
-        case BB_RST_UNKNOWN   : bytebeam_client->device_shadow.stream.reboot_reason = "Unknown Reset";            break;
-        case BB_RST_POWERON   : bytebeam_client->device_shadow.stream.reboot_reason = "Power On Reset";           break;
-        case BB_RST_EXT       : bytebeam_client->device_shadow.stream.reboot_reason = "External Pin Reset";       break;
-        case BB_RST_SW        : bytebeam_client->device_shadow.stream.reboot_reason = "Software Reset";           break;
-        case BB_RST_PANIC     : bytebeam_client->device_shadow.stream.reboot_reason = "Hard Fault Reset";         break;
-        case BB_RST_INT_WDT   : bytebeam_client->device_shadow.stream.reboot_reason = "Interrupt Watchdog Reset"; break;
-        case BB_RST_TASK_WDT  : bytebeam_client->device_shadow.stream.reboot_reason = "Task Watchdog Reset";      break;
-        case BB_RST_WDT       : bytebeam_client->device_shadow.stream.reboot_reason = "Other Watchdog Reset";     break;
-        case BB_RST_DEEPSLEEP : bytebeam_client->device_shadow.stream.reboot_reason = "Exiting Deep Sleep Reset"; break;
-        case BB_RST_BROWNOUT  : bytebeam_client->device_shadow.stream.reboot_reason = "Brownout Reset";           break;
-        case BB_RST_SDIO      : bytebeam_client->device_shadow.stream.reboot_reason = "SDIO Reset";               break;
+    for (int loop_var = 0; stream == NULL && loop_var < CONFIG_BYTEBEAM_MAX_OPEN_STREAMS; loop_var++)
+    {
+        struct bytebeam_stream *slot = &stream_table[loop_var];
 
-        default: bytebeam_client->device_shadow.stream.reboot_reason = "Unknown Reset Id";
+        // a publish that loaded the entry before it was closed may still read the previous name and topics
+        if (atomic_load(&slot->client) != NULL || atomic_load(&slot->users) != 0)
+        {
+            continue;
+        }
+
+        stream = slot;
+        retired = stream->name;
+
+        // nothing of the previous stream carries over to the new one
+        stream->hash = entry.hash;
+        stream->name = entry.name;
+        memcpy(stream->topics, entry.topics, sizeof(entry.topics));
+        atomic_store(&stream->qos, 1);
+        atomic_store(&stream->blocking, !is_shadow);
+        atomic_store(&stream->priority, is_shadow ? BYTEBEAM_PRIORITY_CONTROL : BYTEBEAM_PRIORITY_BULK);
+        memset(&stream->bucket, 0, sizeof(stream->bucket));
+        atomic_store(&stream->rate_limited, false);
+        atomic_store(&stream->rate_policy, BYTEBEAM_RATE_POLICY_DROP);
+        atomic_store(&stream->rate_due_ms, 0);
+        stream->coalesced = NULL;
+        stream->coalesced_len = 0;
+        stream->coalesced_encoding = BYTEBEAM_ENCODING_JSON;
+        atomic_store(&stream->client, bytebeam_client);
+
+        claimed = true;
     }
 
-    device_reset_reason_json = cJSON_CreateString(bytebeam_client->device_shadow.stream.reboot_reason);
+    taskEXIT_CRITICAL(&stream_table_lock);
+
+    free(claimed ? retired : arena);
 
-    if(device_reset_reason_json == NULL)
+    if (stream == NULL)
     {
-        BB_LOGE(TAG, "Json add device reboot reason failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        BB_LOGE(TAG, "All %d open streams are in use", CONFIG_BYTEBEAM_MAX_OPEN_STREAMS);
+        return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Reset_Reason", device_reset_reason_json);
+    *handle = stream;
 
-    bytebeam_client->device_shadow.stream.uptime = bytebeam_hal_get_uptime_ms();
+    return BB_SUCCESS;
+}
 
-    device_uptime_json = cJSON_CreateNumber(bytebeam_client->device_shadow.stream.uptime);
+void bytebeam_stream_close_all(bytebeam_client_t *bytebeam_client)
+{
+    for (int loop_var = 0; loop_var < CONFIG_BYTEBEAM_MAX_OPEN_STREAMS; loop_var++)
+    {
+        struct bytebeam_stream *stream = &stream_table[loop_var];
+
+        if (atomic_load(&stream->client) == bytebeam_client)
+        {
+            atomic_store(&stream->client, NULL);
 
-    if(device_uptime_json == NULL)
+            taskENTER_CRITICAL(&stream_table_lock);
+            void *coalesced = stream->coalesced;
+            stream->coalesced = NULL;
+            taskEXIT_CRITICAL(&stream_table_lock);
+
+            free(coalesced);
+
+            // the name and the topics stay, batch streams and publishes under way may still hold the entry
+        }
+    }
+}
+
+bytebeam_err_t bytebeam_stream_set_attr(bytebeam_stream_handle_t handle, const bytebeam_stream_attr_t *attr)
+{
+    if (handle == NULL || attr == NULL)
     {
-        BB_LOGE(TAG, "Json add device uptime failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        return BB_NULL_CHECK_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Uptime", device_uptime_json);
+    if (attr->qos != 0 && attr->qos != 1)
+    {
+        BB_LOGE(TAG, "QoS %d is not supported", attr->qos);
+        return BB_FAILURE;
+    }
 
-    // get the device shadow status from config menu
-    bytebeam_client->device_shadow.stream.status = CONFIG_DEVICE_SHADOW_STATUS;
+    if (attr->priority != BYTEBEAM_PRIORITY_CONTROL && attr->priority != BYTEBEAM_PRIORITY_BULK)
+    {
+        BB_LOGE(TAG, "Priority %d is not supported", (int)attr->priority);
+        return BB_FAILURE;
+    }
 
-    device_status_json = cJSON_CreateString(bytebeam_client->device_shadow.stream.status);
+    atomic_store(&handle->qos, attr->qos);
+    atomic_store(&handle->blocking, attr->blocking);
+    atomic_store(&handle->priority, attr->priority);
 
-    if(device_status_json == NULL)
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_get_attr(bytebeam_stream_handle_t handle, bytebeam_stream_attr_t *attr)
+{
+    if (handle == NULL || attr == NULL)
     {
-        BB_LOGE(TAG, "Json add device status failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        return BB_NULL_CHECK_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Status", device_status_json);
+    attr->qos = atomic_load(&handle->qos);
+    attr->blocking = atomic_load(&handle->blocking);
+    attr->priority = atomic_load(&handle->priority);
+
+    return BB_SUCCESS;
+}
+
+const char* bytebeam_stream_name(bytebeam_stream_handle_t handle)
+{
+    return handle->name;
+}
 
-    // get the device shadow software type from config menu
-    bytebeam_client->device_shadow.stream.software_type = CONFIG_DEVICE_SHADOW_SOFTWARE_TYPE;
+bytebeam_err_t bytebeam_stream_set_rate_limit(bytebeam_stream_handle_t handle, const bytebeam_rate_limit_t *limit)
+{
+    bytebeam_rate_limit_t no_limit = { 0 };
+
+    if (handle == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
 
-    device_software_type_json = cJSON_CreateString(bytebeam_client->device_shadow.stream.software_type);
+    if (limit == NULL)
+    {
+        limit = &no_limit;
+    }
 
-    if(device_software_type_json == NULL)
+    if (limit->policy > BYTEBEAM_RATE_POLICY_SPILL)
     {
-        BB_LOGE(TAG, "Json add device software type failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        BB_LOGE(TAG, "Rate limit policy %d is not supported", (int)limit->policy);
+        return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Software_Type", device_software_type_json);
+    bytebeam_token_bucket_init(&handle->bucket, limit);
 
-    // get the device shadow software version from config menu
-    bytebeam_client->device_shadow.stream.software_version = CONFIG_DEVICE_SHADOW_SOFTWARE_VERSION;
+    atomic_store(&handle->rate_policy, limit->policy);
+    atomic_store(&handle->rate_limited, limit->bytes_per_sec != 0);
 
-    device_software_version_json = cJSON_CreateString(bytebeam_client->device_shadow.stream.software_version);
+    return BB_SUCCESS;
+}
+
+static bytebeam_err_t stream_coalesce(struct bytebeam_stream *stream, bytebeam_encoding_t encoding, const void *payload, size_t payload_len)
+{
+    // the copy is made before taking the lock, a newer publish replaces the held one
+    void *copy = malloc(payload_len);
 
-    if(device_software_version_json == NULL)
+    if (copy == NULL)
     {
-        BB_LOGE(TAG, "Json add device software version failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        BB_LOGE(TAG, "Failed to allocate the memory for the coalesced publish to %s stream", stream->name);
+        return BB_FAILURE;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Software_Version", device_software_version_json);
+    memcpy(copy, payload, payload_len);
+
+    taskENTER_CRITICAL(&stream_table_lock);
+
+    void *replaced = stream->coalesced;
+
+    stream->coalesced = copy;
+    stream->coalesced_len = payload_len;
+    stream->coalesced_encoding = encoding;
 
-    // get the device shadow hardware type from config menu
-    bytebeam_client->device_shadow.stream.hardware_type = CONFIG_DEVICE_SHADOW_HARDWARE_TYPE;
+    taskEXIT_CRITICAL(&stream_table_lock);
 
-    device_hardware_type_json = cJSON_CreateString(bytebeam_client->device_shadow.stream.hardware_type);
+    free(replaced);
 
-    if(device_hardware_type_json == NULL)
+    bytebeam_rate_account(BYTEBEAM_RATE_POLICY_COALESCE, replaced != NULL);
+
+    // the MQTT task sends the held publish once the limit allows
+    bytebeam_mqtt_thread_wake();
+
+    return BB_SUCCESS;
+}
+
+static bytebeam_err_t stream_rate_limited(struct bytebeam_stream *stream, const char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len,
+                                          stream_origin_t origin, bytebeam_publish_cb_t callback)
+{
+    // a tracked publish is kept by its caller and retried, as is one the SDK already holds, so none of them is lost
+    if (origin != STREAM_ORIGIN_APP || callback != NULL)
     {
-        BB_LOGE(TAG, "Json add device hardware type failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        return BB_WOULD_BLOCK;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Hardware_Type", device_hardware_type_json);
+    bytebeam_rate_policy_t policy = (stream != NULL && atomic_load(&stream->rate_limited)) ? atomic_load(&stream->rate_policy) : bytebeam_rate_global_policy();
 
-    // get the device shadow hardware version from config menu
-    bytebeam_client->device_shadow.stream.hardware_version = CONFIG_DEVICE_SHADOW_HARDWARE_VERSION;
+    switch (policy)
+    {
+        case BYTEBEAM_RATE_POLICY_COALESCE:
+            // a stream outside the open streams table has nowhere to hold the publish
+            if (stream != NULL && stream_coalesce(stream, encoding, payload, payload_len) == BB_SUCCESS)
+            {
+                return BB_SUCCESS;
+            }
+            break;
 
-    device_hardware_version_json = cJSON_CreateString(bytebeam_client->device_shadow.stream.hardware_version);
+        case BYTEBEAM_RATE_POLICY_SPILL:
+#if CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED
+            if (bytebeam_store_write(stream_name, encoding, payload, payload_len) == BB_SUCCESS)
+            {
+                bytebeam_rate_account(BYTEBEAM_RATE_POLICY_SPILL, false);
+                return BB_SUCCESS;
+            }
+#endif
+            break;
 
-    if(device_hardware_version_json == NULL)
-    {
-        BB_LOGE(TAG, "Json add device hardware version failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
+        default:
+            break;
     }
 
-    cJSON_AddItemToObject(device_shadow_json, "Hardware_Version", device_hardware_version_json);
+    bytebeam_rate_account(BYTEBEAM_RATE_POLICY_DROP, false);
 
-    string_json = cJSON_Print(device_shadow_json);
+    BB_LOGD(TAG, "Publish to %s stream dropped by its rate limit", stream_name);
+
+    return BB_RATE_LIMITED;
+}
+
+static bytebeam_err_t stream_publish_to_topic(bytebeam_client_t *bytebeam_client, struct bytebeam_stream *stream, char *stream_name, bytebeam_encoding_t encoding,
+                                              const void *payload, size_t payload_len, char *topic, char *compressed_topic, int qos, bool blocking,
+                                              bytebeam_publish_priority_t priority, stream_origin_t origin, bytebeam_publish_cb_t callback, void *user_data)
+{
+    int msg_id = 0;
+    long long start_us = bytebeam_hal_get_uptime_us();
 
-    if(string_json == NULL)
+#if CONFIG_BYTEBEAM_STORE_AND_FORWARD_IS_ENABLED
+    // keep the publish in flash while offline, it is published once the client is back online
+    if (bytebeam_client->connection_status == 0)
     {
-        BB_LOGE(TAG, "Json string print failed.");
-        cJSON_Delete(device_shadow_json);
-        return -1;
-    } 
+        if (bytebeam_store_write(stream_name, encoding, payload, payload_len) == BB_SUCCESS)
+        {
+            BB_LOGD(TAG, "Stored publish to %s stream", stream_name);
 
-    memset(device_shadow_json_str, 0x00, sizeof(device_shadow_json_str));
+            if (callback != NULL)
+            {
+                callback(0, BYTEBEAM_PUBLISH_STORED, 0, user_data);
+            }
 
-    strcpy(device_shadow_json_str, "[");
-    strcat(device_shadow_json_str, string_json);
+            return BB_SUCCESS;
+        }
+    }
+#endif
 
-    // call the device shadow updater if exists
-    if(bytebeam_client->device_shadow.updater != NULL)
+    // push back on the producer instead of growing the outbox without bound
+    if (bytebeam_flow_check(bytebeam_client, priority) == BB_WOULD_BLOCK)
     {
-        bytebeam_client->device_shadow.updater(bytebeam_client);
+        BB_LOGD(TAG, "Publish to %s stream would block", stream_name);
+        return BB_WOULD_BLOCK;
     }
 
-    // add any additional json if provided
-    if(bytebeam_client->device_shadow.custom_json_str[0] != '\0')
+    // only the senders that retry by themselves step aside for the control lane, the application ones would lose data
+    if (origin != STREAM_ORIGIN_APP && priority == BYTEBEAM_PRIORITY_BULK && bytebeam_flow_is_yielding())
     {
-        strcat(device_shadow_json_str, ",");
-        strcat(device_shadow_json_str, bytebeam_client->device_shadow.custom_json_str);
+        BB_LOGD(TAG, "Publish to %s stream yields to the control lane", stream_name);
+        return BB_WOULD_BLOCK;
     }
 
-    strcat(device_shadow_json_str, "]");
-    BB_LOGI(TAG, "\nStatus to send:\n%s\n", device_shadow_json_str);
-
-    // publish the json to device shadow stream
-    ret_val = bytebeam_publish_to_stream(bytebeam_client, "device_shadow", device_shadow_json_str);
+    uint32_t rate_wait_ms = 0;
 
-    cJSON_Delete(device_shadow_json);
-    cJSON_free(string_json);
+    // the limits count the payload as handed over, before compression
+    if (bytebeam_rate_admit((stream != NULL) ? &stream->bucket : NULL, priority, payload_len, &rate_wait_ms) != BB_SUCCESS)
+    {
+        if (stream != NULL)
+        {
+            atomic_store(&stream->rate_due_ms, bytebeam_hal_get_uptime_ms() + rate_wait_ms);
+        }
 
-    return ret_val;
-}
+        return stream_rate_limited(stream, stream_name, encoding, payload, payload_len, origin, callback);
+    }
 
-bytebeam_err_t bytebeam_add_custom_device_shadow(bytebeam_client_t *bytebeam_client, char *custom_json_str)
-{
-    if(bytebeam_client == NULL || custom_json_str == NULL)
+#if CONFIG_BYTEBEAM_COMPRESSION_IS_ENABLED
+    if (payload_len >= CONFIG_BYTEBEAM_COMPRESSION_THRESHOLD)
     {
-        return BB_NULL_CHECK_FAILURE;
+        size_t compressed_len = 0;
+        char *compressed = stream_compress_payload(payload, payload_len, &compressed_len);
+
+        // the compressed form goes out on its own topic so the platform knows how to decode it
+        if (compressed != NULL)
+        {
+            payload = compressed;
+            payload_len = compressed_len;
+            topic = compressed_topic;
+        }
     }
+#endif
 
-    if(strlen(custom_json_str) >= CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN)
+    if (blocking)
+    {
+        msg_id = bytebeam_hal_mqtt_publish(bytebeam_client->client, topic, (char *)payload, payload_len, qos);
+    }
+    else
     {
-        BB_LOGE(TAG, "Custom json size exceeded buffer size");
+        msg_id = bytebeam_hal_mqtt_enqueue(bytebeam_client->client, topic, (char *)payload, payload_len, qos);
+    }
+
+    // a full outbox is reported with its own negative code
+    if (msg_id < 0) {
+        BB_LOGE(TAG, "Publish to %s stream Failed, outbox holds %d bytes", stream_name, bytebeam_hal_mqtt_get_outbox_size(bytebeam_client->client));
         return BB_FAILURE;
     }
 
-    memset(bytebeam_client->device_shadow.custom_json_str, 0x00, CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN);
-    strcpy(bytebeam_client->device_shadow.custom_json_str, custom_json_str);
+    BB_LOGD(TAG, "sent publish successful, msg_id=%d", msg_id);
+
+    // QoS 0 publishes and the ones the in flight table can not take complete once handed to the client
+    if (qos == 0 || bytebeam_inflight_add(msg_id, priority, start_us, callback, user_data) != BB_SUCCESS)
+    {
+        if (callback != NULL)
+        {
+            callback(msg_id, BYTEBEAM_PUBLISH_SENT, (uint32_t)((bytebeam_hal_get_uptime_us() - start_us) / 1000), user_data);
+        }
+    }
 
     return BB_SUCCESS;
 }
 
-bytebeam_err_t bytebeam_register_device_shadow_updater(bytebeam_client_t *bytebeam_client, int (*func_ptr)(bytebeam_client_t *))
+bytebeam_err_t bytebeam_stream_publish(bytebeam_stream_handle_t handle, bytebeam_encoding_t encoding, const void *payload, size_t payload_len)
 {
-    if(bytebeam_client == NULL || func_ptr == NULL)
+    return bytebeam_stream_publish_with_callback(handle, encoding, payload, payload_len, NULL, NULL);
+}
+
+static bytebeam_err_t stream_publish(bytebeam_stream_handle_t handle, bytebeam_encoding_t encoding, const void *payload, size_t payload_len,
+                                     stream_origin_t origin, bytebeam_publish_cb_t callback, void *user_data)
+{
+    // announce the use before checking the client, so a re-open can not replace the name and topics underneath
+    atomic_fetch_add(&handle->users, 1);
+
+    bytebeam_client_t *bytebeam_client = atomic_load(&handle->client);
+
+    if (bytebeam_client == NULL)
     {
-        return BB_NULL_CHECK_FAILURE;
+        atomic_fetch_sub(&handle->users, 1);
+
+        BB_LOGE(TAG, "Stream is closed");
+        return BB_FAILURE;
     }
 
-    bytebeam_client->device_shadow.updater = func_ptr;
+    const char *const *topics = handle->topics[(encoding == BYTEBEAM_ENCODING_CBOR) ? 1 : 0];
 
-    return BB_SUCCESS;
+    bytebeam_err_t err_code = stream_publish_to_topic(bytebeam_client, handle, handle->name, encoding, payload, payload_len,
+                                                      (char *)topics[STREAM_TOPIC_PLAIN], (char *)topics[STREAM_TOPIC_VARIANTS - 1],
+                                                      atomic_load(&handle->qos), atomic_load(&handle->blocking), atomic_load(&handle->priority),
+                                                      origin, callback, user_data);
+
+    atomic_fetch_sub(&handle->users, 1);
+
+    return err_code;
 }
 
-bytebeam_err_t bytebeam_batch_init(bytebeam_client_t *bytebeam_client, char* stream_name)
+bytebeam_err_t bytebeam_stream_publish_with_callback(bytebeam_stream_handle_t handle, bytebeam_encoding_t encoding, const void *payload, size_t payload_len,
+                                                     bytebeam_publish_cb_t callback, void *user_data)
 {
-    if(bytebeam_client == NULL || stream_name == NULL)
+    if (handle == NULL || payload == NULL)
     {
         return BB_NULL_CHECK_FAILURE;
     }
 
-    batch_mqtt_semaphore = xSemaphoreCreateBinary();
+    return stream_publish(handle, encoding, payload, payload_len, STREAM_ORIGIN_APP, callback, user_data);
+}
 
-    if(batch_mqtt_semaphore == NULL)
+bytebeam_err_t bytebeam_stream_publish_batch(bytebeam_stream_handle_t handle, bytebeam_encoding_t encoding, const void *payload, size_t payload_len,
+                                             bytebeam_publish_cb_t callback, void *user_data)
+{
+    if (handle == NULL || payload == NULL)
     {
-        ESP_LOGE(TAG, "Batch MQTT Semaphore Creation Failed.\n");
-        return BB_FAILURE;
+        return BB_NULL_CHECK_FAILURE;
     }
 
-    bytebeam_batch_mqtt_client = bytebeam_client;
-    strcpy(batch_mqtt_stream, stream_name);
-
-    return BB_SUCCESS;
+    return stream_publish(handle, encoding, payload, payload_len, STREAM_ORIGIN_BATCH, callback, user_data);
 }
 
-bytebeam_err_t bytebeam_batch_publish_to_stream(char* payload)
+static bytebeam_err_t stream_publish_by_name(bytebeam_client_t *bytebeam_client, char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len,
+                                             stream_origin_t origin)
 {
-    if(bytebeam_batch_mqtt_client == NULL)
+    bytebeam_stream_handle_t handle = NULL;
+
+    if (bytebeam_stream_open(bytebeam_client, stream_name, &handle) == BB_SUCCESS)
     {
-        ESP_LOGE(TAG, "No Bytebeam Batch MQTT Handle.\n");
+        return stream_publish(handle, encoding, payload, payload_len, origin, NULL, NULL);
+    }
+
+    // the stream does not fit in the open streams table, its topics are formatted for this publish only
+    char topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = {0};
+    char compressed_topic[BYTEBEAM_MQTT_TOPIC_STR_LEN] = {0};
+    int max_len = BYTEBEAM_MQTT_TOPIC_STR_LEN;
+
+    if (stream_format_topic(topic, max_len, bytebeam_client, stream_name, encoding, STREAM_TOPIC_PLAIN) >= max_len ||
+        stream_format_topic(compressed_topic, max_len, bytebeam_client, stream_name, encoding, STREAM_TOPIC_VARIANTS - 1) >= max_len)
+    {
+        BB_LOGE(TAG, "Publish topic size exceeded buffer size");
         return BB_FAILURE;
     }
 
-    strcpy(json_paylaod, payload);
-    xSemaphoreGive(batch_mqtt_semaphore);
+    bool is_shadow = !strcmp(stream_name, BYTEBEAM_SHADOW_STREAM);
+    bytebeam_publish_priority_t priority = is_shadow ? BYTEBEAM_PRIORITY_CONTROL : BYTEBEAM_PRIORITY_BULK;
 
-    return BB_SUCCESS;
+    return stream_publish_to_topic(bytebeam_client, NULL, stream_name, encoding, payload, payload_len, topic, compressed_topic, 1, !is_shadow, priority, origin, NULL, NULL);
 }
 
-void bytebeam_user_thread_entry(void *pv)
+bytebeam_err_t bytebeam_publish_encoded_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len)
 {
-    bytebeam_err_t err_code;
-    bytebeam_client_t *bytebeam_client = (bytebeam_client_t*) pv;
+    if (bytebeam_client == NULL || stream_name == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
+    }
 
-    while(1)
+    return stream_publish_by_name(bytebeam_client, stream_name, encoding, payload, payload_len, STREAM_ORIGIN_APP);
+}
+
+bytebeam_err_t bytebeam_publish_stored_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len)
+{
+    if (bytebeam_client == NULL || stream_name == NULL || payload == NULL)
     {
-        BB_LOGI(TAG, "Device Shadow Message.\n");
-        
-        err_code = bytebeam_publish_device_shadow(bytebeam_client);
+        return BB_NULL_CHECK_FAILURE;
+    }
 
-        if(err_code != BB_SUCCESS)
-        {
-            BB_LOGE(TAG, "Failed to push Device Shadow Seq : %llu\n", bytebeam_client->device_shadow.stream.sequence);
-        }
+    return stream_publish_by_name(bytebeam_client, stream_name, encoding, payload, payload_len, STREAM_ORIGIN_STORE);
+}
 
-        vTaskDelay(CONFIG_DEVICE_SHADOW_PUSH_INTERVAL * 1000 / portTICK_PERIOD_MS);
+bytebeam_err_t bytebeam_publish_batch_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, bytebeam_encoding_t encoding, const void *payload, size_t payload_len)
+{
+    if (bytebeam_client == NULL || stream_name == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
     }
+
+    return stream_publish_by_name(bytebeam_client, stream_name, encoding, payload, payload_len, STREAM_ORIGIN_BATCH);
 }
 
-void bytebeam_mqtt_thread_entry(void *pv)
+void bytebeam_stream_rate_poll(uint32_t *next_ms)
 {
-    bytebeam_err_t err_code;
-    static int batch_size = 0;
-    
-    while(1)
+    long long now_ms = bytebeam_hal_get_uptime_ms();
+
+    for (int loop_var = 0; loop_var < CONFIG_BYTEBEAM_MAX_OPEN_STREAMS; loop_var++)
     {
-        if(xSemaphoreTake(batch_mqtt_semaphore, portMAX_DELAY) == pdTRUE)
+        struct bytebeam_stream *stream = &stream_table[loop_var];
+
+        if (atomic_load(&stream->client) == NULL)
         {
-            if(batch_size == 0)
-            {
-                memset(batch_json_data, 0, sizeof(batch_json_data));
-                strcpy(batch_json_data, "[");
-            }
-            
-            batch_size++;
-            ESP_LOGI(TAG, "Mqtt Batch Size Now : %d\n", batch_size);
+            continue;
+        }
 
-            if(batch_size == CONFIG_NUM_MESSAGES_IN_MQTT_BATCH)
+        long long due_ms = atomic_load(&stream->rate_due_ms);
+
+        // the held publish waits for the tokens its stream was short of
+        if (due_ms > now_ms)
+        {
+            taskENTER_CRITICAL(&stream_table_lock);
+            bool held = (stream->coalesced != NULL);
+            taskEXIT_CRITICAL(&stream_table_lock);
+
+            if (held && (uint32_t)(due_ms - now_ms) < *next_ms)
             {
-                strcat(batch_json_data, json_paylaod);
-                strcat(batch_json_data, "]");
-                batch_size = 0;
-
-                // publish the json to device shadow stream
-                bytebeam_err_t err_code;
-                do
-                {   
-                    ESP_LOGI(TAG, "Trying to publish MQTT Batch");
-                    err_code = bytebeam_publish_to_stream(bytebeam_batch_mqtt_client, batch_mqtt_stream, batch_json_data);
-
-                    if(err_code != BB_SUCCESS)
-                    {
-                        vTaskDelay(10 / portTICK_PERIOD_MS);
-                    }
-
-                } while(err_code != BB_SUCCESS);
+                *next_ms = (uint32_t)(due_ms - now_ms);
             }
-            else
+
+            continue;
+        }
+
+        taskENTER_CRITICAL(&stream_table_lock);
+
+        void *payload = stream->coalesced;
+        size_t payload_len = stream->coalesced_len;
+        bytebeam_encoding_t encoding = stream->coalesced_encoding;
+
+        stream->coalesced = NULL;
+
+        taskEXIT_CRITICAL(&stream_table_lock);
+
+        if (payload == NULL)
+        {
+            continue;
+        }
+
+        bytebeam_err_t err_code = stream_publish(stream, encoding, payload, payload_len, STREAM_ORIGIN_COALESCED, NULL, NULL);
+
+        if (err_code != BB_WOULD_BLOCK)
+        {
+            if (err_code != BB_SUCCESS)
             {
-                strcat(batch_json_data, json_paylaod);
-                strcat(batch_json_data, ",");   
+                // the entry may have been closed and opened for another stream meanwhile, so its name is not logged
+                BB_LOGE(TAG, "Failed to publish a coalesced publish, error %d", (int)err_code);
             }
+
+            free(payload);
+            continue;
+        }
+
+        // still held back, a newer publish coalesced meanwhile takes its place
+        taskENTER_CRITICAL(&stream_table_lock);
+
+        void *replaced = stream->coalesced;
+
+        if (replaced == NULL)
+        {
+            stream->coalesced = payload;
+            stream->coalesced_len = payload_len;
+            stream->coalesced_encoding = encoding;
         }
+
+        taskEXIT_CRITICAL(&stream_table_lock);
+
+        if (replaced != NULL)
+        {
+            free(payload);
+            bytebeam_rate_account(BYTEBEAM_RATE_POLICY_DROP, false);
+        }
+
+        due_ms = atomic_load(&stream->rate_due_ms);
+
+        // refused by the outbox rather than a rate limit, checked again shortly
+        uint32_t wait_ms = (due_ms > now_ms) ? (uint32_t)(due_ms - now_ms) : BYTEBEAM_FLOW_YIELD_MS;
+
+        if (wait_ms < *next_ms)
+        {
+            *next_ms = wait_ms;
+        }
+    }
+}
+
+bytebeam_err_t bytebeam_publish_buffer_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, const char *payload, size_t payload_len)
+{
+    return bytebeam_publish_encoded_to_stream(bytebeam_client, stream_name, BYTEBEAM_ENCODING_JSON, payload, payload_len);
+}
+
+bytebeam_err_t bytebeam_publish_to_stream(bytebeam_client_t *bytebeam_client, char *stream_name, char *payload)
+{
+    if (bytebeam_client == NULL || stream_name == NULL || payload == NULL)
+    {
+        return BB_NULL_CHECK_FAILURE;
     }
-}
\ No newline at end of file
+
+    return bytebeam_publish_buffer_to_stream(bytebeam_client, stream_name, payload, strlen(payload));
+}
@@ -0,0 +1,51 @@
+#include <stdatomic.h>
+#include "bytebeam_hal.h"
+#include "bytebeam_batch.h"
+#include "bytebeam_time.h"
+
+/* epoch milliseconds at uptime 0, 0 until the wall clock is set */
+static atomic_llong time_offset_ms = 0;
+
+static const char *TAG = "BYTEBEAM_TIME";
+
+bool bytebeam_time_sync(void)
+{
+    long long uptime_ms = bytebeam_hal_get_uptime_ms();
+    long long epoch_ms = (long long)bytebeam_hal_get_epoch_millis();
+
+    // a clock still counting from 1970 would stamp the held records with it
+    if (epoch_ms < BYTEBEAM_TIME_VALID_EPOCH_MS)
+    {
+        return atomic_load(&time_offset_ms) != 0;
+    }
+
+    // every sync follows the wall clock, so an SNTP step or slew is picked up by the records encoded after it
+    long long previous_ms = atomic_exchange(&time_offset_ms, epoch_ms - uptime_ms);
+
+    if (previous_ms == 0)
+    {
+        BB_LOGI(TAG, "Wall clock set, the records held for it are released");
+
+        // the MQTT task holds the records pushed before the sync until now
+        bytebeam_mqtt_thread_wake();
+    }
+
+    return true;
+}
+
+bool bytebeam_time_is_synced(void)
+{
+    return atomic_load(&time_offset_ms) != 0;
+}
+
+unsigned long long bytebeam_time_to_epoch_millis(long long uptime_us)
+{
+    long long offset_ms = atomic_load(&time_offset_ms);
+
+    if (offset_ms == 0)
+    {
+        return 0;
+    }
+
+    return (unsigned long long)(uptime_us / 1000 + offset_ms);
+}
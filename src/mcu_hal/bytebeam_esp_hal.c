@@ -6,16 +6,25 @@
 #include "esp_idf_version.h"
 #include "esp_spiffs.h"
 #include "esp_vfs_fat.h"
+#include "esp_rom_crc.h"
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include "esp_random.h"
+#else
+#include "esp_system.h"
+#endif
 #include "bytebeam_esp_hal.h"
 #include "bytebeam_ota.h"
 #include "bytebeam_action.h"
 #include "bytebeam_stream.h"
 #include "bytebeam_client.h"
+#include "bytebeam_inflight.h"
+#include "bytebeam_flow.h"
 
 static int ota_img_data_len = 0;
 static int ota_update_completed = 0;
 static char ota_action_id_str[BYTEBEAM_ACTION_ID_STR_LEN] = "";
 static bytebeam_client_t *ota_client = NULL;
+static wl_handle_t fatfs_wl_handle = WL_INVALID_HANDLE;
 
 static const char *TAG = "BYTEBEAM_HAL";
 
@@ -34,6 +43,30 @@ int bytebeam_hal_mqtt_publish(bytebeam_client_handle_t client, char *topic, char
     return esp_mqtt_client_publish(client, (const char *)topic, (const char *)message, length, qos, 1);
 }
 
+int bytebeam_hal_mqtt_enqueue(bytebeam_client_handle_t client, char *topic, char *message, int length, int qos)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 3, 0)
+    // the message is copied to the outbox and sent by the MQTT task, QoS 0 messages are only kept if stored
+    return esp_mqtt_client_enqueue(client, (const char *)topic, (const char *)message, length, qos, 1, true);
+#else
+    return esp_mqtt_client_publish(client, (const char *)topic, (const char *)message, length, qos, 1);
+#endif
+}
+
+int bytebeam_hal_mqtt_get_outbox_size(bytebeam_client_handle_t client)
+{
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    return esp_mqtt_client_get_outbox_size(client);
+#else
+    return -1;
+#endif
+}
+
+uint32_t bytebeam_hal_random(void)
+{
+    return esp_random();
+}
+
 int bytebeam_hal_restart(void)
 {
     esp_restart();
@@ -232,7 +265,7 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         BB_LOGI(TAG, "MQTT_EVENT_CONNECTED");
-        msg_id = bytebeam_subscribe_to_actions(bytebeam_client->device_cfg, client);
+        msg_id = bytebeam_subscribe_to_actions(bytebeam_client);
 
         if (msg_id != -1) {
             BB_LOGI(TAG, "MQTT SUBSCRIBED!! Msg ID:%d", msg_id);
@@ -241,6 +274,15 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         }
 
         bytebeam_client->connection_status = 1;
+
+        // the platform may have missed shadow updates while offline, the next one carries every field
+        bytebeam_shadow_request_snapshot();
+
+        // the dashboard is brought up to date right away instead of at the next push interval
+        bytebeam_shadow_request_publish();
+
+        // resume draining whatever was stored while offline
+        bytebeam_mqtt_thread_wake();
         break;
 
     case MQTT_EVENT_DISCONNECTED:
@@ -257,8 +299,26 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
         break;
 
     case MQTT_EVENT_PUBLISHED:
-        BB_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        BB_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+        bytebeam_inflight_complete(event->msg_id, BYTEBEAM_PUBLISH_ACKED);
+
+        // an acknowledgement may bring the outbox back under the low watermark
+        if (bytebeam_flow_is_paused()) {
+            bytebeam_flow_check(bytebeam_client, BYTEBEAM_PRIORITY_BULK);
+        }
+        break;
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+    case MQTT_EVENT_DELETED:
+        // the outbox expired the publish before it was acknowledged
+        BB_LOGW(TAG, "MQTT_EVENT_DELETED, msg_id=%d", event->msg_id);
+        bytebeam_inflight_complete(event->msg_id, BYTEBEAM_PUBLISH_TIMED_OUT);
+
+        if (bytebeam_flow_is_paused()) {
+            bytebeam_flow_check(bytebeam_client, BYTEBEAM_PRIORITY_BULK);
+        }
         break;
+#endif
 
     case MQTT_EVENT_DATA:
         BB_LOGI(TAG, "MQTT_EVENT_DATA");
@@ -421,7 +481,6 @@ int bytebeam_hal_start_mqtt(bytebeam_client_t *bytebeam_client)
         }
     }
 
-    xTaskCreate(bytebeam_user_thread_entry, "Bytebeam User Thread", 4*1024, bytebeam_client, 2, NULL);
     xTaskCreate(bytebeam_mqtt_thread_entry, "Bytebeam MQTT Thread", 8*1024, NULL, 2, NULL);
 
     return 0;
@@ -440,14 +499,14 @@ int bytebeam_hal_stop_mqtt(bytebeam_client_t *bytebeam_client)
     return 0;
 }
 
-int bytebeam_hal_spiffs_mount()
-{  
+int bytebeam_hal_spiffs_mount_partition(const char *base_path, const char *partition_label, int max_files)
+{
     esp_err_t err;
 
     esp_vfs_spiffs_conf_t conf = {
-        .base_path = "/spiffs",
-        .partition_label = NULL,
-        .max_files = 5,
+        .base_path = base_path,
+        .partition_label = partition_label,
+        .max_files = max_files,
         .format_if_mount_failed = true
     };
 
@@ -475,11 +534,11 @@ int bytebeam_hal_spiffs_mount()
     return 0;
 }
 
-int bytebeam_hal_spiffs_unmount()
+int bytebeam_hal_spiffs_unmount_partition(const char *partition_label)
 {
     esp_err_t err;
 
-    err = esp_vfs_spiffs_unregister(NULL);
+    err = esp_vfs_spiffs_unregister(partition_label);
 
     if (err != ESP_OK) {
         return -1;
@@ -488,17 +547,45 @@ int bytebeam_hal_spiffs_unmount()
     return 0;
 }
 
-int bytebeam_hal_fatfs_mount()
+int bytebeam_hal_spiffs_mount()
+{
+    return bytebeam_hal_spiffs_mount_partition("/spiffs", NULL, 5);
+}
+
+int bytebeam_hal_spiffs_unmount()
+{
+    return bytebeam_hal_spiffs_unmount_partition(NULL);
+}
+
+int bytebeam_hal_fatfs_mount_partition(const char *base_path, const char *partition_label, bool read_only)
 {
     esp_err_t err;
 
+    // only a writable partition may be formatted, a read only one is expected to be flashed with its contents
     const esp_vfs_fat_mount_config_t conf = {
             .max_files = 4,
-            .format_if_mount_failed = false,
+            .format_if_mount_failed = !read_only,
             .allocation_unit_size = CONFIG_WL_SECTOR_SIZE
     };
 
-    err = esp_vfs_fat_spiflash_mount_ro("/spiflash", "storage", &conf);
+    if (read_only)
+    {
+        err = esp_vfs_fat_spiflash_mount_ro(base_path, partition_label, &conf);
+    }
+    else
+    {
+        if (fatfs_wl_handle != WL_INVALID_HANDLE)
+        {
+            BB_LOGE(TAG, "Only one writable FATFS partition can be mounted");
+            return -1;
+        }
+
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+        err = esp_vfs_fat_spiflash_mount_rw_wl(base_path, partition_label, &conf, &fatfs_wl_handle);
+#else
+        err = esp_vfs_fat_spiflash_mount(base_path, partition_label, &conf, &fatfs_wl_handle);
+#endif
+    }
 
     if (err != ESP_OK)
     {
@@ -522,11 +609,27 @@ int bytebeam_hal_fatfs_mount()
     return 0;
 }
 
-int bytebeam_hal_fatfs_unmount()
+int bytebeam_hal_fatfs_unmount_partition(const char *base_path, const char *partition_label, bool read_only)
 {
     esp_err_t err;
 
-    err = esp_vfs_fat_spiflash_unmount_ro("/spiflash", "storage");
+    if (read_only)
+    {
+        err = esp_vfs_fat_spiflash_unmount_ro(base_path, partition_label);
+    }
+    else
+    {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+        err = esp_vfs_fat_spiflash_unmount_rw_wl(base_path, fatfs_wl_handle);
+#else
+        err = esp_vfs_fat_spiflash_unmount(base_path, fatfs_wl_handle);
+#endif
+
+        if (err == ESP_OK)
+        {
+            fatfs_wl_handle = WL_INVALID_HANDLE;
+        }
+    }
 
     if (err != ESP_OK) {
         return -1;
@@ -535,6 +638,21 @@ int bytebeam_hal_fatfs_unmount()
     return 0;
 }
 
+int bytebeam_hal_fatfs_mount()
+{
+    return bytebeam_hal_fatfs_mount_partition("/spiflash", "storage", true);
+}
+
+int bytebeam_hal_fatfs_unmount()
+{
+    return bytebeam_hal_fatfs_unmount_partition("/spiflash", "storage", true);
+}
+
+uint32_t bytebeam_hal_crc32(uint32_t crc, const void *buf, size_t len)
+{
+    return esp_rom_crc32_le(crc, buf, len);
+}
+
 unsigned long long bytebeam_hal_get_epoch_millis()
 {
     struct timeval te;
@@ -554,4 +672,9 @@ long long bytebeam_hal_get_uptime_ms()
     long long uptime = esp_timer_get_time();
     uptime = uptime/1000;
     return uptime;
-}
\ No newline at end of file
+}
+
+long long bytebeam_hal_get_uptime_us()
+{
+    return esp_timer_get_time();
+}
@@ -0,0 +1,156 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "bytebeam_action.h"
+#include "bytebeam_hal.h"
+#include "host_test.h"
+
+/*
+ *  Dispatch benchmark of the action table at 10, 100 and 1000 registered actions. The hashed lookup is timed on its
+ *  own and against a linear scan over the same names, the way the fixed handler array was searched, and a full
+ *  dispatch of an incoming action is timed including the parse of the message.
+ */
+
+#define BENCH_LOOKUPS 1000000
+#define BENCH_DISPATCHES 20000
+#define BENCH_MESSAGE_LEN 96
+
+typedef struct bench_linear_action {
+    char *name;
+    int (*func)(bytebeam_client_t *, char *, char *);
+} bench_linear_action_t;
+
+static const int bench_sizes[] = { 10, 100, 1000 };
+
+static portMUX_TYPE bench_linear_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int bench_calls;
+static int bench_next_id = 1;
+
+static int bench_handler(bytebeam_client_t *bytebeam_client, char *payload, char *action_id)
+{
+    bench_calls++;
+
+    return 0;
+}
+
+// a prime stride visits the names in a scattered order
+static int bench_pick(int iteration, int count)
+{
+    return (int)(((uint64_t)iteration * 7919) % (uint64_t)count);
+}
+
+// the baseline, first match wins like the loop over the fixed handler array did, under a lock like the table lookup
+static int (*bench_linear_find(const bench_linear_action_t *actions, int count, const char *name))(bytebeam_client_t *, char *, char *)
+{
+    int (*func)(bytebeam_client_t *, char *, char *) = NULL;
+
+    taskENTER_CRITICAL(&bench_linear_lock);
+
+    for (int loop_var = 0; loop_var < count; loop_var++)
+    {
+        if (!strcmp(actions[loop_var].name, name))
+        {
+            func = actions[loop_var].func;
+            break;
+        }
+    }
+
+    taskEXIT_CRITICAL(&bench_linear_lock);
+
+    return func;
+}
+
+static void bench_size(bytebeam_client_t *client, int count)
+{
+    char (*names)[32] = malloc((size_t)count * sizeof(*names));
+    bench_linear_action_t *linear = malloc((size_t)count * sizeof(*linear));
+    char (*messages)[BENCH_MESSAGE_LEN] = malloc(BENCH_DISPATCHES * sizeof(*messages));
+    int found = 0;
+
+    HOST_CHECK(names != NULL && linear != NULL && messages != NULL);
+    if (names == NULL || linear == NULL || messages == NULL)
+    {
+        free(messages);
+        free(linear);
+        free(names);
+        return;
+    }
+
+    for (int loop_var = 0; loop_var < count; loop_var++)
+    {
+        snprintf(names[loop_var], sizeof(names[loop_var]), "update_config_%d", loop_var);
+        linear[loop_var] = (bench_linear_action_t){ .name = names[loop_var], .func = bench_handler };
+        HOST_CHECK_EQ(bytebeam_add_action_handler(client, bench_handler, names[loop_var]), BB_SUCCESS);
+    }
+
+    // over every name in turn the linear scan compares against half the array on average
+    uint64_t start_ns = host_time_ns();
+
+    for (int loop_var = 0; loop_var < BENCH_LOOKUPS; loop_var++)
+    {
+        found += bytebeam_is_action_handler_there(client, names[bench_pick(loop_var, count)]) == BB_SUCCESS;
+    }
+
+    double hashed_ns = (double)(host_time_ns() - start_ns) / BENCH_LOOKUPS;
+
+    HOST_CHECK_EQ(found, BENCH_LOOKUPS);
+    found = 0;
+    start_ns = host_time_ns();
+
+    for (int loop_var = 0; loop_var < BENCH_LOOKUPS; loop_var++)
+    {
+        found += bench_linear_find(linear, count, names[bench_pick(loop_var, count)]) != NULL;
+    }
+
+    double linear_ns = (double)(host_time_ns() - start_ns) / BENCH_LOOKUPS;
+
+    HOST_CHECK_EQ(found, BENCH_LOOKUPS);
+
+    // the action ids have to keep increasing, so the messages are built before the clock starts
+    for (int loop_var = 0; loop_var < BENCH_DISPATCHES; loop_var++)
+    {
+        snprintf(messages[loop_var], sizeof(messages[loop_var]), "{\"id\": \"%d\", \"name\": \"%s\", \"payload\": \"{}\"}",
+                 bench_next_id++, names[bench_pick(loop_var, count)]);
+    }
+
+    bench_calls = 0;
+    start_ns = host_time_ns();
+
+    for (int loop_var = 0; loop_var < BENCH_DISPATCHES; loop_var++)
+    {
+        bytebeam_handle_actions(messages[loop_var], client->client, client);
+    }
+
+    double dispatch_ns = (double)(host_time_ns() - start_ns) / BENCH_DISPATCHES;
+
+    HOST_CHECK_EQ(bench_calls, BENCH_DISPATCHES);
+
+    printf("%4d actions: lookup %6.1f ns, linear scan %7.1f ns (%5.1fx), dispatch with parse %7.1f ns, %u slots\n",
+           count, hashed_ns, linear_ns, linear_ns / hashed_ns, dispatch_ns, (unsigned)client->action_funcs.capacity);
+
+    HOST_CHECK_EQ(bytebeam_reset_action_handler_array(client), BB_SUCCESS);
+
+    free(messages);
+    free(linear);
+    free(names);
+}
+
+int main(void)
+{
+    static bytebeam_client_t client;
+
+    snprintf(client.device_cfg.project_id, sizeof(client.device_cfg.project_id), "demo");
+    snprintf(client.device_cfg.device_id, sizeof(client.device_cfg.device_id), "1");
+    HOST_CHECK_EQ(bytebeam_action_topics_init(&client), BB_SUCCESS);
+
+    for (size_t loop_var = 0; loop_var < sizeof(bench_sizes) / sizeof(bench_sizes[0]); loop_var++)
+    {
+        bench_size(&client, bench_sizes[loop_var]);
+    }
+
+    bytebeam_action_topics_deinit(&client);
+
+    return host_test_result("bench_action_dispatch");
+}
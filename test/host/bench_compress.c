@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytebeam_compress.h"
+#include "host_test.h"
+
+/*
+ *  Compression benchmark on recorded batches: bytes saved against the time spent compressing, plus the size of the
+ *  output buffer each batch needs. Every compressed batch is decoded again and compared with the input.
+ */
+
+#define BENCH_ITERATIONS 200
+
+static const char *bench_batches[] = {
+    "data/acc_gyro.json",
+    "data/temp_humid.json",
+    "data/vehicle.json",
+};
+
+// output buffer sizes to check the fallback against, the batch goes out raw when it does not fit
+static const size_t bench_capacities[] = { 2048, 4096, 8192, 16384 };
+
+static char *bench_load(const char *path, size_t *len)
+{
+    FILE *file = fopen(path, "rb");
+    char *data = NULL;
+    long size = 0;
+
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = malloc((size_t)size);
+
+        if (data != NULL && fread(data, 1, (size_t)size, file) != (size_t)size)
+        {
+            free(data);
+            data = NULL;
+        }
+    }
+
+    fclose(file);
+
+    *len = (size_t)size;
+    return data;
+}
+
+// reference decoder of the format described in bytebeam_compress.h
+static bool bench_decompress(const uint8_t *in, size_t in_len, char *out, size_t out_capacity, size_t *out_len)
+{
+    if (in_len < BYTEBEAM_COMPRESS_HEADER_LEN)
+    {
+        return false;
+    }
+
+    size_t len = in[0] | (in[1] << 8) | (in[2] << 16) | ((size_t)in[3] << 24);
+    size_t ip = BYTEBEAM_COMPRESS_HEADER_LEN;
+    size_t op = 0;
+
+    if (len > out_capacity)
+    {
+        return false;
+    }
+
+    while (op < len)
+    {
+        if (ip >= in_len)
+        {
+            return false;
+        }
+
+        uint8_t flags = in[ip++];
+
+        for (int bit = 0; bit < 8 && op < len; bit++)
+        {
+            if (flags & (1 << bit))
+            {
+                if (ip >= in_len)
+                {
+                    return false;
+                }
+
+                out[op++] = (char)in[ip++];
+                continue;
+            }
+
+            if (ip + 2 > in_len)
+            {
+                return false;
+            }
+
+            size_t dist = ((size_t)(in[ip + 1] >> 4) << 8 | in[ip]) + 1;
+            size_t match_len = (in[ip + 1] & 0x0F) + 3;
+
+            ip += 2;
+
+            if (dist > op || op + match_len > len)
+            {
+                return false;
+            }
+
+            for (size_t loop_var = 0; loop_var < match_len; loop_var++, op++)
+            {
+                out[op] = out[op - dist];
+            }
+        }
+    }
+
+    *out_len = op;
+    return ip == in_len;
+}
+
+static void bench_batch(const char *path)
+{
+    size_t in_len = 0;
+    char *in = bench_load(path, &in_len);
+
+    HOST_CHECK(in != NULL);
+    if (in == NULL)
+    {
+        printf("%s: failed to load\n", path);
+        return;
+    }
+
+    size_t bound = bytebeam_compress_bound(in_len);
+    char *out = malloc(bound);
+    char *decoded = malloc(in_len);
+    size_t out_len = 0;
+    size_t decoded_len = 0;
+
+    HOST_CHECK_EQ(bytebeam_compress(in, in_len, out, bound, &out_len), BB_SUCCESS);
+    HOST_CHECK(bench_decompress((const uint8_t *)out, out_len, decoded, in_len, &decoded_len));
+    HOST_CHECK_EQ(decoded_len, in_len);
+    HOST_CHECK(memcmp(decoded, in, in_len) == 0);
+
+    uint64_t start_ns = host_time_ns();
+
+    for (int loop_var = 0; loop_var < BENCH_ITERATIONS; loop_var++)
+    {
+        bytebeam_compress(in, in_len, out, bound, &out_len);
+    }
+
+    double compress_us = (double)(host_time_ns() - start_ns) / BENCH_ITERATIONS / 1000.0;
+
+    // the stream only sends the compressed form if it is smaller, so a buffer of in_len - 1 is the most it offers
+    printf("%-22s %6zu -> %6zu bytes, saved %5.1f%%, %8.1f us, %5.1f MB/s, fits in:",
+           path, in_len, out_len, 100.0 * (double)(in_len - out_len) / (double)in_len,
+           compress_us, (double)in_len / compress_us);
+
+    for (size_t loop_var = 0; loop_var < sizeof(bench_capacities) / sizeof(bench_capacities[0]); loop_var++)
+    {
+        size_t capacity = bench_capacities[loop_var];
+        size_t capped_len = 0;
+        bytebeam_err_t err_code = bytebeam_compress(in, in_len, out, capacity, &capped_len);
+
+        // a capped compression either fits exactly as the uncapped one or gives up
+        HOST_CHECK_EQ(err_code, (out_len <= capacity) ? BB_SUCCESS : BB_FAILURE);
+        printf(" %zu:%s", capacity, (err_code == BB_SUCCESS) ? "yes" : "raw");
+    }
+    printf("\n");
+
+    free(decoded);
+    free(out);
+    free(in);
+}
+
+int main(void)
+{
+    for (size_t loop_var = 0; loop_var < sizeof(bench_batches) / sizeof(bench_batches[0]); loop_var++)
+    {
+        bench_batch(bench_batches[loop_var]);
+    }
+
+    return host_test_result("bench_compress");
+}
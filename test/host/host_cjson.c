@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cJSON.h"
+
+/*
+ *  Flat JSON objects of string values for the host tests, so the SDK code that reads actions runs unmodified.
+ */
+
+static const char *cjson_skip(const char *in)
+{
+    while (*in == ' ' || *in == '\t' || *in == '\r' || *in == '\n')
+    {
+        in++;
+    }
+
+    return in;
+}
+
+// reads the quoted string at in into a new allocation, the simple escapes are taken literally
+static const char *cjson_string(const char *in, char **out)
+{
+    const char *start = ++in;
+    size_t len = 0;
+
+    while (*in != '"')
+    {
+        if (*in == '\0' || (*in == '\\' && *++in == '\0'))
+        {
+            return NULL;
+        }
+
+        in++;
+        len++;
+    }
+
+    char *value = malloc(len + 1);
+
+    if (value == NULL)
+    {
+        return NULL;
+    }
+
+    for (size_t loop_var = 0; loop_var < len; loop_var++)
+    {
+        if (*start == '\\')
+        {
+            start++;
+        }
+
+        value[loop_var] = *start++;
+    }
+    value[len] = '\0';
+
+    *out = value;
+    return in + 1;
+}
+
+cJSON *cJSON_Parse(const char *value)
+{
+    cJSON *root = NULL;
+    cJSON *last = NULL;
+    const char *in = (value != NULL) ? cjson_skip(value) : NULL;
+
+    if (in == NULL || *in != '{' || (root = calloc(1, sizeof(cJSON))) == NULL)
+    {
+        return NULL;
+    }
+
+    root->type = cJSON_Object;
+    in = cjson_skip(in + 1);
+
+    if (*in == '}')
+    {
+        return root;
+    }
+
+    while (1)
+    {
+        cJSON *item = calloc(1, sizeof(cJSON));
+
+        if (item == NULL)
+        {
+            break;
+        }
+
+        item->type = cJSON_String;
+        item->prev = last;
+        if (last == NULL)
+        {
+            root->child = item;
+        }
+        else
+        {
+            last->next = item;
+        }
+        last = item;
+
+        if (*in != '"' || (in = cjson_string(in, &item->string)) == NULL)
+        {
+            break;
+        }
+
+        in = cjson_skip(in);
+        if (*in != ':')
+        {
+            break;
+        }
+
+        in = cjson_skip(in + 1);
+        if (*in != '"' || (in = cjson_string(in, &item->valuestring)) == NULL)
+        {
+            break;
+        }
+
+        in = cjson_skip(in);
+        if (*in == '}')
+        {
+            if (*cjson_skip(in + 1) == '\0')
+            {
+                return root;
+            }
+
+            break;
+        }
+
+        if (*in != ',')
+        {
+            break;
+        }
+
+        in = cjson_skip(in + 1);
+    }
+
+    cJSON_Delete(root);
+    return NULL;
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *const object, const char *const string)
+{
+    cJSON *item = (object != NULL) ? object->child : NULL;
+
+    while (item != NULL && (item->string == NULL || strcmp(item->string, string) != 0))
+    {
+        item = item->next;
+    }
+
+    return item;
+}
+
+cJSON_bool cJSON_IsString(const cJSON *const item)
+{
+    return item != NULL && item->type == cJSON_String;
+}
+
+void cJSON_Delete(cJSON *item)
+{
+    while (item != NULL)
+    {
+        cJSON *next = item->next;
+
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+
+        item = next;
+    }
+}
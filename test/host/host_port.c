@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "bytebeam_hal.h"
+#include "host_test.h"
+
+/*
+ *  FreeRTOS and HAL on top of pthreads so the SDK sources run unmodified on the host. Tasks are threads, one
+ *  recursive lock stands in for every critical section and the uptime follows CLOCK_MONOTONIC unless a test
+ *  freezes it with host_clock_set_ms().
+ */
+
+int host_test_failures = 0;
+
+static pthread_mutex_t port_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static pthread_mutex_t port_notify_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t port_notify_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t port_notify_count = 0;
+
+static atomic_llong port_frozen_ms = -1;
+static uint64_t port_start_ns = 0;
+
+static __thread char port_task_marker;
+
+static atomic_int port_mqtt_msg_id = 0;
+static atomic_int port_mqtt_published = 0;
+
+__attribute__((constructor)) static void port_init(void)
+{
+    port_start_ns = host_time_ns();
+}
+
+int host_test_result(const char *name)
+{
+    if (host_test_failures != 0)
+    {
+        printf("%s: %d check(s) failed\n", name, host_test_failures);
+        return EXIT_FAILURE;
+    }
+
+    printf("%s: passed\n", name);
+    return EXIT_SUCCESS;
+}
+
+uint64_t host_time_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void host_clock_set_ms(long long uptime_ms)
+{
+    atomic_store(&port_frozen_ms, uptime_ms);
+}
+
+static long long port_uptime_us(void)
+{
+    long long frozen_ms = atomic_load(&port_frozen_ms);
+
+    if (frozen_ms >= 0)
+    {
+        return frozen_ms * 1000;
+    }
+
+    return (long long)((host_time_ns() - port_start_ns) / 1000ULL);
+}
+
+void host_log(char level, const char *tag, const char *fmt, ...)
+{
+    static int enabled = -1;
+    va_list args;
+
+    if (enabled < 0)
+    {
+        enabled = getenv("BYTEBEAM_HOST_LOG") != NULL;
+    }
+
+    if (!enabled)
+    {
+        return;
+    }
+
+    va_start(args, fmt);
+    fprintf(stderr, "%c (%lld) %s: ", level, port_uptime_us() / 1000, tag);
+    vfprintf(stderr, fmt, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+void host_port_enter_critical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_lock(&port_critical);
+}
+
+void host_port_exit_critical(portMUX_TYPE *mux)
+{
+    (void)mux;
+    pthread_mutex_unlock(&port_critical);
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(port_uptime_us() / 1000);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec delay = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000L };
+
+    if (ticks == 0)
+    {
+        sched_yield();
+        return;
+    }
+
+    nanosleep(&delay, NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return &port_task_marker;
+}
+
+// the SDK only ever notifies the MQTT task, so one notification count serves the whole process
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    uint32_t count;
+
+    pthread_mutex_lock(&port_notify_lock);
+
+    if (port_notify_count == 0 && ticks_to_wait != 0)
+    {
+        struct timespec deadline;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += ticks_to_wait / 1000;
+        deadline.tv_nsec += (long)(ticks_to_wait % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (port_notify_count == 0)
+        {
+            if (ticks_to_wait == portMAX_DELAY)
+            {
+                pthread_cond_wait(&port_notify_cond, &port_notify_lock);
+            }
+            else if (pthread_cond_timedwait(&port_notify_cond, &port_notify_lock, &deadline) != 0)
+            {
+                break;
+            }
+        }
+    }
+
+    count = port_notify_count;
+    if (count != 0)
+    {
+        port_notify_count = clear_on_exit ? 0 : count - 1;
+    }
+
+    pthread_mutex_unlock(&port_notify_lock);
+
+    return count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    (void)task;
+
+    pthread_mutex_lock(&port_notify_lock);
+    port_notify_count++;
+    pthread_cond_signal(&port_notify_cond);
+    pthread_mutex_unlock(&port_notify_lock);
+
+    return pdPASS;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    pthread_mutex_t *mutex = malloc(sizeof(pthread_mutex_t));
+
+    if (mutex != NULL)
+    {
+        pthread_mutex_init(mutex, NULL);
+    }
+
+    return mutex;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait)
+{
+    (void)ticks_to_wait;
+
+    return pthread_mutex_lock((pthread_mutex_t *)semaphore) == 0 ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *)semaphore) == 0 ? pdTRUE : pdFALSE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    pthread_mutex_destroy((pthread_mutex_t *)semaphore);
+    free(semaphore);
+}
+
+int host_mqtt_published(void)
+{
+    return atomic_load(&port_mqtt_published);
+}
+
+// there is no broker, every publish is taken at once and counted so a test can tell it went out
+int bytebeam_hal_mqtt_subscribe(bytebeam_client_handle_t client, char *topic, int qos)
+{
+    return atomic_fetch_add(&port_mqtt_msg_id, 1) + 1;
+}
+
+int bytebeam_hal_mqtt_unsubscribe(bytebeam_client_handle_t client, char *topic)
+{
+    return atomic_fetch_add(&port_mqtt_msg_id, 1) + 1;
+}
+
+int bytebeam_hal_mqtt_publish(bytebeam_client_handle_t client, char *topic, char *message, int length, int qos)
+{
+    atomic_fetch_add(&port_mqtt_published, 1);
+
+    return (qos > 0) ? atomic_fetch_add(&port_mqtt_msg_id, 1) + 1 : 0;
+}
+
+int bytebeam_hal_mqtt_enqueue(bytebeam_client_handle_t client, char *topic, char *message, int length, int qos)
+{
+    return bytebeam_hal_mqtt_publish(client, topic, message, length, qos);
+}
+
+int bytebeam_hal_mqtt_get_outbox_size(bytebeam_client_handle_t client)
+{
+    return 0;
+}
+
+uint32_t bytebeam_hal_crc32(uint32_t crc, const void *buf, size_t len)
+{
+    const uint8_t *bytes = buf;
+
+    // same little endian CRC-32 as esp_rom_crc32_le
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *bytes++;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320U & (0U - (crc & 1U)));
+        }
+    }
+
+    return ~crc;
+}
+
+uint32_t bytebeam_hal_random(void)
+{
+    static atomic_uint state = 0x2545F491U;
+    uint32_t value = atomic_load(&state);
+    uint32_t next;
+
+    // xorshift32, fixed seed so the host runs are reproducible
+    do
+    {
+        next = value;
+        next ^= next << 13;
+        next ^= next >> 17;
+        next ^= next << 5;
+    } while (!atomic_compare_exchange_weak(&state, &value, next));
+
+    return next;
+}
+
+unsigned long long bytebeam_hal_get_epoch_millis()
+{
+    // a fixed epoch offset keeps the timestamps plausible and the runs reproducible
+    return 1700000000000ULL + (unsigned long long)(port_uptime_us() / 1000);
+}
+
+long long bytebeam_hal_get_uptime_ms()
+{
+    return port_uptime_us() / 1000;
+}
+
+long long bytebeam_hal_get_uptime_us()
+{
+    return port_uptime_us();
+}
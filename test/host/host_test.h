@@ -0,0 +1,57 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ *  Checks shared by the host tests. A failed check is reported and the test carries on, so one run shows every
+ *  failure; main returns host_test_result() so ctest sees the outcome.
+ */
+
+extern int host_test_failures;
+
+#define HOST_CHECK(cond)                                                                        \
+    do {                                                                                        \
+        if (!(cond)) {                                                                          \
+            host_test_failures++;                                                               \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);                     \
+        }                                                                                       \
+    } while (0)
+
+#define HOST_CHECK_EQ(actual, expected)                                                         \
+    do {                                                                                        \
+        long long actual_value = (long long)(actual);                                           \
+        long long expected_value = (long long)(expected);                                       \
+        if (actual_value != expected_value) {                                                   \
+            host_test_failures++;                                                               \
+            printf("%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__,        \
+                   #actual, #expected, actual_value, expected_value);                           \
+        }                                                                                       \
+    } while (0)
+
+#define HOST_CHECK_NEAR(actual, expected, tolerance)                                            \
+    do {                                                                                        \
+        double actual_value = (double)(actual);                                                 \
+        double expected_value = (double)(expected);                                             \
+        double diff = actual_value - expected_value;                                            \
+        if (!(diff <= (tolerance) && diff >= -(tolerance))) {                                   \
+            host_test_failures++;                                                               \
+            printf("%s:%d: check failed: %s ~ %s (%.9g != %.9g)\n", __FILE__, __LINE__,         \
+                   #actual, #expected, actual_value, expected_value);                           \
+        }                                                                                       \
+    } while (0)
+
+/* Print the outcome of the test and return the process exit status */
+int host_test_result(const char *name);
+
+/* Monotonic host time in nanoseconds, for the benchmarks */
+uint64_t host_time_ns(void);
+
+/* Freeze the uptime and tick count seen by the SDK at uptime_ms, a negative value lets them follow the host clock */
+void host_clock_set_ms(long long uptime_ms);
+
+/* Number of messages handed to the fake MQTT publish so far */
+int host_mqtt_published(void);
+
+#endif /* HOST_TEST_H */
@@ -0,0 +1,31 @@
+#ifndef HOST_CJSON_H
+#define HOST_CJSON_H
+
+/*
+ *  The part of the cJSON API the SDK uses to read actions. host_cjson.c parses flat objects of string values,
+ *  which is all an action carries, anything else fails to parse.
+ */
+
+#define cJSON_Invalid (0)
+#define cJSON_String  (1 << 4)
+#define cJSON_Object  (1 << 6)
+
+typedef struct cJSON {
+    struct cJSON *next;
+    struct cJSON *prev;
+    struct cJSON *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+typedef int cJSON_bool;
+
+cJSON *cJSON_Parse(const char *value);
+cJSON *cJSON_GetObjectItem(const cJSON *const object, const char *const string);
+cJSON_bool cJSON_IsString(const cJSON *const item);
+void cJSON_Delete(cJSON *item);
+
+#endif /* HOST_CJSON_H */
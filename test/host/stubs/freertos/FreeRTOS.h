@@ -0,0 +1,35 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+/* The part of FreeRTOS the SDK uses, backed by pthreads in host_port.c */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { 0 }
+#define portMAX_DELAY ((TickType_t)0xffffffffU)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+
+// all critical sections share one recursive lock, like a single core port would
+void host_port_enter_critical(portMUX_TYPE *mux);
+void host_port_exit_critical(portMUX_TYPE *mux);
+
+#define taskENTER_CRITICAL(mux) host_port_enter_critical(mux)
+#define taskEXIT_CRITICAL(mux) host_port_exit_critical(mux)
+
+#endif /* HOST_FREERTOS_H */
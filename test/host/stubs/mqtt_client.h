@@ -0,0 +1,19 @@
+#ifndef HOST_MQTT_CLIENT_H
+#define HOST_MQTT_CLIENT_H
+
+/* Client types of the esp-mqtt component, the host port never talks to a broker */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef struct esp_mqtt_client_config {
+    const char *uri;
+} esp_mqtt_client_config_t;
+
+#endif /* HOST_MQTT_CLIENT_H */
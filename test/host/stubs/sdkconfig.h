@@ -0,0 +1,52 @@
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+/*
+ *  Configuration the host tests build the SDK sources with. Values follow the Kconfig defaults, the optional
+ *  features the host tests exercise are switched on.
+ */
+
+#define CONFIG_BYTEBEAM_LOGGING_LEVEL 3
+#define CONFIG_BYTEBEAM_CLOUD_LOG_MESSAGE_SIZE 256
+#define CONFIG_BYTEBEAM_CLOUD_LOGGING_STREAM "logs"
+#define CONFIG_BYTEBEAM_MESSAGE_ENCODING_IS_JSON 1
+#define CONFIG_BYTEBEAM_COMPRESSION_IS_ENABLED 1
+#define CONFIG_BYTEBEAM_COMPRESSION_THRESHOLD 256
+#define CONFIG_BYTEBEAM_COMPRESSION_BUFFER_SIZE 8192
+#define CONFIG_BYTEBEAM_MAX_INFLIGHT_PUBLISHES 32
+#define CONFIG_BYTEBEAM_PUBLISH_ACK_TIMEOUT_MS 30000
+#define CONFIG_BYTEBEAM_OUTBOX_HIGH_WATERMARK 16384
+#define CONFIG_BYTEBEAM_OUTBOX_LOW_WATERMARK 8192
+#define CONFIG_BYTEBEAM_INFLIGHT_HIGH_WATERMARK 24
+#define CONFIG_BYTEBEAM_INFLIGHT_LOW_WATERMARK 12
+#define CONFIG_BYTEBEAM_CONTROL_OUTBOX_RESERVE 4096
+#define CONFIG_BYTEBEAM_CONTROL_YIELD_MAX 1000
+#define CONFIG_BYTEBEAM_RATE_GLOBAL_BYTES_PER_SEC 0
+#define CONFIG_BYTEBEAM_RATE_GLOBAL_BURST_BYTES 0
+#define CONFIG_BYTEBEAM_RATE_GLOBAL_POLICY 0
+#define CONFIG_BYTEBEAM_MAX_OPEN_STREAMS 16
+
+#define CONFIG_NUM_MESSAGES_IN_MQTT_BATCH 125
+#define CONFIG_MQTT_BATCH_ELEMENT_SIZE 250
+#define CONFIG_MQTT_BATCH_MAX_STREAMS 4
+#define CONFIG_MQTT_BATCH_BUFFER_COUNT 2
+#define CONFIG_MQTT_BATCH_MAX_LINGER 5000
+#define CONFIG_MQTT_BATCH_RETRY_BASE 100
+#define CONFIG_MQTT_BATCH_RETRY_MAX 30000
+#define CONFIG_MQTT_BATCH_RETRY_MAX_ATTEMPTS 0
+#define CONFIG_MQTT_BATCH_RETRY_MAX_AGE 0
+#define CONFIG_MQTT_BATCH_QUEUE_DEPTH 32
+#define CONFIG_MQTT_BATCH_QUEUE_POLICY 0
+#define CONFIG_MQTT_BATCH_QUEUE_BLOCK_TIMEOUT 0
+
+#define CONFIG_DEVICE_SHADOW_STATUS "Device is Online"
+#define CONFIG_DEVICE_SHADOW_SOFTWARE_TYPE "bytebeam-app"
+#define CONFIG_DEVICE_SHADOW_SOFTWARE_VERSION "v0.1.0"
+#define CONFIG_DEVICE_SHADOW_HARDWARE_TYPE "Bytebeam ESP32"
+#define CONFIG_DEVICE_SHADOW_HARDWARE_VERSION "rev1"
+#define CONFIG_DEVICE_SHADOW_CUSTOM_JSON_STR_LEN 512
+#define CONFIG_DEVICE_SHADOW_MAX_FIELDS 16
+#define CONFIG_DEVICE_SHADOW_PUSH_INTERVAL 40
+#define CONFIG_DEVICE_SHADOW_SNAPSHOT_INTERVAL 3600
+
+#endif /* HOST_SDKCONFIG_H */
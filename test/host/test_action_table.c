@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytebeam_action.h"
+#include "bytebeam_hal.h"
+#include "host_test.h"
+
+/*
+ *  Randomized check of the action table against a reference set. Adds, removes, updates, lookups, reserves, resets
+ *  and dispatches of incoming actions are drawn at random over a pool of names, and every outcome is compared with a
+ *  plain array holding the handler each name should have. The pool is larger than the default table so the table
+ *  grows, and the removes empty it again so the backward shift deletes run over long probe chains.
+ */
+
+#define ACTION_TEST_NAMES 300
+#define ACTION_TEST_HANDLERS 4
+#define ACTION_TEST_OPERATIONS 200000
+#define ACTION_TEST_SWEEP_EVERY 5000
+
+static char action_test_names[ACTION_TEST_NAMES][32];
+static int action_test_reference[ACTION_TEST_NAMES];
+static int action_test_reference_count;
+
+static int action_test_called;
+static char action_test_payload[64];
+static char action_test_action_id[BYTEBEAM_ACTION_ID_STR_LEN];
+static int action_test_next_id = 1;
+static uint32_t action_test_state = 0x9E3779B9U;
+
+static int action_test_record(int handler, char *payload, char *action_id)
+{
+    action_test_called = handler;
+    snprintf(action_test_payload, sizeof(action_test_payload), "%s", payload);
+    snprintf(action_test_action_id, sizeof(action_test_action_id), "%s", action_id);
+
+    return 0;
+}
+
+static int action_test_handler_0(bytebeam_client_t *bytebeam_client, char *payload, char *action_id)
+{
+    return action_test_record(0, payload, action_id);
+}
+
+static int action_test_handler_1(bytebeam_client_t *bytebeam_client, char *payload, char *action_id)
+{
+    return action_test_record(1, payload, action_id);
+}
+
+static int action_test_handler_2(bytebeam_client_t *bytebeam_client, char *payload, char *action_id)
+{
+    return action_test_record(2, payload, action_id);
+}
+
+static int action_test_handler_3(bytebeam_client_t *bytebeam_client, char *payload, char *action_id)
+{
+    return action_test_record(3, payload, action_id);
+}
+
+static int (*const action_test_handlers[ACTION_TEST_HANDLERS])(bytebeam_client_t *, char *, char *) = {
+    action_test_handler_0,
+    action_test_handler_1,
+    action_test_handler_2,
+    action_test_handler_3,
+};
+
+static uint32_t action_test_random(uint32_t bound)
+{
+    // xorshift32 with a seed of its own, so a failing run can be replayed
+    action_test_state ^= action_test_state << 13;
+    action_test_state ^= action_test_state >> 17;
+    action_test_state ^= action_test_state << 5;
+
+    return action_test_state % bound;
+}
+
+static void action_test_dispatch(bytebeam_client_t *client, int name)
+{
+    char message[128];
+    int published = host_mqtt_published();
+
+    action_test_called = -1;
+    action_test_payload[0] = '\0';
+
+    snprintf(message, sizeof(message), "{\"id\": \"%d\", \"name\": \"%s\", \"payload\": \"{\\\"name\\\": \\\"%s\\\"}\"}",
+             action_test_next_id++, action_test_names[name], action_test_names[name]);
+
+    HOST_CHECK_EQ(bytebeam_handle_actions(message, client->client, client), 0);
+    HOST_CHECK_EQ(action_test_called, action_test_reference[name]);
+
+    if (action_test_reference[name] == -1)
+    {
+        // an action without a handler is answered with a failed status instead
+        HOST_CHECK_EQ(host_mqtt_published(), published + 1);
+    }
+    else
+    {
+        char payload[64];
+
+        snprintf(payload, sizeof(payload), "{\"name\": \"%s\"}", action_test_names[name]);
+        HOST_CHECK(strcmp(action_test_payload, payload) == 0);
+        HOST_CHECK_EQ(atoi(action_test_action_id), action_test_next_id - 1);
+        HOST_CHECK_EQ(host_mqtt_published(), published);
+    }
+}
+
+static void action_test_sweep(bytebeam_client_t *client)
+{
+    HOST_CHECK_EQ(client->action_funcs.count, action_test_reference_count);
+
+    for (int name = 0; name < ACTION_TEST_NAMES; name++)
+    {
+        bytebeam_err_t expected = (action_test_reference[name] != -1) ? BB_SUCCESS : BB_FAILURE;
+
+        HOST_CHECK_EQ(bytebeam_is_action_handler_there(client, action_test_names[name]), expected);
+    }
+
+    // at most three quarters full, and the count matches the occupied slots
+    uint32_t occupied = 0;
+
+    for (uint32_t slot = 0; slot < client->action_funcs.capacity; slot++)
+    {
+        occupied += (client->action_funcs.slots[slot].name != NULL);
+    }
+
+    HOST_CHECK_EQ(occupied, client->action_funcs.count);
+    HOST_CHECK(client->action_funcs.count <= client->action_funcs.capacity - client->action_funcs.capacity / 4);
+    HOST_CHECK_EQ(bytebeam_print_action_handler_array(client), BB_SUCCESS);
+}
+
+static void action_test_random_operations(bytebeam_client_t *client)
+{
+    int counts[7] = { 0 };
+
+    for (int operation = 0; operation < ACTION_TEST_OPERATIONS; operation++)
+    {
+        int name = (int)action_test_random(ACTION_TEST_NAMES);
+        int handler = (int)action_test_random(ACTION_TEST_HANDLERS);
+        uint32_t kind = action_test_random(1000);
+        bool present = action_test_reference[name] != -1;
+
+        // adds and removes dominate, a reset is rare so the table spends most of the run well populated
+        if (kind < 350)
+        {
+            counts[0]++;
+            HOST_CHECK_EQ(bytebeam_add_action_handler(client, action_test_handlers[handler], action_test_names[name]), present ? BB_FAILURE : BB_SUCCESS);
+
+            if (!present)
+            {
+                action_test_reference[name] = handler;
+                action_test_reference_count++;
+            }
+        }
+        else if (kind < 600)
+        {
+            counts[1]++;
+            HOST_CHECK_EQ(bytebeam_remove_action_handler(client, action_test_names[name]), present ? BB_SUCCESS : BB_FAILURE);
+
+            if (present)
+            {
+                action_test_reference[name] = -1;
+                action_test_reference_count--;
+            }
+        }
+        else if (kind < 700)
+        {
+            counts[2]++;
+            HOST_CHECK_EQ(bytebeam_update_action_handler(client, action_test_handlers[handler], action_test_names[name]), present ? BB_SUCCESS : BB_FAILURE);
+
+            if (present)
+            {
+                action_test_reference[name] = handler;
+            }
+        }
+        else if (kind < 850)
+        {
+            counts[3]++;
+            HOST_CHECK_EQ(bytebeam_is_action_handler_there(client, action_test_names[name]), present ? BB_SUCCESS : BB_FAILURE);
+        }
+        else if (kind < 998)
+        {
+            counts[4]++;
+            action_test_dispatch(client, name);
+        }
+        else if (kind < 999)
+        {
+            counts[5]++;
+            HOST_CHECK_EQ(bytebeam_reserve_action_handlers(client, action_test_random(2 * ACTION_TEST_NAMES)), BB_SUCCESS);
+        }
+        else
+        {
+            counts[6]++;
+            HOST_CHECK_EQ(bytebeam_reset_action_handler_array(client), BB_SUCCESS);
+
+            for (int loop_var = 0; loop_var < ACTION_TEST_NAMES; loop_var++)
+            {
+                action_test_reference[loop_var] = -1;
+            }
+            action_test_reference_count = 0;
+        }
+
+        if ((operation + 1) % ACTION_TEST_SWEEP_EVERY == 0)
+        {
+            action_test_sweep(client);
+        }
+    }
+
+    printf("add %d remove %d update %d lookup %d dispatch %d reserve %d reset %d, %u actions in %u slots at the end\n",
+           counts[0], counts[1], counts[2], counts[3], counts[4], counts[5], counts[6],
+           (unsigned)client->action_funcs.count, (unsigned)client->action_funcs.capacity);
+}
+
+static void action_test_invalid(bytebeam_client_t *client)
+{
+    HOST_CHECK_EQ(bytebeam_add_action_handler(NULL, action_test_handler_0, "name"), BB_NULL_CHECK_FAILURE);
+    HOST_CHECK_EQ(bytebeam_add_action_handler(client, NULL, "name"), BB_NULL_CHECK_FAILURE);
+    HOST_CHECK_EQ(bytebeam_add_action_handler(client, action_test_handler_0, NULL), BB_NULL_CHECK_FAILURE);
+    HOST_CHECK_EQ(bytebeam_remove_action_handler(client, NULL), BB_NULL_CHECK_FAILURE);
+    HOST_CHECK_EQ(bytebeam_update_action_handler(client, NULL, "name"), BB_NULL_CHECK_FAILURE);
+    HOST_CHECK_EQ(bytebeam_is_action_handler_there(NULL, "name"), BB_NULL_CHECK_FAILURE);
+    HOST_CHECK_EQ(bytebeam_reserve_action_handlers(NULL, 10), BB_NULL_CHECK_FAILURE);
+
+    // an empty table has nothing to find, remove or update
+    HOST_CHECK_EQ(bytebeam_is_action_handler_there(client, "name"), BB_FAILURE);
+    HOST_CHECK_EQ(bytebeam_remove_action_handler(client, "name"), BB_FAILURE);
+    HOST_CHECK_EQ(bytebeam_update_action_handler(client, action_test_handler_0, "name"), BB_FAILURE);
+
+    // actions that do not parse never reach a handler
+    char not_json[] = "update_firmware";
+    char no_payload[] = "{\"id\": \"1000000\", \"name\": \"update_firmware\"}";
+
+    HOST_CHECK_EQ(bytebeam_handle_actions(not_json, client->client, client), -1);
+    HOST_CHECK_EQ(bytebeam_handle_actions(no_payload, client->client, client), -1);
+}
+
+int main(void)
+{
+    static bytebeam_client_t client;
+
+    snprintf(client.device_cfg.project_id, sizeof(client.device_cfg.project_id), "demo");
+    snprintf(client.device_cfg.device_id, sizeof(client.device_cfg.device_id), "1");
+    HOST_CHECK_EQ(bytebeam_action_topics_init(&client), BB_SUCCESS);
+
+    // names of varying length and shared prefixes, the way applications tend to name their actions
+    for (int name = 0; name < ACTION_TEST_NAMES; name++)
+    {
+        static const char *const prefixes[] = { "update_", "update_firmware_", "a", "set_config_value_" };
+
+        snprintf(action_test_names[name], sizeof(action_test_names[name]), "%s%d", prefixes[name % 4], name);
+        action_test_reference[name] = -1;
+    }
+
+    action_test_invalid(&client);
+    action_test_random_operations(&client);
+    action_test_sweep(&client);
+
+    bytebeam_reset_action_handler_array(&client);
+    bytebeam_action_topics_deinit(&client);
+
+    return host_test_result("test_action_table");
+}
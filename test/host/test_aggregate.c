@@ -0,0 +1,221 @@
+#include <string.h>
+
+#include "bytebeam_aggregate.h"
+#include "host_test.h"
+
+/*
+ *  Aggregation check against an offline reference. Fixed samples are pushed at fixed uptimes, the emitted records
+ *  are captured by a fake batch stream and compared with the count, min, max, mean and population variance worked
+ *  out offline with the two pass formulas over the samples of each window.
+ */
+
+#define AGGREGATE_TEST_MAX_RECORDS 32
+#define AGGREGATE_TEST_TOLERANCE 1e-9
+
+typedef struct aggregate_test_expected {
+    long long emitted_ms;
+    int64_t count;
+    double min;
+    double max;
+    double mean;
+    double var;
+} aggregate_test_expected_t;
+
+typedef struct aggregate_test_sample {
+    long long uptime_ms;
+    double value;
+} aggregate_test_sample_t;
+
+static char aggregate_test_batch;
+static bytebeam_field_t aggregate_test_schema[BYTEBEAM_BATCH_MAX_FIELDS];
+static char aggregate_test_names[BYTEBEAM_BATCH_MAX_FIELDS][32];
+static int aggregate_test_num_fields;
+static bytebeam_field_value_t aggregate_test_records[AGGREGATE_TEST_MAX_RECORDS][BYTEBEAM_BATCH_MAX_FIELDS];
+static long long aggregate_test_record_ms[AGGREGATE_TEST_MAX_RECORDS];
+static int aggregate_test_num_records;
+static long long aggregate_test_now_ms;
+
+bytebeam_err_t bytebeam_batch_register_schema(bytebeam_batch_handle_t handle, const bytebeam_field_t *fields, int num_fields)
+{
+    // the aggregation frees the names once registered, so they are copied like the batch stream does
+    for (int loop_var = 0; loop_var < num_fields; loop_var++)
+    {
+        snprintf(aggregate_test_names[loop_var], sizeof(aggregate_test_names[loop_var]), "%s", fields[loop_var].name);
+        aggregate_test_schema[loop_var].name = aggregate_test_names[loop_var];
+        aggregate_test_schema[loop_var].type = fields[loop_var].type;
+    }
+
+    aggregate_test_num_fields = num_fields;
+
+    return BB_SUCCESS;
+}
+
+bytebeam_err_t bytebeam_stream_record_push_values(bytebeam_batch_handle_t handle, const bytebeam_field_value_t *values)
+{
+    if (aggregate_test_num_records == AGGREGATE_TEST_MAX_RECORDS)
+    {
+        return BB_FAILURE;
+    }
+
+    memcpy(aggregate_test_records[aggregate_test_num_records], values, aggregate_test_num_fields * sizeof(bytebeam_field_value_t));
+    aggregate_test_record_ms[aggregate_test_num_records] = aggregate_test_now_ms;
+    aggregate_test_num_records++;
+
+    return BB_SUCCESS;
+}
+
+static void aggregate_test_at(long long uptime_ms)
+{
+    aggregate_test_now_ms = uptime_ms;
+    host_clock_set_ms(uptime_ms);
+}
+
+static bytebeam_aggregate_handle_t aggregate_test_init(const char *const *field_names, int num_fields, uint32_t window_ms, uint32_t slide_ms)
+{
+    bytebeam_aggregate_config_t config = { .window_ms = window_ms, .slide_ms = slide_ms };
+    bytebeam_aggregate_handle_t handle = NULL;
+
+    aggregate_test_num_fields = 0;
+    aggregate_test_num_records = 0;
+
+    HOST_CHECK_EQ(bytebeam_aggregate_init((bytebeam_batch_handle_t)&aggregate_test_batch, field_names, num_fields, &config, &handle), BB_SUCCESS);
+
+    return handle;
+}
+
+static void aggregate_test_check_record(int record, int field, const aggregate_test_expected_t *expected)
+{
+    const bytebeam_field_value_t *values = aggregate_test_records[record];
+    const bytebeam_field_value_t *field_values = &values[1 + field * 4];
+
+    HOST_CHECK_EQ(aggregate_test_record_ms[record], expected->emitted_ms);
+    HOST_CHECK_EQ(values[0].int_value, expected->count);
+    HOST_CHECK_NEAR(field_values[0].double_value, expected->min, AGGREGATE_TEST_TOLERANCE);
+    HOST_CHECK_NEAR(field_values[1].double_value, expected->max, AGGREGATE_TEST_TOLERANCE);
+    HOST_CHECK_NEAR(field_values[2].double_value, expected->mean, AGGREGATE_TEST_TOLERANCE);
+    HOST_CHECK_NEAR(field_values[3].double_value, expected->var, AGGREGATE_TEST_TOLERANCE);
+}
+
+static void aggregate_test_tumbling(void)
+{
+    static const char *const field_names[] = { "temp", "hum" };
+    static const char *const schema_names[] = {
+        "count", "temp_min", "temp_max", "temp_mean", "temp_var", "hum_min", "hum_max", "hum_mean", "hum_var"
+    };
+    static const long long uptimes[] = { 1000, 1200, 1500, 1900, 2100, 2500 };
+    static const double samples[][2] = { { 20.5, 40 }, { 21.0, 42 }, { 19.5, 41 }, { 22.0, 45 }, { 23.0, 50 }, { 25.0, 50 } };
+    static const aggregate_test_expected_t temp[] = {
+        { 2100, 4, 19.5, 22.0, 20.75, 0.8125 },
+        { 3000, 2, 23.0, 25.0, 24.0, 1.0 },
+    };
+    static const aggregate_test_expected_t hum[] = {
+        { 2100, 4, 40, 45, 42, 3.5 },
+        { 3000, 2, 50, 50, 50, 0 },
+    };
+
+    bytebeam_aggregate_handle_t handle = aggregate_test_init(field_names, 2, 1000, 0);
+
+    HOST_CHECK_EQ(aggregate_test_num_fields, 9);
+    for (int loop_var = 0; loop_var < aggregate_test_num_fields && loop_var < 9; loop_var++)
+    {
+        HOST_CHECK(strcmp(aggregate_test_schema[loop_var].name, schema_names[loop_var]) == 0);
+        HOST_CHECK_EQ(aggregate_test_schema[loop_var].type, (loop_var == 0) ? BYTEBEAM_FIELD_TYPE_INT64 : BYTEBEAM_FIELD_TYPE_DOUBLE);
+    }
+
+    for (int loop_var = 0; loop_var < 6; loop_var++)
+    {
+        aggregate_test_at(uptimes[loop_var]);
+        HOST_CHECK_EQ(bytebeam_aggregate_push(handle, samples[loop_var]), BB_SUCCESS);
+    }
+
+    // the second window closes without a sample after it, the idle ones after it are not emitted
+    aggregate_test_at(3000);
+    HOST_CHECK_EQ(bytebeam_aggregate_poll(handle), BB_SUCCESS);
+    aggregate_test_at(6500);
+    HOST_CHECK_EQ(bytebeam_aggregate_poll(handle), BB_SUCCESS);
+
+    HOST_CHECK_EQ(aggregate_test_num_records, 2);
+    for (int loop_var = 0; loop_var < 2 && loop_var < aggregate_test_num_records; loop_var++)
+    {
+        aggregate_test_check_record(loop_var, 0, &temp[loop_var]);
+        aggregate_test_check_record(loop_var, 1, &hum[loop_var]);
+    }
+
+    bytebeam_aggregate_deinit(handle);
+}
+
+static void aggregate_test_sliding(void)
+{
+    static const char *const field_names[] = { "level" };
+    static const double values[] = {
+        3.5, -1.25, 7.0, 2.0, 0.5, 9.75, -4.0, 6.25, 1.0, 8.5, -2.5, 5.0, 4.25, -0.75, 10.0, 3.0, 2.25, -6.5, 7.75, 0.0
+    };
+    // a gap longer than the window, then a few samples around a pane boundary
+    static const aggregate_test_sample_t late[] = { { 19300, 12.5 }, { 19400, -3.0 }, { 19800, 4.0 }, { 20100, 1.5 } };
+    // windows of 3 s every 1 s from the first sample at 10 s, each emitted by the first push or poll after it closes
+    static const aggregate_test_expected_t expected[] = {
+        { 11000,  4, -1.25,  7.0,  2.8125,             8.79296875 },
+        { 12000,  8, -4.0,   9.75, 2.96875,            18.3349609375 },
+        { 13000, 12, -4.0,   9.75, 2.9791666666666665, 17.931857638888893 },
+        { 14000, 12, -4.0,  10.0,  3.4166666666666665, 20.201388888888889 },
+        { 19300, 12, -6.5,  10.0,  2.6666666666666665, 21.180555555555554 },
+        { 19300,  8, -6.5,  10.0,  2.5,                23.125 },
+        { 19300,  4, -6.5,   7.75, 0.875,              26.078125 },
+        { 20100,  3, -3.0,  12.5,  4.5,                40.166666666666664 },
+        { 26000,  4, -3.0,  12.5,  3.75,               31.8125 },
+        { 26000,  4, -3.0,  12.5,  3.75,               31.8125 },
+        { 26000,  1,  1.5,   1.5,  1.5,                0 },
+    };
+    int num_expected = sizeof(expected) / sizeof(expected[0]);
+
+    bytebeam_aggregate_handle_t handle = aggregate_test_init(field_names, 1, 3000, 1000);
+
+    for (int loop_var = 0; loop_var < (int)(sizeof(values) / sizeof(values[0])); loop_var++)
+    {
+        aggregate_test_at(10000 + loop_var * 250);
+        HOST_CHECK_EQ(bytebeam_aggregate_push(handle, &values[loop_var]), BB_SUCCESS);
+    }
+
+    for (int loop_var = 0; loop_var < (int)(sizeof(late) / sizeof(late[0])); loop_var++)
+    {
+        aggregate_test_at(late[loop_var].uptime_ms);
+        HOST_CHECK_EQ(bytebeam_aggregate_push(handle, &late[loop_var].value), BB_SUCCESS);
+    }
+
+    aggregate_test_at(26000);
+    HOST_CHECK_EQ(bytebeam_aggregate_poll(handle), BB_SUCCESS);
+
+    HOST_CHECK_EQ(aggregate_test_num_records, num_expected);
+    for (int loop_var = 0; loop_var < num_expected && loop_var < aggregate_test_num_records; loop_var++)
+    {
+        aggregate_test_check_record(loop_var, 0, &expected[loop_var]);
+    }
+
+    bytebeam_aggregate_deinit(handle);
+}
+
+static void aggregate_test_invalid(void)
+{
+    static const char *const field_names[] = { "level" };
+    bytebeam_aggregate_config_t config = { .window_ms = 3000, .slide_ms = 700 };
+    bytebeam_aggregate_handle_t handle = NULL;
+
+    // the window must be a whole number of panes, and no more than the maximum
+    HOST_CHECK_EQ(bytebeam_aggregate_init((bytebeam_batch_handle_t)&aggregate_test_batch, field_names, 1, &config, &handle), BB_FAILURE);
+
+    config.slide_ms = 100;
+    HOST_CHECK_EQ(bytebeam_aggregate_init((bytebeam_batch_handle_t)&aggregate_test_batch, field_names, 1, &config, &handle), BB_FAILURE);
+
+    config.slide_ms = 1000;
+    HOST_CHECK_EQ(bytebeam_aggregate_init((bytebeam_batch_handle_t)&aggregate_test_batch, field_names, 0, &config, &handle), BB_FAILURE);
+    HOST_CHECK_EQ(bytebeam_aggregate_init(NULL, field_names, 1, &config, &handle), BB_NULL_CHECK_FAILURE);
+}
+
+int main(void)
+{
+    aggregate_test_tumbling();
+    aggregate_test_sliding();
+    aggregate_test_invalid();
+
+    return host_test_result("test_aggregate");
+}
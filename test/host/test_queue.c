@@ -0,0 +1,207 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bytebeam_queue.h"
+#include "host_test.h"
+
+/*
+ *  Stress test of the batch queue: several producers push tagged records once each while a single consumer drains
+ *  the queue. Every record that was pushed must come out exactly once or be accounted for by the queue counters,
+ *  and records of one producer must come out in the order they were pushed.
+ */
+
+#define QUEUE_TEST_PRODUCERS 4
+#define QUEUE_TEST_RECORDS 80000
+#define QUEUE_TEST_RECORDS_PER_PRODUCER (QUEUE_TEST_RECORDS / QUEUE_TEST_PRODUCERS)
+#define QUEUE_TEST_DEPTH 64
+#define QUEUE_TEST_BLOCK_TIMEOUT_MS 10000
+
+typedef struct queue_test_record {
+    uint32_t producer;
+    uint32_t seq;
+    char padding[24];
+} queue_test_record_t;
+
+typedef struct queue_test_producer {
+    bytebeam_queue_t *queue;
+    uint32_t id;
+    uint32_t pushed;
+    uint32_t rejected;
+} queue_test_producer_t;
+
+typedef struct queue_test_result {
+    uint32_t got;
+    uint32_t duplicates;
+    uint32_t reordered;
+    uint32_t corrupted;
+} queue_test_result_t;
+
+static atomic_int producers_running;
+
+static void *queue_test_produce(void *arg)
+{
+    queue_test_producer_t *producer = arg;
+    queue_test_record_t record;
+
+    for (uint32_t seq = 0; seq < QUEUE_TEST_RECORDS_PER_PRODUCER; seq++)
+    {
+        memset(&record, (int)(seq & 0xFF), sizeof(record));
+        record.producer = producer->id;
+        record.seq = seq;
+
+        // every record is offered exactly once, a rejected record is lost for good
+        if (bytebeam_queue_push(producer->queue, (const char *)&record, sizeof(record)) == BB_SUCCESS)
+        {
+            producer->pushed++;
+        }
+        else
+        {
+            producer->rejected++;
+        }
+    }
+
+    atomic_fetch_sub(&producers_running, 1);
+
+    return NULL;
+}
+
+static void queue_test_consume(bytebeam_queue_t *queue, queue_test_result_t *result)
+{
+    static uint8_t seen[QUEUE_TEST_PRODUCERS][QUEUE_TEST_RECORDS_PER_PRODUCER];
+    int64_t last_seq[QUEUE_TEST_PRODUCERS];
+    bytebeam_queue_item_t item;
+
+    memset(seen, 0, sizeof(seen));
+    memset(result, 0, sizeof(*result));
+    for (int loop_var = 0; loop_var < QUEUE_TEST_PRODUCERS; loop_var++)
+    {
+        last_seq[loop_var] = -1;
+    }
+
+    while (1)
+    {
+        // sample the producers before popping so the final drain cannot miss a late record
+        int running = atomic_load(&producers_running);
+
+        if (!bytebeam_queue_pop_begin(queue, &item))
+        {
+            if (running == 0)
+            {
+                break;
+            }
+
+            sched_yield();
+            continue;
+        }
+
+        queue_test_record_t record;
+        uint8_t padding[sizeof(record.padding)];
+
+        if (item.len != sizeof(record))
+        {
+            result->corrupted++;
+            bytebeam_queue_pop_end(queue, &item);
+            continue;
+        }
+
+        memcpy(&record, item.data, sizeof(record));
+        bytebeam_queue_pop_end(queue, &item);
+
+        memset(padding, (int)(record.seq & 0xFF), sizeof(padding));
+        if (record.producer >= QUEUE_TEST_PRODUCERS || record.seq >= QUEUE_TEST_RECORDS_PER_PRODUCER ||
+            memcmp(record.padding, padding, sizeof(padding)) != 0)
+        {
+            result->corrupted++;
+            continue;
+        }
+
+        result->got++;
+
+        if (seen[record.producer][record.seq])
+        {
+            result->duplicates++;
+            continue;
+        }
+        seen[record.producer][record.seq] = 1;
+
+        if ((int64_t)record.seq <= last_seq[record.producer])
+        {
+            result->reordered++;
+        }
+        last_seq[record.producer] = record.seq;
+    }
+}
+
+static void queue_test_run(bytebeam_queue_policy_t policy, const char *name)
+{
+    bytebeam_queue_t queue;
+    queue_test_producer_t producers[QUEUE_TEST_PRODUCERS];
+    pthread_t threads[QUEUE_TEST_PRODUCERS];
+    queue_test_result_t result;
+    uint32_t pushed = 0;
+    uint32_t rejected = 0;
+
+    HOST_CHECK_EQ(bytebeam_queue_init(&queue, QUEUE_TEST_DEPTH, sizeof(queue_test_record_t), policy, QUEUE_TEST_BLOCK_TIMEOUT_MS), BB_SUCCESS);
+
+    atomic_store(&producers_running, QUEUE_TEST_PRODUCERS);
+
+    for (uint32_t loop_var = 0; loop_var < QUEUE_TEST_PRODUCERS; loop_var++)
+    {
+        producers[loop_var] = (queue_test_producer_t){ .queue = &queue, .id = loop_var };
+        pthread_create(&threads[loop_var], NULL, queue_test_produce, &producers[loop_var]);
+    }
+
+    queue_test_consume(&queue, &result);
+
+    for (uint32_t loop_var = 0; loop_var < QUEUE_TEST_PRODUCERS; loop_var++)
+    {
+        pthread_join(threads[loop_var], NULL);
+        pushed += producers[loop_var].pushed;
+        rejected += producers[loop_var].rejected;
+    }
+
+    uint32_t produced = pushed + rejected;
+    uint32_t dropped = atomic_load(&queue.dropped);
+    uint32_t overwritten = atomic_load(&queue.overwritten);
+
+    printf("%-9s produced %u got %u dropped %u overwritten %u duplicates %u reordered %u\n",
+           name, produced, result.got, dropped, overwritten, result.duplicates, result.reordered);
+
+    HOST_CHECK_EQ(produced, QUEUE_TEST_RECORDS);
+    HOST_CHECK_EQ(result.corrupted, 0);
+    HOST_CHECK_EQ(result.duplicates, 0);
+    HOST_CHECK_EQ(result.reordered, 0);
+    HOST_CHECK_EQ(dropped, rejected);
+    HOST_CHECK_EQ((uint64_t)result.got + dropped + overwritten, produced);
+    HOST_CHECK_EQ(bytebeam_queue_count(&queue), 0);
+
+    if (policy == BYTEBEAM_QUEUE_POLICY_BLOCK)
+    {
+        HOST_CHECK_EQ(produced - result.got, 0);
+        HOST_CHECK_EQ(dropped, 0);
+    }
+
+    if (policy != BYTEBEAM_QUEUE_POLICY_OVERWRITE)
+    {
+        HOST_CHECK_EQ(overwritten, 0);
+    }
+    else
+    {
+        // the oldest record makes room, a new one is only dropped if the consumer held its slot for too long
+        HOST_CHECK(dropped <= QUEUE_TEST_PRODUCERS);
+    }
+
+    bytebeam_queue_deinit(&queue);
+}
+
+int main(void)
+{
+    queue_test_run(BYTEBEAM_QUEUE_POLICY_DROP, "drop");
+    queue_test_run(BYTEBEAM_QUEUE_POLICY_OVERWRITE, "overwrite");
+    queue_test_run(BYTEBEAM_QUEUE_POLICY_BLOCK, "block");
+
+    return host_test_result("test_queue");
+}